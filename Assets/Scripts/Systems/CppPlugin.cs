@@ -1,8 +1,9 @@
-﻿using UnityEngine;
-using System;                         // IntPtr
+using UnityEngine;
+using System;                         // IntPtr, Action
 using System.Text;                    // StringBuilder
 using System.IO;                      // Stream
 using System.Collections;             // IEnumerator
+using System.Collections.Generic;     // Dictionary
 using System.Runtime.InteropServices; // DllImport
 
 public class CppPlugin
@@ -10,12 +11,15 @@ public class CppPlugin
     // The C++ Plugin is predominantly used for Asynchronous Texture loading as Texture2D's only load Synchronously.
     //
     // It works with the following function order:
-    // (1) Init() calls glGenTextures() for m_initMaxNumTextures and allocates m_pWorkingMemory for pixel loading
-    // (2) LoadIntoWorkingMemoryFromImagePath() calls through to stbi_load() and sets pixels into m_pWorkingMemory
-    // (3) CreateEmptyTexture() calls glTexImage2D() hence allocating the actual texture
-    // (4) LoadScanlinesIntoTextureFromWorkingMemory() is called repeatedly until all scanlines are uploaded to the texture through glTexSubImage2D
+    // (1) Init() calls glGenTextures() for m_initMaxNumTextures
+    // (2) QueueLoadFromImagePath() has the image decoded a band at a time on the plugin's own threads, highest priority first,
+    //      into memory belonging to that load alone
+    // (3) UploadLoadJobIntoTexture() hands the load over to the render thread, where UploadLoadJobsIntoTextures() calls glTexImage2D() 
+    //      hence allocating the actual texture, as soon as the first scanlines are ready
+    // (4) UploadLoadJobsIntoTextures() is called every frame until all scanlines are uploaded to the texture through glTexSubImage2D,
+    //      uploading only those that have been decoded so far, and taking turns with any other loads that are uploading
     // (5) Finally CreateExternalTexture() is called with the texture that’s been created beneath us! 
-    // (6) Terminate() calls glDeleteTextures() and delete[] on m_pWorkingMemory
+    // (6) Terminate() calls glDeleteTextures()
 
     // **************************
     // C++ Plugin declerations
@@ -30,18 +34,60 @@ public class CppPlugin
     [DllImport ("cppplugin")]
     private static extern void SetMaxPixelsUploadedPerFrame(int maxPixelsUploadedPerFrame);
 
+    [DllImport ("cppplugin")]
+    private static extern void SetUploadBudgetMilliseconds(float uploadBudgetMilliseconds);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetMaxPixelsUploadedPerFrame();
+
+    [DllImport ("cppplugin")]
+    private static extern float GetUploadPixelsPerMillisecond();
+
     [DllImport ("cppplugin")]
     private static extern void SetUseExif(bool useExif);
 
+    [DllImport ("cppplugin")]
+    private static extern void SetUseExifPlaceholder(bool useExifPlaceholder);
+
     [DllImport ("cppplugin")]
     private static extern void SetMaxImageWidth(int maxImageWidth);
 
+    [DllImport ("cppplugin")]
+    private static extern void SetResampleMode(int resampleMode, int maxImageMegabytes);
+
     [DllImport ("cppplugin")]
     private static extern void SetRGB565On(bool rgb565On);
 
     [DllImport ("cppplugin")]
     private static extern void SetCurrTextureIndex(int currTextureIndex);
 
+    [DllImport ("cppplugin")]
+    private static extern void SetUseUploadThread(bool useUploadThread);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetUseCpuMipmaps(bool useCpuMipmaps);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetUseEtc2Compression(bool useEtc2Compression);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetDiskCache(StringBuilder directory, int maxMegabytes);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetUseProgressiveUpload(bool useProgressiveUpload);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetUseViewPriorityUpload(bool useViewPriorityUpload);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetViewDirection(float yaw, float pitch);
+
+    [DllImport ("cppplugin")]
+    private static extern void AddTexturePoolSizeClass(int width, int height, bool rgb565On, int numTextures);
+
+    [DllImport ("cppplugin")]
+    private static extern void AddEtc2TexturePoolSizeClass(int width, int height, int numTextures);
+
     [DllImport ("cppplugin")]
     private static extern bool IsLoadingIntoTexture();
 
@@ -54,18 +100,176 @@ public class CppPlugin
     [DllImport ("cppplugin")]
     private static extern int GetCurrStoredImageHeight();   
 
+    [DllImport ("cppplugin")]
+    private static extern int GetNumScanlinesInWorkingMemory();
+
     [DllImport ("cppplugin")]
     private static extern bool LoadIntoWorkingMemoryFromImagePath(StringBuilder filePath);
 
     [DllImport ("cppplugin")]
     private static extern bool LoadIntoWorkingMemoryFromImageData(IntPtr pRawData, int dataLength);
 
+    [DllImport ("cppplugin")]
+    private static extern bool StreamIntoWorkingMemoryFromImagePath(StringBuilder filePath);
+
+    [DllImport ("cppplugin")]
+    private static extern bool StreamIntoWorkingMemoryFromImageData(IntPtr pRawData, int dataLength);
+
+    [DllImport ("cppplugin")]
+    private static extern int QueueLoadFromImagePath(StringBuilder filePath, int priority);
+
+    [DllImport ("cppplugin")]
+    private static extern int QueueLoadFromImageData(IntPtr pRawData, int dataLength, int priority);
+
+    [DllImport ("cppplugin")]
+    private static extern int QueueLoadFromImageDataWithCacheKey(IntPtr pRawData, int dataLength, int priority, StringBuilder cacheKey);
+
+    [DllImport ("cppplugin")]
+    private static extern int QueueLoadFromDiskCache(StringBuilder cacheKey, int priority);
+
+    [DllImport ("cppplugin")]
+    private static extern int QueueLoadFromKtxPath(StringBuilder filePath, int priority);
+
+    [DllImport ("cppplugin")]
+    private static extern int QueueLoadFromKtxData(IntPtr pRawData, int dataLength, int priority);
+
+    [DllImport ("cppplugin")]
+    private static extern int QueueLoadFromGalleryThumbnail(StringBuilder filePath, int priority);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetLoadJobPriority(int loadJobId, int priority);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobState(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern bool IsLoadJobRunning(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern bool MoveLoadJobIntoWorkingMemory(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern void ReleaseLoadJob(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern void ReleaseAllLoadJobs();
+
+    [DllImport ("cppplugin")]
+    private static extern bool UploadLoadJobIntoTexture(int loadJobId, int textureIndex);
+
+    [DllImport ("cppplugin")]
+    private static extern bool UploadLoadJobIntoTextureWithPlaceholder(int loadJobId, int textureIndex, int placeholderTextureIndex);
+
+    [DllImport ("cppplugin")]
+    private static extern bool IsLoadJobUploading(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobPhase(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern IntPtr GetLoadJobPlaceholderTexturePtr(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobPlaceholderWidth(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobPlaceholderHeight(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobVisibleMipLevel(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern float GetLoadJobTimeToFirstVisiblePixel(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobImageWidth(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobImageHeight(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetLoadJobCompressedFormat(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern IntPtr GetLoadJobTexturePtr(int loadJobId);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetPanoramaTileTextures(int tileSize, int numTextures, bool rgb565On);
+
+    [DllImport ("cppplugin")]
+    private static extern int CreateTiledPanoramaFromImagePath(StringBuilder filePath);
+
+    [DllImport ("cppplugin")]
+    private static extern void ReleaseTiledPanorama(int tiledPanoramaId);
+
+    [DllImport ("cppplugin")]
+    private static extern void SetTiledPanoramaViewDirection(int tiledPanoramaId, float yaw, float pitch);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetTiledPanoramaWidth(int tiledPanoramaId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetTiledPanoramaHeight(int tiledPanoramaId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetTiledPanoramaNumColumns(int tiledPanoramaId);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetTiledPanoramaNumRows(int tiledPanoramaId);
+
+    [DllImport ("cppplugin")]
+    private static extern IntPtr GetTiledPanoramaTileTexturePtr(int tiledPanoramaId, int column, int row);
+
+    [DllImport ("cppplugin")]
+    private static extern int IndexGalleryImages(StringBuilder directory, StringBuilder indexPath, int thumbnailWidth);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetNumGalleryImages();
+
+    [DllImport ("cppplugin")]
+    private static extern int GetGalleryImagePath(int index, StringBuilder path, int capacity);
+
+    [DllImport ("cppplugin")]
+    private static extern int FindGalleryImage(StringBuilder filePath);
+
+    [DllImport ("cppplugin")]
+    private static extern int GetGalleryImageWidth(int index);
+
+    [DllImport ("cppplugin")]
+    private static extern float GetGalleryImageAspectRatio(int index);
+
     // **************************
     // Member Variables
     // **************************
 
-    private const int kMaxPixelsUploadedPerFrame = 1 * 1024 * 1024;
+    private const int kMaxPixelsUploadedPerFrame = 1 * 1024 * 1024; // Only until uploads have been timed, after which it fits kUploadBudgetMilliseconds
+    private const float kUploadBudgetMilliseconds = 4.0f;
+    private const int kNumPooledImageTextures = 6; // 5 ImageSpheres + 1 Skybox
+    private const int kNumPooledThumbnailTextures = 5; // 5 ImageSpheres
+    private const bool kUseCpuMipmaps = true; // Mip levels are built as images are decoded, then uploaded over several frames like the rest
+    private const bool kUseEtc2Compression = true; // Images are compressed to ETC2 as they're decoded - a quarter of RGB565's memory and upload time
+    private const ResampleMode kResampleMode = ResampleMode.kArea; // Images wider than Helper.kMaxImageWidth are resampled to exactly that, rather than halved until they fit
+    private const int kMaxImageMegabytes = 16; // A 4096 x 2048 base level in RGB565 - images are kept narrow enough for theirs to fit in this
+    private const int kDiskCacheMegabytes = 256; // Images are kept on disk exactly as they're uploaded, so revisiting one doesn't decode it again
+    private const bool kUseProgressiveUpload = true; // Images are shown as soon as their coarsest mip levels are uploaded, then sharpen
+    private const bool kUseViewPriorityUpload = true; // Whatever part of an image the camera's facing is uploaded first
+    private const int kPanoramaTileSize = 1024;
+    private const int kNumPanoramaTileTextures = 24; // Enough for the tiles around the view of a 12K panorama, at ~2.7MB each in RGB565
+    private const bool kUseUploadThread = true; // Uploads on the C++ Plugin's own shared EGL context, falling back to the render thread if it can't be created
     private const float kWaitForGLRenderCall = 2.0f/60.0f; // Wait 2 frames
+    private const int kGalleryThumbnailWidth = 256; // Gallery index thumbnails are 64KB each in RGB565
+    private const int kMaxGalleryPathLength = 1024;
+    private static readonly byte[] kKtxIdentifier = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A }; // «KTX 11»\r\n\x1A\n
+
+    // The GL internal formats GetLoadJobCompressedFormat() can return
+    private const int kGLCompressedRGB8ETC2 = 0x9274;
+    private const int kGLCompressedRGBA8ETC2EAC = 0x9278;
+    private const int kGLCompressedRGBAASTC4x4 = 0x93B0;
+    private const int kGLCompressedRGBAASTC5x5 = 0x93B2;
+    private const int kGLCompressedRGBAASTC6x6 = 0x93B4;
+    private const int kGLCompressedRGBAASTC8x8 = 0x93B7;
+    private const int kGLCompressedRGBAASTC10x10 = 0x93BB;
+    private const int kGLCompressedRGBAASTC12x12 = 0x93BD;
 
     private WaitForEndOfFrame m_waitForEndOfFrame;
     private WaitForSeconds m_waitForSeconds;
@@ -73,6 +277,10 @@ public class CppPlugin
     private MonoBehaviour m_owner;
     private Texture2D m_lastTextureOperatedOn;
     private ThreadJob m_threadJob;   
+    private int m_lastUploadFrame = -1;
+    private int m_lastPanoramaUpdateFrame = -1;
+    private Dictionary<IntPtr, Texture2D> m_panoramaTileTextures = new Dictionary<IntPtr, Texture2D>(); // The C++ Plugin's tile textures never change
+    private string m_galleryIndexPath; // Application's paths can only be read on the main thread, whereas the gallery's indexed off it
 
     // These are functions that use OpenGL and hence must be run from the Render Thread!
     enum RenderFunctions
@@ -81,14 +289,52 @@ public class CppPlugin
         kCreateEmptyTexture = 1,
         kLoadScanlinesIntoTextureFromWorkingMemory = 2,
         kRenewTextureHandle = 3,
-        kTerminate = 4
+        kTerminate = 4,
+        kUploadLoadJobsIntoTextures = 5,
+        kUpdateTiledPanoramas = 6
+    };
+
+    // Higher priorities are decoded first - these must match LoadPriority in the C++ Plugin
+    public enum LoadPriority
+    {
+        kPrefetch = 0,
+        kVisibleSphere = 1,
+        kSkybox = 2
+    };
+
+    // These must match LoadJobState in the C++ Plugin
+    enum LoadJobState
+    {
+        kQueued = 0,
+        kRunning = 1,
+        kSucceeded = 2,
+        kFailed = 3,
+        kCancelled = 4
     };
 
+    // These must match LoadJobPhase in the C++ Plugin
+    enum LoadJobPhase
+    {
+        kNothingVisible = 0,
+        kPlaceholderVisible = 1,
+        kImageVisible = 2
+    };
+
+    // These must match ResampleMode in the C++ Plugin
+    enum ResampleMode
+    {
+        kHalve = 0,
+        kArea = 1,
+        kLanczos3 = 2
+    };
+
+    public const int kNoPlaceholderTextureIndex = -1;
+
     // **************************
     // Public functions
     // **************************
 
-    // NOTE: Due to current underlying C++ implementation being single threaded, there can only be one of these
+    // NOTE: The C++ Plugin's textures are shared, so there can only be one of these - although it can have any number of loads in flight
     public CppPlugin(MonoBehaviour owner, int maxNumTextures)
     {
         m_owner = owner;
@@ -97,7 +343,27 @@ public class CppPlugin
         m_lastTextureOperatedOn = new Texture2D(2,2);
 
         SetMaxPixelsUploadedPerFrame(kMaxPixelsUploadedPerFrame);
+        SetUploadBudgetMilliseconds(kUploadBudgetMilliseconds);
         SetInitMaxNumTextures(maxNumTextures);
+        SetUseUploadThread(kUseUploadThread);
+        SetUseCpuMipmaps(kUseCpuMipmaps);
+        SetResampleMode((int) kResampleMode, kMaxImageMegabytes);
+        SetUseEtc2Compression(kUseEtc2Compression);
+        SetDiskCache(new StringBuilder(Application.temporaryCachePath + "/Textures"), kDiskCacheMegabytes);
+        SetUseProgressiveUpload(kUseProgressiveUpload);
+        SetUseViewPriorityUpload(kUseViewPriorityUpload);
+        if (kUseEtc2Compression)
+        {
+            AddEtc2TexturePoolSizeClass(Helper.kMaxImageWidth, Helper.kMaxImageWidth / 2, kNumPooledImageTextures); // Most images are 2:1 equirectangular
+            AddEtc2TexturePoolSizeClass(Helper.kThumbnailWidth, Helper.kThumbnailWidth / 2, kNumPooledThumbnailTextures);
+        }
+        else
+        {
+            AddTexturePoolSizeClass(Helper.kMaxImageWidth, Helper.kMaxImageWidth / 2, Helper.kRGB565On, kNumPooledImageTextures); // Most images are 2:1 equirectangular
+            AddTexturePoolSizeClass(Helper.kThumbnailWidth, Helper.kThumbnailWidth / 2, Helper.kRGB565On, kNumPooledThumbnailTextures);
+        }
+        SetPanoramaTileTextures(kPanoramaTileSize, kNumPanoramaTileTextures, Helper.kRGB565On);
+        m_galleryIndexPath = Application.persistentDataPath + "/GalleryIndex";
         GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kInit);
 
         m_waitForEndOfFrame = new WaitForEndOfFrame();
@@ -112,70 +378,210 @@ public class CppPlugin
 
         GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kTerminate);
     }
-        
-    public IEnumerator LoadImageFromPathIntoImageSphere(ImageSphereController imageSphereController, int sphereIndex, string filePathAndIdentifier, int textureIndex, int maxImageWidth)
+
+    // Starts decoding straight away, in priority order with any other queued loads - the returned id is then passed to
+    //  LoadImageFromPathIntoImageSphere(), or to ReleaseLoad() if the image is no longer wanted
+    public int QueueLoadFromImagePath(string filePath, int maxImageWidth, LoadPriority priority)
     {
-        StringBuilder filePathForCpp = new StringBuilder(filePathAndIdentifier);
-        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling LoadImageFromPathIntoImageSphere() with sphereIndex : "  + sphereIndex + ", from filePath: " + filePathAndIdentifier + ", with TextureIndex: " + textureIndex + ", with MaxImageWidth: " + maxImageWidth);
-        yield return null;
+        // KTX files are uploaded just as they are, so aren't affected by any of the settings below
+        if (filePath.EndsWith(".ktx", StringComparison.OrdinalIgnoreCase))
+        {
+            return QueueLoadFromKtxPath(new StringBuilder(filePath), (int)priority);
+        }
 
         SetRGB565On(Helper.kRGB565On);
         SetMaxImageWidth(maxImageWidth);
         SetUseExif(false); //SetUseExif(maxImageWidth == Helper.kThumbnailWidth);
+        SetUseExifPlaceholder(maxImageWidth == Helper.kMaxImageWidth); // Full size images can show their EXIF thumbnail while they're decoded
 
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling LoadIntoWorkingMemoryFromImagePath(), on background thread!");
-        yield return m_threadJob.WaitFor();
-        bool ranJobSuccessfully = false;
-        m_threadJob.Start( () => 
-            ranJobSuccessfully = LoadIntoWorkingMemoryFromImagePath(filePathForCpp)
-        );
-        yield return m_threadJob.WaitFor();
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished LoadIntoWorkingMemoryFromImagePath(), ran Job Successully = " + ranJobSuccessfully); 
+        return QueueLoadFromImagePath(new StringBuilder(filePath), (int)priority);
+    }
 
+    // Loads an image that LoadImageFromStreamIntoImageSphere() has shown before straight off the disk cache, without it having to be downloaded -
+    //  the returned id is then passed to LoadImageFromPathIntoImageSphere(). Returns 0 if it isn't in the cache
+    public int QueueLoadFromDiskCache(string imageIdentifier, LoadPriority priority)
+    {
+        SetRGB565On(Helper.kRGB565On);
+        SetMaxImageWidth(Helper.kMaxImageWidth);
 
-        //TODO: Make CreateEmptyTexture() more efficient - the problem is simply that a glTexImage2D() call is slow with large textures!
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling CreateEmptyTexture() over textureIndex = " + textureIndex);
-        yield return m_waitForEndOfFrame;
-        SetCurrTextureIndex(textureIndex);
-        GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kRenewTextureHandle);
-        yield return m_waitForSeconds; // These waits need to be longer to ensure that GL.IssuePluginEvent() has gone through!
+        return QueueLoadFromDiskCache(new StringBuilder(imageIdentifier), (int)priority);
+    }
 
-        yield return null;
-        GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kCreateEmptyTexture);
-        yield return m_waitForSeconds; // These waits need to be longer to ensure that GL.IssuePluginEvent() has gone through!
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished CreateEmptyTexture(), Texture Handle = " + GetCurrStoredTexturePtr() );
+    // Indexes every image under directory on the C++ Plugin's threads, blocking until it's done - so it's called through a ThreadJob. Images
+    //  that haven't changed since the gallery was last indexed, even in an earlier session, are taken from the index without being read.
+    //  Returns how many images there are, newest first, or -1 if the directory can't be read
+    public int IndexGallery(string directory)
+    {
+        return IndexGalleryImages(new StringBuilder(directory), new StringBuilder(m_galleryIndexPath), kGalleryThumbnailWidth);
+    }
 
+    public string GetGalleryImagePath(int galleryIndex)
+    {
+        StringBuilder path = new StringBuilder(kMaxGalleryPathLength);
+        return GetGalleryImagePath(galleryIndex, path, path.Capacity) > 0 ? path.ToString() : null;
+    }
 
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling LoadScanlinesIntoTextureFromWorkingMemory()");
-        while (IsLoadingIntoTexture())
-        {            
-            yield return m_waitForEndOfFrame;
-            GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kLoadScanlinesIntoTextureFromWorkingMemory);
-            yield return m_waitForSeconds;
+    public float GetGalleryAspectRatio(int galleryIndex)
+    {
+        return GetGalleryImageAspectRatio(galleryIndex);
+    }
+
+    // Returns 0 if the image isn't in the gallery index
+    public int GetGalleryImageWidth(string filePath)
+    {
+        int galleryIndex = FindGalleryImage(new StringBuilder(filePath));
+        return galleryIndex >= 0 ? GetGalleryImageWidth(galleryIndex) : 0;
+    }
+
+    // Loads the image's thumbnail straight out of the gallery index - the returned id is then passed to LoadImageFromPathIntoImageSphere().
+    //  Returns 0 if the index hasn't got one for it
+    public int QueueLoadFromGalleryThumbnail(string filePath, LoadPriority priority)
+    {
+        return QueueLoadFromGalleryThumbnail(new StringBuilder(filePath), (int)priority);
+    }
+
+    public void SetLoadPriority(int loadJobId, LoadPriority priority)
+    {
+        SetLoadJobPriority(loadJobId, (int)priority);
+    }
+
+    // Cancels the load if it hasn't finished decoding
+    public void ReleaseLoad(int loadJobId)
+    {
+        ReleaseLoadJob(loadJobId);
+    }
+
+    public void ReleaseAllLoads()
+    {
+        ReleaseAllLoadJobs();
+    }
+
+    // Panoramas wider than Helper.kMaxImageWidth get their tiles in view decoded and uploaded at full resolution, to be drawn over the
+    //  ordinary load of the same image - see ImageSkyboxTiles. Others get no panorama, and 0 back, as only the file's header is read to tell.
+    //  Any other returned id has to be passed to ReleasePanorama()
+    public int CreateTiledPanorama(string filePath)
+    {
+        SetMaxImageWidth(Helper.kMaxImageWidth);
+        return CreateTiledPanoramaFromImagePath(new StringBuilder(filePath));
+    }
+
+    public void ReleasePanorama(int tiledPanoramaId)
+    {
+        ReleaseTiledPanorama(tiledPanoramaId);
+    }
+
+    // Call every frame while the panorama is shown, with where the camera's looking in the panorama's space, in degrees
+    public void UpdatePanorama(int tiledPanoramaId, float yaw, float pitch)
+    {
+        SetTiledPanoramaViewDirection(tiledPanoramaId, yaw, pitch);
+        if (m_lastPanoramaUpdateFrame != Time.frameCount) // Every panorama's tiles are updated at once
+        {
+            m_lastPanoramaUpdateFrame = Time.frameCount;
+            GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kUpdateTiledPanoramas);
+        }
+    }
+
+    // These are all 0 until the panorama's header has been read, and stay that way if it can't be tiled
+    public int GetPanoramaWidth(int tiledPanoramaId)
+    {
+        return GetTiledPanoramaWidth(tiledPanoramaId);
+    }
+
+    public int GetPanoramaHeight(int tiledPanoramaId)
+    {
+        return GetTiledPanoramaHeight(tiledPanoramaId);
+    }
+
+    public int GetPanoramaNumColumns(int tiledPanoramaId)
+    {
+        return GetTiledPanoramaNumColumns(tiledPanoramaId);
+    }
+
+    public int GetPanoramaNumRows(int tiledPanoramaId)
+    {
+        return GetTiledPanoramaNumRows(tiledPanoramaId);
+    }
+
+    public int GetPanoramaTileSize()
+    {
+        return kPanoramaTileSize;
+    }
+
+    // Null unless the tile is resident - its top left is at the texture's origin, and edge tiles don't fill it
+    public Texture2D GetPanoramaTileTexture(int tiledPanoramaId, int column, int row)
+    {
+        IntPtr texturePtr = GetTiledPanoramaTileTexturePtr(tiledPanoramaId, column, row);
+        if (texturePtr == IntPtr.Zero)
+        {
+            return null;
+        }
+
+        Texture2D texture;
+        if (!m_panoramaTileTextures.TryGetValue(texturePtr, out texture))
+        {
+            texture = Texture2D.CreateExternalTexture(kPanoramaTileSize, kPanoramaTileSize, Helper.kRGB565On ? TextureFormat.RGB565 : TextureFormat.RGB24, true, true, texturePtr);
+            texture.filterMode = FilterMode.Trilinear;
+            texture.wrapMode = TextureWrapMode.Clamp;
+            m_panoramaTileTextures[texturePtr] = texture;
+        }
+        return texture;
+    }
+        
+    // With a placeholderTextureIndex, the image's EXIF thumbnail is shown from that texture as soon as it's decoded, and swapped for the image
+    //  itself once that's visible
+    public IEnumerator LoadImageFromPathIntoImageSphere(ImageSphereController imageSphereController, int sphereIndex, string filePathAndIdentifier, int textureIndex, int loadJobId, int placeholderTextureIndex = kNoPlaceholderTextureIndex)
+    {
+        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling LoadImageFromPathIntoImageSphere() with sphereIndex : "  + sphereIndex + ", from filePath: " + filePathAndIdentifier + ", with TextureIndex: " + textureIndex + ", with LoadJobId: " + loadJobId);
+        yield return null;
+
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling UploadLoadIntoTexture() over textureIndex = " + textureIndex);
+        Texture2D texture = null;
+        bool isShowingPlaceholder = false;
+        yield return UploadLoadIntoTexture(loadJobId, textureIndex, () => 
+        {
+            texture = CreateExternalTexture(loadJobId);
+            texture.filterMode = FilterMode.Trilinear;
+            imageSphereController.SetImageAtIndex(sphereIndex, texture, filePathAndIdentifier, textureIndex, !isShowingPlaceholder);
+        }, placeholderTextureIndex, () =>
+        {
+            Texture2D placeholderTexture = Texture2D.CreateExternalTexture(GetLoadJobPlaceholderWidth(loadJobId), GetLoadJobPlaceholderHeight(loadJobId), TextureFormat.RGB565, true, true, GetLoadJobPlaceholderTexturePtr(loadJobId));
+            placeholderTexture.filterMode = FilterMode.Trilinear;
+            imageSphereController.SetImageAtIndex(sphereIndex, placeholderTexture, filePathAndIdentifier, placeholderTextureIndex, true);
+            isShowingPlaceholder = true;
+            if (Debug.isDebugBuild) Debug.Log("------- VREEL: LoadJobId: " + loadJobId + " is showing its EXIF thumbnail until the image is visible");
+        });
+        if (GetLoadJobState(loadJobId) == (int)LoadJobState.kCancelled)
+        {
+            if (Debug.isDebugBuild) Debug.Log("------- VREEL: LoadImageFromPathIntoImageSphere() with LoadJobId: " + loadJobId + " was cancelled");
+            ReleaseLoadJob(loadJobId);
+            yield break;
         }
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished LoadScanlinesIntoTextureFromWorkingMemory()");
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished UploadLoadIntoTexture(), Texture Handle = " + GetLoadJobTexturePtr(loadJobId) );
+        if (Debug.isDebugBuild) Debug.Log("------- VREEL: LoadJobId: " + loadJobId + " took " + GetLoadJobTimeToFirstVisiblePixel(loadJobId) + "ms to first visible pixel");
 
 
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling CreateExternalTexture(), size of Texture is Width x Height = " + GetCurrStoredImageWidth() + " x " + GetCurrStoredImageHeight());
+        if (texture != null) // It's already being shown, and has sharpened up beneath us
+        {
+            ReleaseLoadJob(loadJobId);
+            if (Debug.isDebugBuild) Debug.Log("------- VREEL: Completed LoadImageFromPathIntoImageSphere() progressively with sphereIndex : "  + sphereIndex + ", from filePath: " + filePathAndIdentifier + ", with TextureIndex: " + textureIndex);
+            yield break;
+        }
+
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling CreateExternalTexture(), size of Texture is Width x Height = " + GetLoadJobImageWidth(loadJobId) + " x " + GetLoadJobImageHeight(loadJobId));
         yield return m_waitForEndOfFrame;
-        m_lastTextureOperatedOn =
-            Texture2D.CreateExternalTexture(
-                GetCurrStoredImageWidth(), 
-                GetCurrStoredImageHeight(), 
-                Helper.kRGB565On ? TextureFormat.RGB565 : TextureFormat.RGB24, // Default textures have a format of ARGB32
-                true,
-                true,
-                GetCurrStoredTexturePtr()
-            );
+        texture = CreateExternalTexture(loadJobId); // Other loads may be doing the same, so this can't be m_lastTextureOperatedOn
+        ReleaseLoadJob(loadJobId);
         yield return null;
-        m_lastTextureOperatedOn.filterMode = FilterMode.Trilinear;
+        texture.filterMode = FilterMode.Trilinear;
         //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished CreateExternalTexture()!");
 
 
         //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling SetImageAtIndex()");
-        imageSphereController.SetImageAtIndex(sphereIndex, m_lastTextureOperatedOn, filePathAndIdentifier, textureIndex, true);
+        imageSphereController.SetImageAtIndex(sphereIndex, texture, filePathAndIdentifier, textureIndex, !isShowingPlaceholder);
         //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished SetImageAtIndex()");
 
+        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Uploading " + GetMaxPixelsUploadedPerFrame() + " pixels per frame, at " + GetUploadPixelsPerMillisecond() + " pixels/ms");
+
         if (Debug.isDebugBuild) Debug.Log("------- VREEL: Completed LoadImageFromPathIntoImageSphere() with sphereIndex : "  + sphereIndex + ", from filePath: " + filePathAndIdentifier + ", with TextureIndex: " + textureIndex);
     }   
            
@@ -205,63 +611,43 @@ public class CppPlugin
         //if (Debug.isDebugBuild) Debug.Log("------- VREEL-TEST: 1 " + (DateTime.UtcNow-startTime));
         startTime = DateTime.UtcNow;
 
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling LoadIntoWorkingMemoryFromImagePath(), on background thread!");
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling QueueLoadFromImageData()");
         GCHandle rawDataHandle = GCHandle.Alloc(myBinary, GCHandleType.Pinned);
         IntPtr rawDataPtr = rawDataHandle.AddrOfPinnedObject();
-        yield return m_threadJob.WaitFor();
-        ranJobSuccessfully = false;
-        m_threadJob.Start( () => 
-            ranJobSuccessfully = LoadIntoWorkingMemoryFromImageData(rawDataPtr, myBinary.Length)
-        );
-        yield return m_threadJob.WaitFor();
-        rawDataHandle.Free();
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished LoadIntoWorkingMemoryFromImagePath(), ran Job Successully = " + ranJobSuccessfully); 
+        int loadJobId = IsKtxData(myBinary)
+            ? QueueLoadFromKtxData(rawDataPtr, myBinary.Length, (int)LoadPriority.kVisibleSphere)
+            : QueueLoadFromImageDataWithCacheKey(rawDataPtr, myBinary.Length, (int)LoadPriority.kVisibleSphere, new StringBuilder(imageIdentifier));
 
 
         //if (Debug.isDebugBuild) Debug.Log("------- VREEL-TEST: 2 " + (DateTime.UtcNow-startTime));
         startTime = DateTime.UtcNow;
 
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling UploadLoadIntoTexture()");
+        yield return UploadLoadIntoTexture(loadJobId, textureIndex);
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished UploadLoadIntoTexture()");
 
-        //TODO: Make CreateEmptyTexture() more efficient - the problem is simply that a glTexImage2D() call is slow with large textures!
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling CreateEmptyTexture()");
-        yield return m_waitForEndOfFrame;
-        SetCurrTextureIndex(textureIndex);
-        GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kRenewTextureHandle);
-        yield return m_waitForSeconds; // These waits need to be longer to ensure that GL.IssuePluginEvent() has gone through!
-
-        yield return null;
-        GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kCreateEmptyTexture);
-        yield return m_waitForSeconds; // These waits need to be longer to ensure that GL.IssuePluginEvent() has gone through!
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished CreateEmptyTexture(), Texture Handle = " + GetCurrStoredTexturePtr() );
-
-
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL-TEST: 3 " + (DateTime.UtcNow-startTime));
-        startTime = DateTime.UtcNow;
-
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling LoadScanlinesIntoTextureFromWorkingMemory()");
-        while (IsLoadingIntoTexture())
-        {            
-            yield return m_waitForEndOfFrame;
-            GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kLoadScanlinesIntoTextureFromWorkingMemory);
-            yield return m_waitForSeconds; // These waits need to be longer to ensure that GL.IssuePluginEvent() has gone through!
+        // The decoder reads straight out of myBinary, so it has to stay pinned until it's done - even if it's been cancelled
+        while (IsLoadJobRunning(loadJobId))
+        {
+            yield return null;
+        }
+        rawDataHandle.Free();
+        if (GetLoadJobState(loadJobId) == (int)LoadJobState.kCancelled)
+        {
+            if (Debug.isDebugBuild) Debug.Log("------- VREEL: LoadImageFromStreamIntoImageSphere() with LoadJobId: " + loadJobId + " was cancelled");
+            ReleaseLoadJob(loadJobId);
+            yield break;
         }
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished LoadScanlinesIntoTextureFromWorkingMemory()");
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished LoadJob " + loadJobId); 
 
 
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL-TEST: 4 " + (DateTime.UtcNow-startTime));
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL-TEST: 3 " + (DateTime.UtcNow-startTime));
         startTime = DateTime.UtcNow;
 
-        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling CreateExternalTexture(), size of Texture is Width x Height = " + GetCurrStoredImageWidth() + " x " + GetCurrStoredImageHeight());
+        //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling CreateExternalTexture(), size of Texture is Width x Height = " + GetLoadJobImageWidth(loadJobId) + " x " + GetLoadJobImageHeight(loadJobId));
         yield return m_waitForEndOfFrame;
-        m_lastTextureOperatedOn =
-            Texture2D.CreateExternalTexture(
-                GetCurrStoredImageWidth(), 
-                GetCurrStoredImageHeight(), 
-                Helper.kRGB565On ? TextureFormat.RGB565 : TextureFormat.RGB24, // Default textures have a format of ARGB32
-                true,
-                true,
-                GetCurrStoredTexturePtr()
-            );
+        m_lastTextureOperatedOn = CreateExternalTexture(loadJobId);
+        ReleaseLoadJob(loadJobId);
         yield return null;
         m_lastTextureOperatedOn.filterMode = FilterMode.Trilinear;
         //if (Debug.isDebugBuild) Debug.Log("------- VREEL: Finished CreateExternalTexture()!");
@@ -357,6 +743,109 @@ public class CppPlugin
     // Private/Helper functions
     // **************************
 
+    // The load's scanlines are uploaded as they're decoded, taking turns with any other loads that are uploading at the same time.
+    //  Progressive uploads call onVisible as soon as the texture can be shown, while it carries on sharpening until this finishes
+    private IEnumerator UploadLoadIntoTexture(int loadJobId, int textureIndex, Action onVisible = null, int placeholderTextureIndex = kNoPlaceholderTextureIndex, Action onPlaceholderVisible = null)
+    {
+        if (placeholderTextureIndex != kNoPlaceholderTextureIndex)
+        {
+            UploadLoadJobIntoTextureWithPlaceholder(loadJobId, textureIndex, placeholderTextureIndex);
+        }
+        else
+        {
+            UploadLoadJobIntoTexture(loadJobId, textureIndex);
+        }
+        while (IsLoadJobUploading(loadJobId))
+        {
+            yield return m_waitForEndOfFrame;
+            if (m_lastUploadFrame != Time.frameCount) // Every load that's uploading waits here, but each frame's uploads only need issuing once
+            {
+                m_lastUploadFrame = Time.frameCount;
+                SetViewDirectionFromCamera();
+                GL.IssuePluginEvent(GetRenderEventFunc(), (int)RenderFunctions.kUploadLoadJobsIntoTextures);
+            }
+            yield return m_waitForSeconds; // These waits need to be longer to ensure that GL.IssuePluginEvent() has gone through!
+
+            if (onPlaceholderVisible != null && IsLoadJobUploading(loadJobId) && GetLoadJobPhase(loadJobId) == (int)LoadJobPhase.kPlaceholderVisible)
+            {
+                onPlaceholderVisible();
+                onPlaceholderVisible = null;
+            }
+
+            if (onVisible != null && IsLoadJobUploading(loadJobId) && GetLoadJobVisibleMipLevel(loadJobId) >= 0)
+            {
+                onVisible();
+                onVisible = null;
+            }
+        }
+    }
+
+    // Unity's pitch goes up as the camera looks down, whereas the C++ Plugin's goes up as it looks up
+    private void SetViewDirectionFromCamera()
+    {
+        if (Camera.main != null)
+        {
+            Vector3 eulerAngles = Camera.main.transform.eulerAngles;
+            SetViewDirection(Mathf.DeltaAngle(0.0f, eulerAngles.y), -Mathf.DeltaAngle(0.0f, eulerAngles.x));
+        }
+    }
+
+    private Texture2D CreateExternalTexture(int loadJobId)
+    {
+        return Texture2D.CreateExternalTexture(
+            GetLoadJobImageWidth(loadJobId), 
+            GetLoadJobImageHeight(loadJobId), 
+            GetLoadJobTextureFormat(loadJobId), // Default textures have a format of ARGB32
+            true,
+            true,
+            GetLoadJobTexturePtr(loadJobId)
+        );
+    }
+
+    // Unity has no format for ASTC blocks that aren't square, which the C++ Plugin can still load - they're only ever sampled through OpenGL anyway
+    private TextureFormat GetLoadJobTextureFormat(int loadJobId)
+    {
+        switch (GetLoadJobCompressedFormat(loadJobId))
+        {
+            case kGLCompressedRGB8ETC2:
+                return TextureFormat.ETC2_RGB;
+            case kGLCompressedRGBA8ETC2EAC:
+                return TextureFormat.ETC2_RGBA8;
+            case kGLCompressedRGBAASTC4x4:
+                return TextureFormat.ASTC_RGBA_4x4;
+            case kGLCompressedRGBAASTC5x5:
+                return TextureFormat.ASTC_RGBA_5x5;
+            case kGLCompressedRGBAASTC6x6:
+                return TextureFormat.ASTC_RGBA_6x6;
+            case kGLCompressedRGBAASTC8x8:
+                return TextureFormat.ASTC_RGBA_8x8;
+            case kGLCompressedRGBAASTC10x10:
+                return TextureFormat.ASTC_RGBA_10x10;
+            case kGLCompressedRGBAASTC12x12:
+                return TextureFormat.ASTC_RGBA_12x12;
+            case 0:
+                return Helper.kRGB565On ? TextureFormat.RGB565 : TextureFormat.RGB24;
+            default:
+                return TextureFormat.ASTC_RGBA_4x4;
+        }
+    }
+
+    private bool IsKtxData(byte[] data)
+    {
+        if (data == null || data.Length < kKtxIdentifier.Length)
+        {
+            return false;
+        }
+        for (int i = 0; i < kKtxIdentifier.Length; i++)
+        {
+            if (data[i] != kKtxIdentifier[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
     private bool ToByteArray(Stream stream, int contentLength, ref byte[] outBinary)
     {       
         /*
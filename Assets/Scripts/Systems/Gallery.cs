@@ -325,141 +325,60 @@ public class Gallery : MonoBehaviour
     {  
         m_loadingIcon.Display();
 
-        // 1) Find all files that could potentially be 360 images.
-        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling GetAllFileNamesRecursively()");
-        List<string> files = new List<string>();
-        bool isDebugBuild = Debug.isDebugBuild;
-        m_threadJob.Start( () => 
-            files = GetAllFileNamesRecursively(imagesTopLevelDirectory, isDebugBuild)
-        );
-        yield return m_threadJob.WaitFor();
-
-        // 2) Add the files that are actually 360 images to "m_galleryImageFilePaths"
-        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling FilterAndAdd360Images()");
+        // 1) Index every image in the directory on the C++ Plugin's threads - it already has them newest first, so that users see their most
+        //     recent gallery images! Images that haven't changed since the last time the gallery was opened aren't read again
+        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Calling IndexGallery()");
+        CppPlugin cppPlugin = m_imageLoader.GetCppPlugin();
         int numFilesSearched = 0;
         m_threadJob.Start( () => 
-            numFilesSearched = FilterAndAdd360Images(files, isDebugBuild)           
-        );
-        yield return m_threadJob.WaitFor();
-        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Searched the directory " + imagesTopLevelDirectory + ", through " + numFilesSearched +
-            " files, and found " + m_galleryImageFilePaths.Count + " 360-image files!");
-
-        // 3) Sort files in order of newest first, so that users see their most recent gallery images!
-        bool ranSuccessfully = false;
-        m_threadJob.Start( () => 
-            ranSuccessfully = SortGalleryImageFilePaths()           
+            numFilesSearched = cppPlugin.IndexGallery(imagesTopLevelDirectory)
         );
         yield return m_threadJob.WaitFor();
 
-        m_loadingIcon.Hide();
-
-        bool noImagesInGallery = m_galleryImageFilePaths.Count <= 0;
-        m_noGalleryImagesText.SetActive(noImagesInGallery); // If the user has yet take any 360-images then show them the NoGalleryImagesText!
-    }
-    
-    private List<string> GetAllFileNamesRecursively(string baseDirectory, bool isDebugBuild)
-    {
-        // We iterate over all files in the given top level directory, recursively searching through all the subdirectories
-        var files = new List<string>();
-        FileAttributes undesiredAttributes = (FileAttributes.Hidden | FileAttributes.System | FileAttributes.Temporary);
-
-        try
+        if (numFilesSearched < 0)
         {
-            foreach(string filePath in System.IO.Directory.GetFiles(baseDirectory, "*", SearchOption.TopDirectoryOnly))
-            {            
-                FileAttributes checkedFileAttributes = File.GetAttributes(filePath) & undesiredAttributes;
-                if (checkedFileAttributes == 0)
-                {
-                    files.Add(filePath);
-                }
-            }
-        }
-        catch 
-        {
-            if (isDebugBuild) Debug.Log("------- VREEL: Call to GetFiles() failed for: " + baseDirectory);
+            if (Debug.isDebugBuild) Debug.Log("------- VREEL: Call to IndexGallery() failed for: " + imagesTopLevelDirectory);
 
             var errorText = m_user.GetErrorMessage().GetComponentInChildren<Text>();
             errorText.text = "We've run into an error looking for your 360-images, check you've given us the correct permissions and try again! =)";
             m_user.GetErrorMessage().SetActive(true);
         }
 
-        try
+        // 2) Add the files that are actually 360 images to "m_galleryImageFilePaths"
+        bool isDebugBuild = Debug.isDebugBuild;
+        for (int galleryIndex = 0; galleryIndex < numFilesSearched; galleryIndex++)
         {
-            foreach(string dirName in System.IO.Directory.GetDirectories(baseDirectory, "*", SearchOption.TopDirectoryOnly))
+            string filePath = cppPlugin.GetGalleryImagePath(galleryIndex);
+            if (filePath != null && Is360Image(cppPlugin, galleryIndex, isDebugBuild))
             {
-                FileAttributes checkedFolderAttributes = (new DirectoryInfo(dirName).Attributes) & undesiredAttributes;
-                if (checkedFolderAttributes == 0)
-                {
-                    files.AddRange(GetAllFileNamesRecursively(dirName, isDebugBuild));
-                }
-            }
-        }
-        catch 
-        {
-            if (isDebugBuild) Debug.Log("------- VREEL: Call to GetDirectories() failed for: " + baseDirectory);
-
-            var errorText = m_user.GetErrorMessage().GetComponentInChildren<Text>();
-            errorText.text = "We've run into an error looking for your 360-images, check you've given us the correct permissions and try again! =)";
-            m_user.GetErrorMessage().SetActive(true);
-        }
-
-        return files;
-    }
-
-    private int FilterAndAdd360Images(List<string> files, bool isDebugBuild)
-    {
-        AndroidJNI.AttachCurrentThread();
-
-        int numFilesSearched = 0;
-        foreach (string filePath in files)
-        { 
-            if (Is360Image(filePath, isDebugBuild))
-            {   
                 m_galleryImageFilePaths.Add(filePath);
             }
-            numFilesSearched++;
         }
+        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Searched the directory " + imagesTopLevelDirectory + ", through " + numFilesSearched +
+            " files, and found " + m_galleryImageFilePaths.Count + " 360-image files!");
 
-        AndroidJNI.DetachCurrentThread();
+        m_loadingIcon.Hide();
 
-        return numFilesSearched;
+        bool noImagesInGallery = m_galleryImageFilePaths.Count <= 0;
+        m_noGalleryImagesText.SetActive(noImagesInGallery); // If the user has yet take any 360-images then show them the NoGalleryImagesText!
     }
-        
-    private static readonly List<string> s_imageExtensions = new List<string> { ".JPG", ".JPE", ".BMP", ".GIF", ".PNG" };
-    private bool Is360Image(string filePath, bool isDebugBuild)
+    
+    private bool Is360Image(CppPlugin cppPlugin, int galleryIndex, bool isDebugBuild)
     {            
-        // Check that it has an image file extension 
-        if (!s_imageExtensions.Contains(Path.GetExtension(filePath).ToUpperInvariant()))
-        {
-            if (isDebugBuild) Debug.Log("------- VREEL: File: " + filePath + " is not an image!");
-            return false;
-        }
-
         // NOTE: My current rudimentatry implementation of this function is very simply to check if the aspect ratio is 2:1!
         // This works the majority of the time because all 360 images have a 2:1 ratio,
         // and its not a standard aspect ratio for any other type of image!
 
-        if (isDebugBuild) Debug.Log("------- VREEL: About to call Aspect Ratio function for file: " + filePath);
-        float aspectRatio = m_javaPluginClass.CallStatic<float>("CalcAspectRatio", filePath);
+        float aspectRatio = cppPlugin.GetGalleryAspectRatio(galleryIndex); // Only files with an image file extension are indexed
         if (isDebugBuild) Debug.Log("------- VREEL: Aspect Ratio: " + aspectRatio);
 
         const float kDesiredAspectRatio = 2.0f;
         bool isImage360 = Mathf.Abs(aspectRatio - kDesiredAspectRatio) < Mathf.Epsilon;
-        if (isDebugBuild) Debug.Log("------- VREEL: Image: " + filePath + " is 360: " + isImage360);
+        if (isDebugBuild) Debug.Log("------- VREEL: Image: " + galleryIndex + " is 360: " + isImage360);
 
         return isImage360;
     }        
 
-    private bool SortGalleryImageFilePaths()
-    {
-        m_galleryImageFilePaths.Sort(delegate(string file1, string file2)
-        {
-            return File.GetCreationTime(file2).CompareTo(File.GetCreationTime(file1));
-        });
-
-        return true;
-    }
-
     private IEnumerator LoadImageThumbnails(int startingGalleryImageIndex, int numImagesToLoad)
     {
         if (Debug.isDebugBuild) Debug.Log(string.Format("------- VREEL: Loading {0} images beginning at index {1}. There are {2} images in the gallery!", 
@@ -540,7 +459,11 @@ public class Gallery : MonoBehaviour
 
         bool success = false;
 
-        float currentWidth = m_javaPluginClass.CallStatic<float>("CalcWidth", originalImagePath);
+        float currentWidth = m_imageLoader.GetCppPlugin().GetGalleryImageWidth(originalImagePath); // Read when the gallery was indexed
+        if (currentWidth <= 0)
+        {
+            currentWidth = m_javaPluginClass.CallStatic<float>("CalcWidth", originalImagePath);
+        }
         if (currentWidth > newResolutionWidth)
         {
             success = m_javaPluginClass.CallStatic<bool>("CreateSmallerImageWithResolution", originalImagePath, newImagePath, newResolutionWidth);
@@ -2,6 +2,7 @@
 using System;                         // Exception
 using System.IO;                      // Stream
 using System.Collections;             // IEnumerator
+using System.Collections.Generic;     // Dictionary, List
 using System.Net;                     // HttpWebRequest
 
 public class ImageLoader : MonoBehaviour 
@@ -18,17 +19,20 @@ public class ImageLoader : MonoBehaviour
     private const int kMaxNumTextures = 12; // 5 ImageSpheres + 1 Skybox + 1 ProfileImage + 5 spare textures
     private const int kLoadingTextureIndex = -1;
     private int[] m_textureIndexUsage;
+    private List<int> m_texturesReservedForLoading = new List<int>(); // Reserved by loads that haven't finished yet
 
-    private bool m_isLoading = false;
+    private int m_numImagesLoading = 0;
+    private int m_loadingGeneration = 0; // Bumped by InvalidateLoading(), so loads started before it leave the counts and textures alone when they finish
     private CppPlugin m_cppPlugin;
     private CoroutineQueue m_coroutineQueue;
     private ThreadJob m_threadJob;
+    private Dictionary<int, int> m_queuedGalleryLoadJobs = new Dictionary<int, int>(); // LoadJobId -> GalleryImageIndex, until they've loaded
 
     // **************************
     // Public functions
     // *************************
 
-    public void Start() // NOTE: Due to current underlying C++ implementation being single threaded, there can only be one of these
+    public void Start() // NOTE: Due to the C++ Plugin's textures being shared, there can only be one of these
     {
         m_cppPlugin = new CppPlugin(this, kMaxNumTextures);
 
@@ -41,7 +45,12 @@ public class ImageLoader : MonoBehaviour
 
     public bool IsLoading()
     {
-        return m_isLoading;
+        return m_numImagesLoading > 0;
+    }
+
+    public CppPlugin GetCppPlugin()
+    {
+        return m_cppPlugin;
     }
 
     public int GetMaxNumTextures()
@@ -75,11 +84,40 @@ public class ImageLoader : MonoBehaviour
     public void InvalidateLoading()
     {
         m_coroutineQueue.Clear();
+        m_queuedGalleryLoadJobs.Clear();
+        m_cppPlugin.ReleaseAllLoads();
+
+        m_loadingGeneration++;
+        m_numImagesLoading = 0;
+        while (m_texturesReservedForLoading.Count > 0)
+        {
+            UnreserveTextureIndex(m_texturesReservedForLoading[0]);
+        }
     }
 
+    // The image starts decoding in the background straight away, and is uploaded alongside any other images that are loading
     public void LoadImageFromPathIntoImageSphere(ImageSphereController imageSphereController, int sphereIndex, int galleryImageIndex, string filePathAndIdentifier, bool showLoading, int maxImageWidth)
     {
-        m_coroutineQueue.EnqueueAction(LoadImageFromPathIntoImageSphereInternal(imageSphereController, sphereIndex, galleryImageIndex, filePathAndIdentifier, showLoading, maxImageWidth));
+        ReleaseStaleGalleryLoads();
+
+        CppPlugin.LoadPriority priority = (sphereIndex == Helper.kSkyboxSphereIndex) ? CppPlugin.LoadPriority.kSkybox : CppPlugin.LoadPriority.kVisibleSphere;
+        int loadJobId = (maxImageWidth == Helper.kThumbnailWidth) ? m_cppPlugin.QueueLoadFromGalleryThumbnail(filePathAndIdentifier, priority) : 0; // Gallery thumbnails come straight out of the gallery index, if it has them
+        if (loadJobId == 0)
+        {
+            loadJobId = m_cppPlugin.QueueLoadFromImagePath(filePathAndIdentifier, maxImageWidth, priority);
+        }
+        if (galleryImageIndex != Helper.kIgnoreImageIndex)
+        {
+            m_queuedGalleryLoadJobs[loadJobId] = galleryImageIndex;
+        }
+
+        bool usePlaceholder = maxImageWidth == Helper.kMaxImageWidth; // Full size images show their EXIF thumbnail while they're decoded
+        StartCoroutine(LoadImageFromPathIntoImageSphereInternal(imageSphereController, sphereIndex, galleryImageIndex, filePathAndIdentifier, showLoading, loadJobId, usePlaceholder));
+
+        if (sphereIndex == Helper.kSkyboxSphereIndex)
+        {
+            imageSphereController.SetSkyboxTiledImage(m_cppPlugin, filePathAndIdentifier);
+        }
     }
 
     public void LoadImageFromURLIntoImageSphere(ImageSphereController imageSphereController, int sphereIndex, int postImageIndex, string url, string filePathAndIdentifier, bool showLoading)
@@ -91,23 +129,41 @@ public class ImageLoader : MonoBehaviour
     // Private/Helper functions
     // **************************
 
-    private IEnumerator LoadImageFromPathIntoImageSphereInternal(ImageSphereController imageSphereController, int sphereIndex, int galleryImageIndex, string filePathAndIdentifier, bool showLoading, int maxImageWidth)
+    private IEnumerator LoadImageFromPathIntoImageSphereInternal(ImageSphereController imageSphereController, int sphereIndex, int galleryImageIndex, string filePathAndIdentifier, bool showLoading, int loadJobId, bool usePlaceholder = false)
     {        
         if (galleryImageIndex != Helper.kIgnoreImageIndex && !m_gallery.IsValidRequest(galleryImageIndex))
         {            
+            m_queuedGalleryLoadJobs.Remove(loadJobId);
+            m_cppPlugin.ReleaseLoad(loadJobId);
+            yield break;
+        }
+
+        int textureIndex = ReserveAvailableTextureIndex();
+        if (textureIndex == -1) // Every texture is showing or being loaded into, so this image can't be
+        {
+            m_queuedGalleryLoadJobs.Remove(loadJobId);
+            m_cppPlugin.ReleaseLoad(loadJobId);
             yield break;
         }
 
-        m_isLoading = true;
+        int generation = m_loadingGeneration;
+        m_numImagesLoading++;
         if (showLoading)
         {
             m_loadingIcon.Display();
         }
 
-        int textureIndex = GetAvailableTextureIndex();
-        yield return m_cppPlugin.LoadImageFromPathIntoImageSphere(imageSphereController, sphereIndex, filePathAndIdentifier, textureIndex, maxImageWidth);
+        int placeholderTextureIndex = usePlaceholder ? ReserveAvailableTextureIndex() : CppPlugin.kNoPlaceholderTextureIndex; // Also -1 when there isn't one free
+        yield return m_cppPlugin.LoadImageFromPathIntoImageSphere(imageSphereController, sphereIndex, filePathAndIdentifier, textureIndex, loadJobId, placeholderTextureIndex);
+        if (generation != m_loadingGeneration) // InvalidateLoading() has already reset all of this, and its textures may have been reserved again since
+        {
+            yield break;
+        }
+        UnreserveTextureIndex(textureIndex);
+        UnreserveTextureIndex(placeholderTextureIndex);
+        m_queuedGalleryLoadJobs.Remove(loadJobId);
 
-        m_isLoading = false;
+        m_numImagesLoading--;
         if (showLoading)
         {
             m_loadingIcon.Hide();
@@ -121,43 +177,99 @@ public class ImageLoader : MonoBehaviour
             yield break;
         }
 
-        yield return m_appDirector.VerifyInternetConnection();
+        // Posts that have been shown before come straight off the disk cache, without being downloaded again
+        int cachedLoadJobId = m_cppPlugin.QueueLoadFromDiskCache(imageIdentifier, CppPlugin.LoadPriority.kVisibleSphere);
+        if (cachedLoadJobId == 0)
+        {
+            yield return m_appDirector.VerifyInternetConnection();
+        }
 
-        m_isLoading = true;
+        int generation = m_loadingGeneration;
+        m_numImagesLoading++;
         if (showLoading)
         {
             m_loadingIcon.Display();
         }
 
-        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Downloading image and getting stream through GetImageStreamFromURL() with url: " + url);
-        yield return m_threadJob.WaitFor();
-        bool debugOn = Debug.isDebugBuild;
-        Stream imageStream = null;
-        int contentLength = 0;
-        m_threadJob.Start( () => 
-            contentLength = GetImageStreamFromURL(url, ref imageStream, debugOn)
-        );
-        yield return m_threadJob.WaitFor();
-
-        if (contentLength > 0)
+        if (cachedLoadJobId != 0)
         {
-            int textureIndex = GetAvailableTextureIndex();
-            yield return m_cppPlugin.LoadImageFromStreamIntoImageSphere(imageSphereController, sphereIndex, imageStream, imageIdentifier, textureIndex, contentLength);
-
-            imageStream.Close();
+            int textureIndex = ReserveAvailableTextureIndex();
+            if (textureIndex != -1)
+            {
+                yield return m_cppPlugin.LoadImageFromPathIntoImageSphere(imageSphereController, sphereIndex, imageIdentifier, textureIndex, cachedLoadJobId);
+                if (generation == m_loadingGeneration) // Otherwise InvalidateLoading() has unreserved it, and it may have been reserved again since
+                {
+                    UnreserveTextureIndex(textureIndex);
+                }
+            }
+            else // Every texture is showing or being loaded into, so this image can't be
+            {
+                m_cppPlugin.ReleaseLoad(cachedLoadJobId);
+                imageSphereController.SetImageAtIndexToLoading(sphereIndex, true);
+            }
         }
         else
         {
-            imageSphereController.SetImageAtIndexToLoading(sphereIndex, true);
+            if (Debug.isDebugBuild) Debug.Log("------- VREEL: Downloading image and getting stream through GetImageStreamFromURL() with url: " + url);
+            yield return m_threadJob.WaitFor();
+            bool debugOn = Debug.isDebugBuild;
+            Stream imageStream = null;
+            int contentLength = 0;
+            m_threadJob.Start( () => 
+                contentLength = GetImageStreamFromURL(url, ref imageStream, debugOn)
+            );
+            yield return m_threadJob.WaitFor();
+
+            int textureIndex = (contentLength > 0 && generation == m_loadingGeneration) ? ReserveAvailableTextureIndex() : -1;
+            if (textureIndex != -1)
+            {
+                yield return m_cppPlugin.LoadImageFromStreamIntoImageSphere(imageSphereController, sphereIndex, imageStream, imageIdentifier, textureIndex, contentLength);
+                if (generation == m_loadingGeneration)
+                {
+                    UnreserveTextureIndex(textureIndex);
+                }
+            }
+            else if (generation == m_loadingGeneration)
+            {
+                imageSphereController.SetImageAtIndexToLoading(sphereIndex, true);
+            }
+
+            if (imageStream != null)
+            {
+                imageStream.Close();
+            }
+        }
+
+        if (generation != m_loadingGeneration) // InvalidateLoading() has already reset all of this
+        {
+            yield break;
         }
-            
-        m_isLoading = false;
+        m_numImagesLoading--;
         if (showLoading)
         {
             m_loadingIcon.Hide();
         }
     }                   
 
+    // When scrolling quickly through the Gallery, the thumbnails the user has already moved past get cancelled before they're decoded
+    private void ReleaseStaleGalleryLoads()
+    {
+        List<int> staleLoadJobIds = new List<int>();
+        foreach (KeyValuePair<int, int> queuedLoadJob in m_queuedGalleryLoadJobs)
+        {
+            if (!m_gallery.IsValidRequest(queuedLoadJob.Value))
+            {
+                staleLoadJobIds.Add(queuedLoadJob.Key);
+            }
+        }
+
+        foreach (int loadJobId in staleLoadJobIds)
+        {
+            m_cppPlugin.ReleaseLoad(loadJobId);
+            m_queuedGalleryLoadJobs.Remove(loadJobId);
+        }
+    }
+
     private int GetImageStreamFromURL(string url, ref Stream imageStream, bool debugOn)
     {        
         try
@@ -189,6 +301,26 @@ public class ImageLoader : MonoBehaviour
         return -1;
     }
 
+    // Images loading at the same time each need a texture of their own, so it stays in use until the ImageSphere has taken it over
+    private int ReserveAvailableTextureIndex()
+    {
+        int textureIndex = GetAvailableTextureIndex();
+        if (textureIndex != -1)
+        {
+            SetTextureInUse(textureIndex, true);
+            m_texturesReservedForLoading.Add(textureIndex);
+        }
+        return textureIndex;
+    }
+
+    private void UnreserveTextureIndex(int textureIndex)
+    {
+        if (m_texturesReservedForLoading.Remove(textureIndex))
+        {
+            SetTextureInUse(textureIndex, false);
+        }
+    }
+
     private void DebugPrintTextureIndexUsage()
     {
         if (Debug.isDebugBuild) 
@@ -156,6 +156,11 @@ public class ImageSphereController : MonoBehaviour
         }
     }    
 
+    public void SetSkyboxTiledImage(CppPlugin cppPlugin, string filePath)
+    {
+        m_imageSkybox.SetTiledImage(cppPlugin, filePath);
+    }
+
     public void SetMetadataAtIndex(int sphereIndex, string userId, string handle, string caption, int commentCount, int likes, bool likedByMe, bool updateMetadata)
     {
         if (0 <= sphereIndex && sphereIndex < GetNumSpheres())
@@ -16,6 +16,7 @@ public class ImageSkybox : MonoBehaviour
     private int m_currTextureIndex = -1; // ImageSkybox must track the index of the underlying texture it points to in C++ plugin
     private Texture2D m_skyboxTexture;
     private string m_imageIdentifier; // Points to where the Image came from (S3 Bucket, or Local Device)
+    private ImageSkyboxTiles m_tiles; // Shows images too wide for one texture at full resolution
 
     // **************************
     // Public functions
@@ -26,6 +27,7 @@ public class ImageSkybox : MonoBehaviour
         m_skyboxTexture = new Texture2D(2,2);
         m_imageIdentifier = "Invalid";
         m_myMaterial = gameObject.GetComponent<MeshRenderer>().material;
+        m_tiles = gameObject.AddComponent<ImageSkyboxTiles>();
     }
 
     public bool IsTextureValid()
@@ -58,6 +60,12 @@ public class ImageSkybox : MonoBehaviour
         transform.localRotation = rot;
     }
 
+    // The local image at filePath gets drawn at full resolution wherever it's looked at, once it's been set with SetImage()
+    public void SetTiledImage(CppPlugin cppPlugin, string filePath)
+    {
+        m_tiles.Show(cppPlugin, filePath, m_myMaterial);
+    }
+
     public void SetImage(Texture2D texture, string imageIdentifier, int textureIndex)
     {        
         if (imageIdentifier.Length <= 0)
@@ -66,6 +74,11 @@ public class ImageSkybox : MonoBehaviour
             return;
         }
 
+        if (imageIdentifier != m_tiles.GetImageIdentifier())
+        {
+            m_tiles.Hide();
+        }
+
         if (Debug.isDebugBuild) Debug.Log("------- VREEL: SetImage() got called with ImageIdentifier: " + imageIdentifier + ", and TextureIndex: " + textureIndex);
 
         m_imageIdentifier = imageIdentifier;
@@ -0,0 +1,188 @@
+﻿using UnityEngine;
+
+// Draws a tiled panorama's resident tiles over the ImageSkybox it sits on, each on a patch of sphere just inside the skybox's own, so
+//  wherever the user looks at a panorama too wide for one texture they see it at full resolution once its tiles arrive. Anywhere without
+//  a resident tile shows the skybox's ordinary texture through the gap
+public class ImageSkyboxTiles : MonoBehaviour 
+{
+    // **************************
+    // Member Variables
+    // **************************
+
+    private const int kNumSegments = 8; // Each tile's patch of sphere is kNumSegments x kNumSegments quads
+    private const float kPatchRadiusScale = 0.98f; // Relative to the skybox's sphere, so tiles are always in front of it
+
+    private ImageSkybox m_imageSkybox;
+    private CppPlugin m_cppPlugin;
+    private Material m_skyboxMaterial;
+    private int m_tiledPanoramaId = 0;
+    private string m_imageIdentifier = "Invalid";
+    private MeshRenderer[] m_tileRenderers; // By row then column, once the panorama's size is known
+
+    // **************************
+    // Public functions
+    // **************************
+
+    public void Awake()
+    {
+        m_imageSkybox = gameObject.GetComponent<ImageSkybox>();
+    }
+
+    public string GetImageIdentifier()
+    {
+        return m_imageIdentifier;
+    }
+
+    // Tiles are only drawn while the skybox is showing filePath
+    public void Show(CppPlugin cppPlugin, string filePath, Material skyboxMaterial)
+    {
+        Hide();
+
+        m_cppPlugin = cppPlugin;
+        m_skyboxMaterial = skyboxMaterial;
+        m_imageIdentifier = filePath;
+        m_tiledPanoramaId = m_cppPlugin.CreateTiledPanorama(filePath);
+        if (Debug.isDebugBuild) Debug.Log("------- VREEL: Created TiledPanorama " + m_tiledPanoramaId + " for " + filePath);
+    }
+
+    public void Hide()
+    {
+        if (m_tiledPanoramaId != 0)
+        {
+            m_cppPlugin.ReleasePanorama(m_tiledPanoramaId);
+            m_tiledPanoramaId = 0;
+        }
+        m_imageIdentifier = "Invalid";
+
+        if (m_tileRenderers != null)
+        {
+            foreach (MeshRenderer tileRenderer in m_tileRenderers)
+            {
+                Destroy(tileRenderer.GetComponent<MeshFilter>().sharedMesh);
+                Destroy(tileRenderer.material);
+                Destroy(tileRenderer.gameObject);
+            }
+            m_tileRenderers = null;
+        }
+    }
+
+    public void Update()
+    {
+        if (m_tiledPanoramaId == 0 || Camera.main == null)
+        {
+            return;
+        }
+
+        // Yaw 0 faces the middle of the panorama, which is along the skybox's forward axis
+        Vector3 viewDirection = transform.InverseTransformDirection(Camera.main.transform.forward).normalized;
+        float yaw = Mathf.Atan2(viewDirection.x, viewDirection.z) * Mathf.Rad2Deg;
+        float pitch = Mathf.Asin(Mathf.Clamp(viewDirection.y, -1.0f, 1.0f)) * Mathf.Rad2Deg;
+        m_cppPlugin.UpdatePanorama(m_tiledPanoramaId, yaw, pitch);
+
+        if (m_tileRenderers == null && m_cppPlugin.GetPanoramaNumColumns(m_tiledPanoramaId) > 0)
+        {
+            CreateTilePatches();
+        }
+        if (m_tileRenderers == null)
+        {
+            return;
+        }
+
+        bool isShowingPanorama = m_imageSkybox.GetImageIdentifier() == m_imageIdentifier;
+        int numColumns = m_cppPlugin.GetPanoramaNumColumns(m_tiledPanoramaId);
+        for (int i = 0; i < m_tileRenderers.Length; i++)
+        {
+            Texture2D tileTexture = isShowingPanorama ? m_cppPlugin.GetPanoramaTileTexture(m_tiledPanoramaId, i % numColumns, i / numColumns) : null;
+            m_tileRenderers[i].enabled = tileTexture != null;
+            if (tileTexture != null)
+            {
+                m_tileRenderers[i].material.mainTexture = tileTexture;
+                m_tileRenderers[i].material.SetFloat("_Dim", m_skyboxMaterial.GetFloat("_Dim"));
+            }
+        }
+    }
+
+    public void OnDestroy()
+    {
+        Hide();
+    }
+
+    // **************************
+    // Private/Helper functions
+    // **************************
+
+    private void CreateTilePatches()
+    {
+        int imageWidth = m_cppPlugin.GetPanoramaWidth(m_tiledPanoramaId);
+        int imageHeight = m_cppPlugin.GetPanoramaHeight(m_tiledPanoramaId);
+        int numColumns = m_cppPlugin.GetPanoramaNumColumns(m_tiledPanoramaId);
+        int numRows = m_cppPlugin.GetPanoramaNumRows(m_tiledPanoramaId);
+        int tileSize = m_cppPlugin.GetPanoramaTileSize();
+        float radius = gameObject.GetComponent<MeshFilter>().sharedMesh.bounds.extents.x * kPatchRadiusScale;
+
+        m_tileRenderers = new MeshRenderer[numColumns * numRows];
+        for (int row = 0; row < numRows; row++)
+        {
+            for (int column = 0; column < numColumns; column++)
+            {
+                int x = column * tileSize;
+                int y = row * tileSize;
+                GameObject tileObject = new GameObject("PanoramaTile" + column + "x" + row);
+                tileObject.transform.SetParent(transform, false);
+                tileObject.AddComponent<MeshFilter>().sharedMesh = CreateTileMesh(x, y, Mathf.Min(tileSize, imageWidth - x), Mathf.Min(tileSize, imageHeight - y), 
+                    imageWidth, imageHeight, tileSize, radius);
+
+                MeshRenderer tileRenderer = tileObject.AddComponent<MeshRenderer>();
+                tileRenderer.material = new Material(m_skyboxMaterial);
+                tileRenderer.material.SetFloat("_FlipY", 0.0f); // Tile meshes already have their rows top down, as they're uploaded
+                tileRenderer.enabled = false;
+                m_tileRenderers[row * numColumns + column] = tileRenderer;
+            }
+        }
+    }
+
+    // The patch of sphere that the width x height pixels at (x, y) of the equirectangular image cover, facing inwards
+    private Mesh CreateTileMesh(int x, int y, int width, int height, int imageWidth, int imageHeight, int tileSize, float radius)
+    {
+        Vector3[] vertices = new Vector3[(kNumSegments + 1) * (kNumSegments + 1)];
+        Vector2[] uvs = new Vector2[vertices.Length];
+        for (int j = 0; j <= kNumSegments; j++)
+        {
+            for (int i = 0; i <= kNumSegments; i++)
+            {
+                float imageX = x + width * i / (float)kNumSegments;
+                float imageY = y + height * j / (float)kNumSegments;
+                float longitude = (imageX / imageWidth - 0.5f) * 2.0f * Mathf.PI;
+                float latitude = (0.5f - imageY / imageHeight) * Mathf.PI;
+                vertices[j * (kNumSegments + 1) + i] = radius * new Vector3(Mathf.Cos(latitude) * Mathf.Sin(longitude), Mathf.Sin(latitude), Mathf.Cos(latitude) * Mathf.Cos(longitude));
+                uvs[j * (kNumSegments + 1) + i] = new Vector2((imageX - x) / tileSize, (imageY - y) / tileSize);
+            }
+        }
+
+        // Clockwise as seen from the centre of the sphere
+        int[] triangles = new int[kNumSegments * kNumSegments * 6];
+        for (int j = 0; j < kNumSegments; j++)
+        {
+            for (int i = 0; i < kNumSegments; i++)
+            {
+                int topLeft = j * (kNumSegments + 1) + i;
+                int bottomLeft = topLeft + kNumSegments + 1;
+                int triangle = (j * kNumSegments + i) * 6;
+                triangles[triangle + 0] = topLeft;
+                triangles[triangle + 1] = topLeft + 1;
+                triangles[triangle + 2] = bottomLeft + 1;
+                triangles[triangle + 3] = topLeft;
+                triangles[triangle + 4] = bottomLeft + 1;
+                triangles[triangle + 5] = bottomLeft;
+            }
+        }
+
+        Mesh mesh = new Mesh();
+        mesh.vertices = vertices;
+        mesh.uv = uvs;
+        mesh.triangles = triangles;
+        mesh.RecalculateNormals();
+        mesh.RecalculateBounds();
+        return mesh;
+    }
+}
\ No newline at end of file
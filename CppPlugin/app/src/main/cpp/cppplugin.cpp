@@ -5,7 +5,26 @@
 #include <ctime>
 #include <chrono>
 #include <fstream>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <map>
+#include <cmath>
+#include <cstring>
+#include <climits>
 #include <android/log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <strings.h>
+#include <EGL/egl.h>
 #include <GLES3/gl3.h>
 #include "Unity/IUnityGraphics.h"
 #define STB_IMAGE_IMPLEMENTATION
@@ -20,22 +39,130 @@
 
 int m_numInits = 0; // Acts a bit like a reference counter, ensuring only 1 Init() and 1 Terminate()
 
-GLuint* m_textureIDs;
+GLuint* m_textureIDs; // The texture each index currently uses - either its own, or one it has leased from the pool
+GLuint* m_unpooledTextureIDs; // Each index's own texture, used whenever there isn't a pooled texture the right size
 int m_initMaxNumTextures = 0; // Set on Init - sets maximum textures to gen!
+
+struct TextureSizeClass
+{
+    int width;
+    int height;
+    GLenum internalFormat; // GL_RGB565, GL_RGB8 or a compressed format such as GL_COMPRESSED_RGB8_ETC2
+    int numTextures;
+};
+
+struct PooledTexture
+{
+    GLuint id;
+    int width;
+    int height;
+    GLenum internalFormat;
+    int textureIndex; // The index that's leased it, or -1 if it's free
+};
+
+std::vector<TextureSizeClass> m_textureSizeClasses; // Set before Init, which allocates the pool's textures
+std::vector<PooledTexture> m_pooledTextures;
+std::mutex m_pooledTexturesMutex; // Uploads can lease textures from the UploadThread while the render thread does the same
 int m_currTextureIndex = 0;
 
 stbi_uc* m_pCurrImage = NULL;
 bool m_useExif = false; // Only relates to files that live on the phone, not to files in the cloud
+bool m_useExifPlaceholder = false; // Loads of files decode their EXIF thumbnail first, to be shown until the image is - see UploadPlaceholder()
 int m_maxImageWidth = 4096; // 2^12 to begin with - This is set at runtime in order to limit size of Gallery Images
+
+// How images wider than their maxImageWidth are resampled down to it, as set by SetResampleMode()
+enum ResampleMode
+{
+    kResampleHalve = 0,   // Halved until they fit, averaging square boxes of pixels - so they only ever end up a power of 2 smaller
+    kResampleArea = 1,    // To exactly maxImageWidth, each pixel averaging the part of the image it covers
+    kResampleLanczos3 = 2 // To exactly maxImageWidth through a Lanczos-3 filter, which keeps edges sharper for around twice the work
+};
+
+int m_resampleMode = kResampleHalve;
+size_t m_maxImageBytes = 0; // With an exact ResampleMode, images are also kept narrow enough for their base level to fit in this - 0 for no limit
 int m_currImageWidth = 0;
 int m_currImageHeight = 0;
 
 const int kNumStbChannels = 3;
 const int kStrideRGB565 = 2;
+const int kMaxJpegScaleShift = 3; // The JPEG decoder can downscale by at most 1/8th in the DCT-domain
+const GLuint64 kWaitForGpuTimeout = 100 * 1000 * 1000; // In nanoseconds
+const int kMaxMipLevels = 16;
+const int kEtc2BlockSize = 8; // Bytes in each 4x4 block of GL_COMPRESSED_RGB8_ETC2
+
+// A block-compressed texture format, as uploaded by UploadCompressedBlockRows()
+struct CompressedFormat
+{
+    GLenum internalFormat;
+    int blockWidth;
+    int blockHeight;
+    int blockSize; // In bytes
+};
+
+const CompressedFormat kEtc2Format = { GL_COMPRESSED_RGB8_ETC2, 4, 4, kEtc2BlockSize };
+std::atomic<bool> m_isAstcSupported(false); // Whether KTX files of ASTC blocks can be loaded, which Init() finds out
 bool m_rgb565On = false;
-int m_maxPixelsUploadedPerFrame = 1 * 1024 * 1024;
+bool m_useCpuMipmaps = false; // Loads build their own mip levels as they finish decoding, rather than glGenerateMipmap() making them
+bool m_useProgressiveUpload = false; // Loads with their own mip levels upload them coarsest first, so they can be shown before they're complete
+bool m_useViewPriorityUpload = false; // Loads upload the part of the sphere in view first, see UploadViewTiles()
+bool m_useCubemaps = false; // Loads also convert their image into cubemap faces once it's decoded, see UploadLoadJobIntoCubemap()
+std::atomic<int> m_maxCubemapFaceSize(2048); // GL_MAX_CUBE_MAP_TEXTURE_SIZE, which Init() finds out - 2048 is as small as GLES 3 allows
+bool m_useEtc2Compression = false; // Loads compress every mip level to ETC2 once it's decoded and are uploaded like that, see CompressLoadJobToEtc2()
+std::atomic<float> m_viewYaw(0.0f); // In degrees, where the user's looking - set from C# every frame
+std::atomic<float> m_viewPitch(0.0f);
+const int kNumViewTilesAcross = 16; // View-priority uploads split the base level into at most this many tiles each way
+const float kViewHalfAngle = 45.0f; // In degrees, how far a tile's centre can be from the view direction and still count as in view
+const float kDegreesToRadians = 3.14159265f / 180.0f;
+
+class TiledPanorama;
+std::mutex m_tiledPanoramasMutex;
+std::map<int, std::shared_ptr<TiledPanorama>> m_tiledPanoramas; // Guarded by m_tiledPanoramasMutex, by id
+int m_nextTiledPanoramaId = 1;
+
+struct PanoramaTileTexture
+{
+    GLuint id;
+    int panoramaId;    // The panorama whose tile it holds, or 0 if it's free
+    int lastUsedFrame; // The last UpdateTiledPanoramas() its tile was in view for
+};
+
+std::vector<PanoramaTileTexture> m_panoramaTileTextures; // Allocated on Init() and from then on only touched by the render thread, apart from their ids
+int m_panoramaTileSize = 1024; // Set before Init(), along with the format and number of tile textures - which fixes how much GPU memory tiles take up
+int m_numPanoramaTileTextures = 0;
+bool m_panoramaTilesRGB565On = false;
+int m_panoramaFrame = 0;
+const float kPanoramaViewMargin = 15.0f; // In degrees, how far beyond kViewHalfAngle tiles are decoded ahead of being looked at
+std::atomic<int> m_maxPixelsUploadedPerFrame(1 * 1024 * 1024); // Follows the measured upload throughput when there's an upload budget
+const int kMinPixelsUploadedPerFrame = 16 * 1024;
+const int kMaxAdaptivePixelsUploadedPerFrame = 4096 * 4096;
+const int kMinScanlinesPerBand = 16; // Bands of fewer full-width scanlines than this are uploaded as narrower tiles instead
+std::atomic<float> m_uploadBudgetMilliseconds(0.0f); // How long each frame's uploads should take - 0 keeps m_maxPixelsUploadedPerFrame fixed
+std::atomic<float> m_uploadPixelsPerMillisecond(0.0f); // Measured upload throughput, see RecordUploadTime()
+std::mutex m_uploadTimingMutex; // Uploads can be timed on the UploadThread and the render thread at once
+float m_averageUploadPixels = 0.0f;
+float m_averageUploadMilliseconds = 0.0f;
 bool m_isLoadingIntoTexture = false;
 GLint m_textureLoadingYOffset = 0;
+int m_textureLoadingLevel = 0;
+std::atomic<int> m_numScanlinesInWorkingMemory(0); // Rows of m_pCurrImage ready to be uploaded - when streaming these are written by the decoding thread
+
+struct LoadJob;
+std::shared_ptr<LoadJob> m_pWorkingMemoryJob; // The load whose pixels m_pCurrImage points at, keeping them alive until they're uploaded
+
+std::mutex m_uploadingJobsMutex;
+std::condition_variable m_uploadingJobsChanged;
+std::vector<std::shared_ptr<LoadJob>> m_uploadingJobs; // Loads being uploaded into their own textures, see UploadLoadJobIntoTexture()
+int m_firstUploadingJob = 0; // Only used by whichever thread uploads, to take turns at which load uploads first each time
+
+class UploadThread;
+UploadThread* m_pUploadThread = NULL; // Created on Init() if m_useUploadThread, and it managed to share Unity's EGL context
+bool m_useUploadThread = false;
+
+class PixelUnpackBufferRing;
+PixelUnpackBufferRing* m_pPixelUnpackBuffers = NULL; // Created on Init() if m_usePixelUnpackBuffers, and only used by whichever thread uploads
+bool m_usePixelUnpackBuffers = true;
+std::mutex m_pixelUnpackBuffersMutex; // Guards the state of the PixelUnpackBufferRing's buffers, and every LoadJob's stagedYOffset
+std::condition_variable m_pixelUnpackBuffersChanged;
 
 // **************************
 // Helper functions
@@ -64,482 +191,5555 @@ static void CheckGlError(const char* op)
     }
 }
 
-// Trying this out to see if it improves performance... SEEMS USELESS FROM "wctduration.count()"
-void RenewTextureHandle()
-{
-    LOGI("Calling RenewTextureHandle()");
-
-    LOGI("glDeleteTextures(1, %d)", m_currTextureIndex);
-    auto wcts = std::chrono::high_resolution_clock::now();
-    glDeleteTextures(1, m_textureIDs + m_currTextureIndex);
-    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
-
-    LOGI("glDeleteTextures() walltime = %f", wctduration.count());
-    PrintAllGlError();
-
-    LOGI("glGenTextures(1, %d)", m_currTextureIndex);
-    glGenTextures(1, m_textureIDs + m_currTextureIndex);
-    PrintAllGlError();
-}
-
-stbi_uc* ResampleIntegerRGB(stbi_uc *rgb_in, int w, int h, int stride, int new_w, int new_h, int new_stride)
+int CalcNumMipLevels(int width, int height)
 {
-    stbi_uc* result = (stbi_uc*) stbi__malloc((size_t) new_h * new_stride);
-    int x_ratio = w / new_w;
-    int y_ratio = h / new_h;
-    int area_ratio = x_ratio * y_ratio;
-
-    for (int y = 0; y != new_h; ++y)
+    int numLevels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
     {
-        for (int x = 0; x != new_w; ++x)
-        {
-            // take the average of the pixels in the NxM box
-            int r = 0, g = 0, b = 0;
-            for (int j = 0; j != x_ratio; ++j)
-            {
-                for (int i = 0; i != y_ratio; ++i)
-                {
-                    r += rgb_in[0 + (x*x_ratio+i)*3 + (y*y_ratio+j)*stride];
-                    g += rgb_in[1 + (x*x_ratio+i)*3 + (y*y_ratio+j)*stride];
-                    b += rgb_in[2 + (x*x_ratio+i)*3 + (y*y_ratio+j)*stride];
-                }
-            }
-
-            result[0 + x*3 + y*new_stride] = stbi_uc(r / area_ratio);
-            result[1 + x*3 + y*new_stride] = stbi_uc(g / area_ratio);
-            result[2 + x*3 + y*new_stride] = stbi_uc(b / area_ratio);
-        }
+        numLevels++;
     }
-    return result;
+    return numLevels;
 }
 
-stbi_uc* ResampleIntegerRGB565(stbi_uc *rgb_in, int w, int h, int stride, int new_w, int new_h, int new_stride)
+// Allocates every pooled texture up front, with immutable storage for its full mip chain
+void AllocatePooledTextures()
 {
-    stbi_uc* result = (stbi_uc*) stbi__malloc((size_t) new_h * new_stride);
-    int x_ratio = w / new_w;
-    int y_ratio = h / new_h;
-    int area_ratio = x_ratio * y_ratio;
+    auto wcts = std::chrono::high_resolution_clock::now();
 
-    for (int y = 0; y != new_h; ++y)
+    std::lock_guard<std::mutex> lock(m_pooledTexturesMutex);
+    for (const TextureSizeClass& sizeClass : m_textureSizeClasses)
     {
-        for (int x = 0; x != new_w; ++x)
+        const int kNumLevels = CalcNumMipLevels(sizeClass.width, sizeClass.height);
+        for (int i = 0; i < sizeClass.numTextures; i++)
         {
-            // take the average of the pixels in the NxM box
-            int r = 0, g = 0, b = 0;
-            for (int j = 0; j != x_ratio; ++j)
-            {
-                for (int i = 0; i != y_ratio; ++i)
-                {
-                    r += rgb_in[0 + (x * x_ratio + i) * 3 + (y * y_ratio + j) * stride];
-                    g += rgb_in[1 + (x * x_ratio + i) * 3 + (y * y_ratio + j) * stride];
-                    b += rgb_in[2 + (x * x_ratio + i) * 3 + (y * y_ratio + j) * stride];
-                }
-            }
-            stbi_uc r8 = stbi_uc(r / area_ratio);
-            stbi_uc g8 = stbi_uc(g / area_ratio);
-            stbi_uc b8 = stbi_uc(b / area_ratio);
-            (uint16_t &) result[x * 2 + y * new_stride] = (uint16_t) (
-                    ((r8 >> 3) << 11) |
-                    ((g8 >> 2) << 5) |
-                    ((b8 >> 3) << 0)
-            );
+            PooledTexture pooledTexture = { 0, sizeClass.width, sizeClass.height, sizeClass.internalFormat, -1 };
+            glGenTextures(1, &pooledTexture.id);
+            glBindTexture(GL_TEXTURE_2D, pooledTexture.id);
+            LOGI("glTexStorage2D(GL_TEXTURE_2D, %d, 0x%x, %d, %d) into pooled texture %u", kNumLevels, sizeClass.internalFormat,
+                 sizeClass.width, sizeClass.height, pooledTexture.id);
+            glTexStorage2D(GL_TEXTURE_2D, kNumLevels, sizeClass.internalFormat, sizeClass.width, sizeClass.height);
+            m_pooledTextures.push_back(pooledTexture);
         }
     }
-    return result;
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("AllocatePooledTextures() walltime = %f, for %d textures", wctduration.count(), (int) m_pooledTextures.size());
+    PrintAllGlError();
 }
 
-//CURRENTLY UNUSED
-template<int x_ratio, int y_ratio>
-stbi_uc* ResampleConstRGB(stbi_uc *rgb_in, int w, int h, int stride, int new_stride)
+void AllocatePanoramaTileTextures()
 {
-    int new_w = w / x_ratio;
-    int new_h = h / y_ratio;
-    stbi_uc* result = (stbi_uc*) stbi__malloc((size_t) new_h * new_stride);
-    constexpr uint32_t area_ratio = (uint32_t) x_ratio * y_ratio;
-    uint32_t row_len = (uint32_t) new_w * x_ratio * 3;
-    std::vector<uint32_t> row(row_len);
-
-    for (int y = 0; y != new_h; ++y)
+    const int kNumLevels = CalcNumMipLevels(m_panoramaTileSize, m_panoramaTileSize);
+    for (int i = 0; i < m_numPanoramaTileTextures; i++)
     {
-        for (int k = 0; k != row_len; ++k)
-        {
-            row[k] = rgb_in[k + (y*x_ratio+0)*stride];
-        }
-
-        for (int j = 1; j != y_ratio; ++j)
-        {
-            for (int k = 0; k != row_len; ++k)
-            {
-                row[k] += rgb_in[k + (y*x_ratio+j)*stride];
-            }
-        }
-
-        for (int x = 0; x != new_w; ++x)
-        {
-            for (int comp = 0; comp != 3; ++comp)
-            {
-                uint32_t r = row[x * (x_ratio * 3) + comp];
-                for (int i = 1; i != x_ratio; ++i)
-                {
-                    r += row[x * (x_ratio * 3) + i * 3 + comp];
-                }
-                result[comp + x*3 + y*new_stride] = stbi_uc(r / area_ratio);
-            }
-        }
+        PanoramaTileTexture tileTexture = { 0, 0, -1 };
+        glGenTextures(1, &tileTexture.id);
+        glBindTexture(GL_TEXTURE_2D, tileTexture.id);
+        glTexStorage2D(GL_TEXTURE_2D, kNumLevels, m_panoramaTilesRGB565On ? GL_RGB565 : GL_RGB8, m_panoramaTileSize, m_panoramaTileSize);
+        m_panoramaTileTextures.push_back(tileTexture);
     }
-    return result;
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    LOGI("Allocated %d panorama tile textures of %d x %d", m_numPanoramaTileTextures, m_panoramaTileSize, m_panoramaTileSize);
+    PrintAllGlError();
 }
 
-bool ReampleImageToMaxWidthAndNewType()
+void DeletePanoramaTileTextures()
 {
-    auto wcts = std::chrono::high_resolution_clock::now();
-
-    int newWidth = m_currImageWidth;
-    while (newWidth > m_maxImageWidth)
+    for (const PanoramaTileTexture& tileTexture : m_panoramaTileTextures)
     {
-        newWidth /= 2;
+        glDeleteTextures(1, &tileTexture.id);
     }
+    m_panoramaTileTextures.clear();
+    PrintAllGlError();
+}
 
-    int newHeight = newWidth / 2; // because of 2:1 ratio for 360-images
-    int newStride = newWidth;
-    stbi_uc* new_rgb = nullptr;
-
-    if (m_rgb565On)
-    {
-        newStride = newWidth * kStrideRGB565;
-        new_rgb = ResampleIntegerRGB565(m_pCurrImage, m_currImageWidth, m_currImageHeight, m_currImageWidth * kNumStbChannels,
-                                        newWidth, newHeight, newStride);
-    }
-    else
+void DeletePooledTextures()
+{
+    std::lock_guard<std::mutex> lock(m_pooledTexturesMutex);
+    for (const PooledTexture& pooledTexture : m_pooledTextures)
     {
-        newStride = newWidth * kNumStbChannels;
-        new_rgb = ResampleIntegerRGB(m_pCurrImage, m_currImageWidth, m_currImageHeight, m_currImageWidth * kNumStbChannels,
-                                        newWidth, newHeight, newStride);
+        glDeleteTextures(1, &pooledTexture.id);
     }
-
-    memcpy(m_pCurrImage, new_rgb, (size_t) newHeight * newStride);
-    stbi_image_free(new_rgb);
-
-    m_currImageWidth = newWidth;
-    m_currImageHeight = newHeight;
-
-    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
-    LOGI("ReampleImageToMaxWidthAndNewType() walltime = %f", wctduration.count());
-
-    return true;
+    m_pooledTextures.clear();
+    PrintAllGlError();
 }
 
-// return a vector containing JPEG thummnail for an EXif file.
-std::vector<char> FindExifJpeg(const char* pFileName)
+// Returns 0 if every pooled texture of that size and format is already leased
+GLuint LeasePooledTexture(int textureIndex, int width, int height, GLenum internalFormat)
 {
-    std::ifstream f(pFileName, std::ios::binary);
-
-    // Loop over JPEG markers
-    while (!f.eof())
+    std::lock_guard<std::mutex> lock(m_pooledTexturesMutex);
+    for (PooledTexture& pooledTexture : m_pooledTextures)
     {
-        int t = (uint8_t)f.get();
-        //printf("%08x %02x\n", (int)f.tellg()-1, t);
-        if (t != 0xff)
+        if (pooledTexture.textureIndex == -1 && pooledTexture.width == width && pooledTexture.height == height && pooledTexture.internalFormat == internalFormat)
         {
-            break;
-        }
-        int marker = (uint8_t)f.get();
-
-        if (marker == 0xd8 || marker == 0xd9)
-        {
-            // Start/end of image
-            //printf("%08x %02x %02x size = %04x\n", (int)f.tellg(), t, marker, 0);
-        }
-        else if (marker == 0xda)
-        {
-            // start of JPEG data
-            //printf("%08x %02x %02x size = %04x\n", (int)f.tellg(), t, marker, 0);
-            break;
-        }
-        else
-        {
-            // General tag: size is encoded in two bytes.
-            int hibyte = (uint8_t)f.get();
-            int lobyte = (uint8_t)f.get();
-            int size = hibyte * 0x100 + lobyte;
-            //LOGI("%08x %02x %02x size = %04d\n", (int)f.tellg(), t, marker, size);
-
-            // ff e1 tag is APP1
-            if (marker == 0xe1)
-            {
-                std::vector<char> exif(size-2);
-                f.read(exif.data(), size-2);
-                char *d = exif.data();
-                char *base = d + 6;
-                // APP1 tags with "Exif\0\0" are Exif data encoded as TIFF data.
-                static const char exifHdrLe[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00, 0x49, 0x49, 0x2A, 0x00, 0x08, 0x00, 0x00, 0x00 };
-                static const char exifHdrBe[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00, 0x4D, 0x4D, 0x00, 0x2A, 0x00, 0x00, 0x00, 0x08 };
-                auto sz = sizeof(exifHdrLe);
-                bool isLe = exif.size() > sz + 2 && std::mismatch(d, d+sz, exifHdrLe).first == d+sz;
-                bool isBe = exif.size() > sz + 2 && std::mismatch(d, d+sz, exifHdrBe).first == d+sz;
-                char *dmax = d + exif.size();
-
-                // Two byte orders are possible (madness!)
-                if (isLe || isBe)
-                {
-                    //printf("EXIF!\n");
-                    d += sz;
-                    auto b2 = [&]()
-                    {
-                        int b0 = (uint8_t)*d++;
-                        int b1 = (uint8_t)*d++;
-                        return isBe ? b0 * 0x100 + b1 : b1 * 0x100 + b0;
-                    };
-                    auto b4 = [&]()
-                    {
-                        int w0 = b2();
-                        int w1 = b2();
-                        return isBe ? w0 * 0x10000 + w1 : w1 * 0x10000 + w0;
-                    };
-
-                    // Loop over TIFF tags finding the JPEG image data
-                    int jpegOffset  = 0;
-                    int jpegSize = 0;
-                    while (d+2 <= dmax)
-                    {
-                        int numEntries = b2();
-                        //printf("ne=%d\n", numEntries);
-                        if (d + numEntries * 12 + 4 > dmax)
-                        {
-                            break;
-                        }
-                        for (int i = 0; i != numEntries; ++i)
-                        {
-                            int tag = b2();
-                            int fmt = b2();
-                            int nc = b4();
-                            int off = b4();
-                            //printf("%04x %04x %08x %08x\n", tag, fmt, nc, off);
-                            if (tag == 0x0201) jpegOffset = off;
-                            if (tag == 0x0202) jpegSize = off;
-                        }
-                        int next = b4();
-                        //printf("%08x\n", next);
-                        if (next)
-                        {
-                            d = base + next;
-                        }
-                        else
-                            break;
-                    }
-                    //printf("%08x..%08x\n", jpegOffset, jpegSize);
-                    if (jpegOffset && jpegSize && jpegOffset > 0 && base + jpegOffset <= dmax)
-                    {
-                        //printf("jpeg found\n");
-                        char *b = base + jpegOffset;
-                        char *e = b + jpegSize;
-                        return std::vector<char>(b, e);
-                    }
-                }
-            }
-            else
-            {
-                f.seekg(size-2, std::ios::cur);
-            }
+            pooledTexture.textureIndex = textureIndex;
+            return pooledTexture.id;
         }
     }
-
-    return std::vector<char>{};
+    return 0;
 }
 
-// **************************
-// Private functions - accessed through OnRenderEvent()
-// **************************
-
-// These are functions that use OpenGL and hence must be run from the Render Thread, through C#'s GL.IssuePluginEvent()
-enum RenderFunctions
-{
-    kInit = 0,
-    kCreateEmptyTexture = 1,
-    kLoadScanlinesIntoTextureFromWorkingMemory = 2,
-    kRenewTextureHandle = 3,
-    kTerminate = 4
-};
-
-void Init()
+// Frees up whichever pooled texture the index has leased, if any - so whatever the index was showing must no longer be needed
+void ReturnPooledTexture(int textureIndex)
 {
-    if (m_numInits == 0)
+    std::lock_guard<std::mutex> lock(m_pooledTexturesMutex);
+    for (PooledTexture& pooledTexture : m_pooledTextures)
     {
-        LOGI("Calling Init()!");
-
-        LOGI("glGenTextures(%d, m_textureIDs)", m_initMaxNumTextures);
-        m_textureIDs = new GLuint[m_initMaxNumTextures];
-        glGenTextures(m_initMaxNumTextures, m_textureIDs);
-        PrintAllGlError();
-
-        for (int i = 0; i < m_initMaxNumTextures; i++)
+        if (pooledTexture.textureIndex == textureIndex)
         {
-            LOGI("Genned texture to Handle = %u \n", m_textureIDs[i]);
+            pooledTexture.textureIndex = -1;
         }
-
-        LOGI("Finished Init()!");
     }
-
-    m_numInits++;
 }
 
-void Terminate()
+// Trying this out to see if it improves performance... SEEMS USELESS FROM "wctduration.count()"
+void RenewTexture(int textureIndex)
 {
-    m_numInits--;
-
-    if (m_numInits == 0)
-    {
-        LOGI("Calling Terminate()!");
+    ReturnPooledTexture(textureIndex);
 
-        LOGI("glDeleteTextures(%d, m_textureIDs)", m_initMaxNumTextures);
-        glDeleteTextures(m_initMaxNumTextures, m_textureIDs);
-        PrintAllGlError();
+    LOGI("glDeleteTextures(1, %d)", textureIndex);
+    auto wcts = std::chrono::high_resolution_clock::now();
+    glDeleteTextures(1, m_unpooledTextureIDs + textureIndex);
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
 
-        delete[] m_textureIDs;
+    LOGI("glDeleteTextures() walltime = %f", wctduration.count());
+    PrintAllGlError();
 
-        LOGI("Finished Terminate()!");
-    }
+    LOGI("glGenTextures(1, %d)", textureIndex);
+    glGenTextures(1, m_unpooledTextureIDs + textureIndex);
+    m_textureIDs[textureIndex] = m_unpooledTextureIDs[textureIndex];
+    PrintAllGlError();
 }
 
-void CreateEmptyTexture()
+// CreateEmptyTexture() now acquires a texture itself, so this is no longer needed beforehand - it just gives up the current index's texture
+void RenewTextureHandle()
 {
-    LOGI("Calling CreateEmptyTexture()");
+    LOGI("Calling RenewTextureHandle()");
+    RenewTexture(m_currTextureIndex);
+}
 
+// Defines level 0, along with the rest of the mip chain if hasCpuMipmaps - otherwise glGenerateMipmap() defines those once it's uploaded
+void AllocateTexture(int textureIndex, int width, int height, bool rgb565On, bool hasCpuMipmaps)
+{
     LOGI("glBindTexture(GL_TEXTURE_2D, textureId)");
-    GLuint textureId = m_textureIDs[m_currTextureIndex];
+    GLuint textureId = m_textureIDs[textureIndex];
     glBindTexture(GL_TEXTURE_2D, textureId);
     PrintAllGlError();
 
     auto wcts = std::chrono::high_resolution_clock::now();
 
-    if (m_rgb565On)
+    if (rgb565On)
     {
-        LOGI("glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, %d, %d, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL)", m_currImageWidth, m_currImageHeight);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_currImageWidth, m_currImageHeight, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
+        LOGI("glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, %d, %d, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL)", width, height);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
     }
     else
     {
-        LOGI("glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, %d, %d, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL)", m_currImageWidth, m_currImageHeight);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_currImageWidth, m_currImageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        LOGI("glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, %d, %d, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL)", width, height);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    // Loads that build their own mip levels upload straight into them, so they have to exist beforehand
+    const int kNumLevels = hasCpuMipmaps ? CalcNumMipLevels(width, height) : 1;
+    for (int level = 1; level < kNumLevels; level++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, std::max(1, width >> level), std::max(1, height >> level), 0, GL_RGB,
+                     rgb565On ? GL_UNSIGNED_SHORT_5_6_5 : GL_UNSIGNED_BYTE, NULL);
     }
 
     std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
     LOGI("glTexImage2D() walltime = %f", wctduration.count());
     PrintAllGlError();
+}
 
-    m_isLoadingIntoTexture = true;
-    m_textureLoadingYOffset = 0;
+// Gives the index a texture to upload a width x height image into, giving up whatever it was showing. This is a pooled texture whenever
+//  one that size is free, so only sub-image uploads are needed - otherwise the index's own texture is recreated and reallocated
+void AcquireTexture(int textureIndex, int width, int height, bool rgb565On, bool hasCpuMipmaps)
+{
+    ReturnPooledTexture(textureIndex);
 
-    LOGI("Finished CreateEmptyTexture()!");
+    GLuint pooledTextureId = LeasePooledTexture(textureIndex, width, height, rgb565On ? GL_RGB565 : GL_RGB8);
+    if (pooledTextureId != 0)
+    {
+        LOGI("Texture index %d has leased pooled texture %u", textureIndex, pooledTextureId);
+        m_textureIDs[textureIndex] = pooledTextureId;
+
+        // A progressive upload might have left it showing a coarser level
+        glBindTexture(GL_TEXTURE_2D, pooledTextureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        PrintAllGlError();
+        return;
+    }
+
+    LOGI("There's no free %d x %d pooled texture for texture index %d", width, height, textureIndex);
+    RenewTexture(textureIndex);
+    AllocateTexture(textureIndex, width, height, rgb565On, hasCpuMipmaps);
 }
 
-// This function is called repeatedly like a for-loop with the variable m_textureLoadingYOffset updating every iteration
-void LoadScanlinesIntoTextureFromWorkingMemory()
+// As AcquireTexture(), for a texture of compressed internalFormat. Compressed textures can only be given immutable storage, so when there's
+//  no pooled one free the index's own texture is recreated with storage for its full mip chain
+void AcquireCompressedTexture(int textureIndex, int width, int height, GLenum internalFormat)
 {
-    LOGI("Calling LoadScanlinesIntoTextureFromWorkingMemory()");
+    ReturnPooledTexture(textureIndex);
 
-    LOGI("glBindTexture(GL_TEXTURE_2D, textureId)");
-    GLuint textureId = m_textureIDs[m_currTextureIndex];
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    GLuint pooledTextureId = LeasePooledTexture(textureIndex, width, height, internalFormat);
+    if (pooledTextureId != 0)
+    {
+        LOGI("Texture index %d has leased pooled compressed texture %u", textureIndex, pooledTextureId);
+        m_textureIDs[textureIndex] = pooledTextureId;
+
+        // A load with fewer compressed levels than it should have might have left it stopping short of them
+        glBindTexture(GL_TEXTURE_2D, pooledTextureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        PrintAllGlError();
+        return;
+    }
+
+    LOGI("There's no free %d x %d pooled texture of format 0x%x for texture index %d", width, height, internalFormat, textureIndex);
+    RenewTexture(textureIndex);
+    glBindTexture(GL_TEXTURE_2D, m_textureIDs[textureIndex]);
+    glTexStorage2D(GL_TEXTURE_2D, CalcNumMipLevels(width, height), internalFormat, width, height);
     PrintAllGlError();
+}
 
-    // Each iteration we upload up to kMaxPixelsPerUpload worth of width-long scanlines,
-    //  up until the last one where we only upload the remaining scanlines
-    const GLint kIdealNumberOfScanlinesToUpload = m_maxPixelsUploadedPerFrame/m_currImageWidth;
-    GLsizei height = (m_textureLoadingYOffset + kIdealNumberOfScanlinesToUpload < m_currImageHeight)
-                     ? kIdealNumberOfScanlinesToUpload
-                     : (m_currImageHeight - m_textureLoadingYOffset);
+// As AcquireTexture(), for a cubemap of faceSize x faceSize faces. The pool only holds 2D textures, so the index's own texture is always
+//  recreated, with immutable storage for every face's mip chain
+void AcquireCubemapTexture(int textureIndex, int faceSize, bool rgb565On)
+{
+    RenewTexture(textureIndex);
+
+    const int kNumLevels = CalcNumMipLevels(faceSize, faceSize);
+    LOGI("glTexStorage2D(GL_TEXTURE_CUBE_MAP, %d, %s, %d, %d) for texture index %d", kNumLevels, rgb565On ? "GL_RGB565" : "GL_RGB8",
+         faceSize, faceSize, textureIndex);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureIDs[textureIndex]);
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, kNumLevels, rgb565On ? GL_RGB565 : GL_RGB8, faceSize, faceSize);
+    PrintAllGlError();
+}
 
-    stbi_uc* pImage = m_pCurrImage;
+// Feeds how long it took to upload numPixels into the measured throughput. Averaging pixels and time separately weights bigger uploads
+//  more, as small ones are mostly overhead. With an upload budget, m_maxPixelsUploadedPerFrame is then however many pixels fit into it
+void RecordUploadTime(int numPixels, std::chrono::duration<double, std::milli> duration)
+{
+    const float kSmoothing = 0.25f;
 
-    if (m_rgb565On)
+    std::lock_guard<std::mutex> lock(m_uploadTimingMutex);
+    if (m_averageUploadMilliseconds <= 0.0f)
     {
-        LOGI("glTexSubImage2D(GL_TEXTURE_2D, 0, 0, %d, %d, %d, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pImage)", m_textureLoadingYOffset, m_currImageWidth, height);
-        pImage = m_pCurrImage + (m_textureLoadingYOffset * m_currImageWidth * kStrideRGB565);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_textureLoadingYOffset, m_currImageWidth, height, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pImage);
+        m_averageUploadPixels = (float) numPixels;
+        m_averageUploadMilliseconds = (float) duration.count();
     }
     else
     {
-        LOGI("glTexSubImage2D(GL_TEXTURE_2D, 0, 0, %d, %d, %d, GL_RGB, GL_UNSIGNED_BYTE, pImage)", m_textureLoadingYOffset, m_currImageWidth, height);
-        pImage = m_pCurrImage + (m_textureLoadingYOffset * m_currImageWidth * kNumStbChannels);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_textureLoadingYOffset, m_currImageWidth, height, GL_RGB, GL_UNSIGNED_BYTE, pImage);
+        m_averageUploadPixels += kSmoothing * (numPixels - m_averageUploadPixels);
+        m_averageUploadMilliseconds += kSmoothing * ((float) duration.count() - m_averageUploadMilliseconds);
     }
 
-    PrintAllGlError();
+    const float kPixelsPerMillisecond = m_averageUploadPixels / std::max(m_averageUploadMilliseconds, 0.001f);
+    m_uploadPixelsPerMillisecond = kPixelsPerMillisecond;
 
-    m_textureLoadingYOffset += kIdealNumberOfScanlinesToUpload;
-    if (m_textureLoadingYOffset > m_currImageHeight)
+    const float kUploadBudgetMilliseconds = m_uploadBudgetMilliseconds;
+    if (kUploadBudgetMilliseconds > 0.0f)
     {
-        m_isLoadingIntoTexture = false;
-        stbi_image_free(m_pCurrImage);
-
-        LOGI("glGenerateMipmap(GL_TEXTURE_2D)");
-        glGenerateMipmap(GL_TEXTURE_2D);
-        PrintAllGlError();
+        const float kMaxPixels = std::min(std::max(kPixelsPerMillisecond * kUploadBudgetMilliseconds, (float) kMinPixelsUploadedPerFrame),
+                                          (float) kMaxAdaptivePixelsUploadedPerFrame);
+        m_maxPixelsUploadedPerFrame = (int) kMaxPixels;
     }
-
-    LOGI("Finished LoadScanlinesIntoTextureFromWorkingMemory()! Loading in progress = %d", m_isLoadingIntoTexture);
 }
 
-static void UNITY_INTERFACE_API OnRenderEvent(int eventID)
+// Uploads the width x height rectangle at (xOffset, yOffset) of pImage, which is imageWidth pixels wide, into mip level of textureId's target -
+//  GL_TEXTURE_2D, or one of a cubemap's faces. Rectangles narrower than the image are read out of it using GL_UNPACK_ROW_LENGTH
+void UploadTileIntoTexture(GLuint textureId, GLenum target, GLint level, const stbi_uc* pImage, int imageWidth, GLint xOffset, GLint yOffset,
+                           GLsizei width, GLsizei height, bool rgb565On)
 {
-    if (eventID == kInit)
-    {
-        Init();
-    }
-    else if (eventID == kCreateEmptyTexture)
+    LOGI("glBindTexture(0x%x, textureId)", target);
+    glBindTexture(target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP, textureId);
+    PrintAllGlError();
+
+    const bool kIsTile = width != imageWidth;
+    if (kIsTile)
     {
-        CreateEmptyTexture();
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, imageWidth);
     }
-    else if (eventID == kLoadScanlinesIntoTextureFromWorkingMemory)
+
+    // Scanlines are tightly packed, which small mip levels' often aren't a multiple of 4 bytes long
+    const bool kIsUnaligned = (imageWidth * (rgb565On ? kStrideRGB565 : kNumStbChannels)) % 4 != 0;
+    if (kIsUnaligned)
     {
-        LoadScanlinesIntoTextureFromWorkingMemory();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     }
-    else if (eventID == kRenewTextureHandle)
+
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    if (rgb565On)
     {
-        RenewTextureHandle();
+        LOGI("glTexSubImage2D(0x%x, %d, %d, %d, %d, %d, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pImage)", target, level, xOffset, yOffset, width, height);
+        pImage += (yOffset * imageWidth + xOffset) * kStrideRGB565;
+        glTexSubImage2D(target, level, xOffset, yOffset, width, height, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pImage);
     }
-    else if (eventID == kTerminate)
+    else
     {
-        Terminate();
+        LOGI("glTexSubImage2D(0x%x, %d, %d, %d, %d, %d, GL_RGB, GL_UNSIGNED_BYTE, pImage)", target, level, xOffset, yOffset, width, height);
+        pImage += (yOffset * imageWidth + xOffset) * kNumStbChannels;
+        glTexSubImage2D(target, level, xOffset, yOffset, width, height, GL_RGB, GL_UNSIGNED_BYTE, pImage);
     }
-}
 
-// **************************
-// Public functions
-// **************************
+    RecordUploadTime(width * height, std::chrono::high_resolution_clock::now() - wcts);
 
-extern "C"
-{
+    if (kIsTile)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    if (kIsUnaligned)
+    {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
 
-UnityRenderingEvent GetRenderEventFunc()
-{
-    return OnRenderEvent;
+    PrintAllGlError();
 }
 
-void SetInitMaxNumTextures(int initMaxNumTextures)
+// As UploadTileIntoTexture(), into the texture at textureIndex
+void UploadTile(int textureIndex, GLint level, const stbi_uc* pImage, int imageWidth, GLint xOffset, GLint yOffset, GLsizei width, GLsizei height,
+                bool rgb565On)
 {
-    m_initMaxNumTextures = initMaxNumTextures;
+    UploadTileIntoTexture(m_textureIDs[textureIndex], GL_TEXTURE_2D, level, pImage, imageWidth, xOffset, yOffset, width, height, rgb565On);
 }
 
-void SetMaxPixelsUploadedPerFrame(int maxPixelsUploadedPerFrame)
+// Uploads numScanlines width-long scanlines of pImage, starting at scanline yOffset, into the texture at textureIndex
+void UploadScanlines(int textureIndex, const stbi_uc* pImage, int width, GLint yOffset, GLsizei numScanlines, bool rgb565On)
 {
-    m_maxPixelsUploadedPerFrame = maxPixelsUploadedPerFrame;
+    UploadTile(textureIndex, 0, pImage, width, 0, yOffset, width, numScanlines, rgb565On);
 }
 
-void SetUseExif(bool useExif)
+// Uploads numBlockRows rows of the format's blocks, the first of which starts at scanline yOffset, into mip level of textureId - which is
+//  width x height at that level. The last row of blocks may run off the bottom of the level
+void UploadCompressedBlockRows(GLuint textureId, GLint level, const CompressedFormat& format, const stbi_uc* pBlocks, int width, int height,
+                               GLint yOffset, int numBlockRows)
 {
-    m_useExif = useExif;
-}
+    glBindTexture(GL_TEXTURE_2D, textureId);
 
-void SetMaxImageWidth(int maxImageWidth)
-{
-    m_maxImageWidth = maxImageWidth;
+    const GLsizei kHeight = std::min(numBlockRows * format.blockHeight, height - yOffset);
+    const GLsizei kImageSize = numBlockRows * ((width + format.blockWidth - 1) / format.blockWidth) * format.blockSize;
+    auto wcts = std::chrono::high_resolution_clock::now();
+    LOGI("glCompressedTexSubImage2D(GL_TEXTURE_2D, %d, 0, %d, %d, %d, 0x%x, %d, pBlocks)", level, yOffset, width, kHeight, format.internalFormat, kImageSize);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, yOffset, width, kHeight, format.internalFormat, kImageSize, pBlocks);
+    RecordUploadTime(width * kHeight, std::chrono::high_resolution_clock::now() - wcts);
+
+    PrintAllGlError();
 }
 
-void SetRGB565On(int rgb565On)
+// A fixed set of threads that help out whoever calls ParallelFor(), which the JPEG decoder and ParallelForRowBands() use to work on
+//  several parts of an image at once. Callers also work through their own batch, so it always finishes even when every worker is busy
+class WorkerPool
 {
-    m_rgb565On = rgb565On;
+public:
+    explicit WorkerPool(int numThreads)
+    {
+        for (int i = 0; i < numThreads; i++)
+        {
+            m_threads.emplace_back(&WorkerPool::WorkerLoop, this);
+        }
+        LOGI("Started WorkerPool with %d threads\n", numThreads);
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    // Calls pTask(pArg, i) for every i in [0, count), returning once they have all finished
+    void ParallelFor(int count, void (*pTask)(void* pArg, int i), void* pArg)
+    {
+        Batch batch(pTask, pArg, count);
+        if (count > 1 && !m_threads.empty())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_batches.push_back(&batch);
+            }
+            m_workAvailable.notify_all();
+        }
+
+        RunBatch(batch);
+
+        // Every task has been claimed by now, but workers may still be running theirs
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_batches.erase(std::remove(m_batches.begin(), m_batches.end(), &batch), m_batches.end());
+        m_workerLeftBatch.wait(lock, [&batch]() { return batch.numWorkers == 0; });
+    }
+
+    int GetNumThreads() const
+    {
+        return (int) m_threads.size();
+    }
+
+private:
+    struct Batch
+    {
+        Batch(void (*pTask)(void*, int), void* pArg, int count) : pTask(pTask), pArg(pArg), count(count), next(0), numWorkers(0) {}
+
+        void (*pTask)(void*, int);
+        void* pArg;
+        int count;
+        std::atomic<int> next;
+        int numWorkers; // Guarded by m_mutex
+    };
+
+    static void RunBatch(Batch& batch)
+    {
+        for (int i = batch.next++; i < batch.count; i = batch.next++)
+        {
+            batch.pTask(batch.pArg, i);
+        }
+    }
+
+    Batch* FindUnclaimedBatch()
+    {
+        for (Batch* pBatch : m_batches)
+        {
+            if (pBatch->next < pBatch->count)
+            {
+                return pBatch;
+            }
+        }
+        return NULL;
+    }
+
+    void WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            Batch* pBatch = NULL;
+            m_workAvailable.wait(lock, [&]() { return m_stopping || (pBatch = FindUnclaimedBatch()) != NULL; });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            pBatch->numWorkers++;
+            lock.unlock();
+            RunBatch(*pBatch);
+            lock.lock();
+            if (--pBatch->numWorkers == 0)
+            {
+                m_workerLeftBatch.notify_all();
+            }
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workerLeftBatch;
+    std::vector<Batch*> m_batches;
+    std::vector<std::thread> m_threads;
+    bool m_stopping = false;
+};
+
+// Started on first use - the calling thread always works too, so one fewer thread than there are cores
+WorkerPool& GetWorkerPool()
+{
+    static WorkerPool s_workerPool((int) std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return s_workerPool;
+}
+
+void ParallelForJpeg(void* pContext, int count, void (*pTask)(void* pArg, int i), void* pArg)
+{
+    ((WorkerPool*) pContext)->ParallelFor(count, pTask, pArg);
+}
+
+const int kRowBandsPerCore = 4; // A few bands each, so a core that's busy elsewhere holds up less of the image
+const int kMinRowsPerBand = 32; // Any fewer and handing out bands costs more than it saves - and separable resamples redo more rows
+
+// Along with the task itself, how many rows ParallelForRowBands() has split between how many bands
+struct RowBands
+{
+    void (*pTask)(void* pArg, int firstRow, int endRow);
+    void* pArg;
+    int numRows;
+    int numBands;
+};
+
+void RunRowBand(void* pArg, int i)
+{
+    const RowBands& bands = *(const RowBands*) pArg;
+    bands.pTask(bands.pArg, (int) ((int64_t) i * bands.numRows / bands.numBands), (int) ((int64_t) (i + 1) * bands.numRows / bands.numBands));
+}
+
+// Calls pTask(pArg, firstRow, endRow) for consecutive bands of rows that together cover [0, numRows), on the WorkerPool's threads as well
+//  as the caller's, returning once they have all finished. There are kRowBandsPerCore for each core, unless that leaves them too thin
+void ParallelForRowBands(int numRows, void (*pTask)(void* pArg, int firstRow, int endRow), void* pArg)
+{
+    const int kNumCores = GetWorkerPool().GetNumThreads() + 1;
+    RowBands bands = { pTask, pArg, numRows, std::max(std::min(kNumCores * kRowBandsPerCore, numRows / kMinRowsPerBand), 1) };
+    GetWorkerPool().ParallelFor(bands.numBands, RunRowBand, &bands);
+}
+
+// The width an image imageWidth wide ends up at once it's been resampled to fit maxImageWidth
+int CalcResampledWidth(int imageWidth, int maxImageWidth, int resampleMode)
+{
+    if (resampleMode != kResampleHalve)
+    {
+        return std::min(imageWidth, maxImageWidth);
+    }
+
+    int newWidth = imageWidth;
+    while (newWidth > maxImageWidth)
+    {
+        newWidth /= 2;
+    }
+    return newWidth;
+}
+
+// The widest 2:1 image whose base level fits in maxBytes at bitsPerPixel, kept a multiple of 4 wide so it's still whole ETC2 blocks
+int CalcMaxImageWidthForBytes(size_t maxBytes, int bitsPerPixel)
+{
+    const int kWidth = (int) std::min(sqrt(2.0 * 8.0 * maxBytes / bitsPerPixel), (double) INT_MAX);
+    return std::max(kWidth & ~3, 4);
+}
+
+// Returns how many times the JPEG decoder should halve an image of this width while decoding, never going below the width that
+//  ReampleImageToMaxWidthAndNewType() would have halved it down to anyway - or for the exact resample modes, below maxImageWidth
+int CalcJpegScaleShift(int imageWidth, int maxImageWidth, int resampleMode)
+{
+    int scaleShift = 0;
+    if (resampleMode != kResampleHalve)
+    {
+        while (scaleShift < kMaxJpegScaleShift && ((imageWidth + (2 << scaleShift) - 1) >> (scaleShift + 1)) >= maxImageWidth)
+        {
+            scaleShift++;
+        }
+        return scaleShift;
+    }
+
+    while (scaleShift < kMaxJpegScaleShift && (imageWidth >> scaleShift) > maxImageWidth)
+    {
+        scaleShift++;
+    }
+    return scaleShift;
+}
+
+// JPEGs always start with an SOI marker (0xFF 0xD8)
+bool IsJpegData(const stbi_uc* pData, int dataLength)
+{
+    return dataLength >= 2 && pData[0] == 0xFF && pData[1] == 0xD8;
+}
+
+bool IsJpegFile(const char* pFileName)
+{
+    stbi_uc header[2] = {0, 0};
+    std::ifstream(pFileName, std::ios::binary).read((char*) header, sizeof(header));
+    return IsJpegData(header, sizeof(header));
+}
+
+// Fills in the decoder options for an image of the given size. When the JPEG decoder's downscaling lands exactly
+//  on the size ReampleImageToMaxWidthAndNewType() would produce, it also packs straight to RGB565 so that pass can be skipped.
+//  Other formats are always decoded at full size, so are left for ReampleImageToMaxWidthAndNewType() to deal with
+stbi_jpeg_options CalcJpegOptions(int fullWidth, int fullHeight, bool isJpeg, int maxImageWidth, int resampleMode, bool rgb565On)
+{
+    stbi_jpeg_options jpegOptions = {};
+    if (!isJpeg)
+    {
+        return jpegOptions;
+    }
+
+    jpegOptions.scale_shift = CalcJpegScaleShift(fullWidth, maxImageWidth, resampleMode);
+
+    const int kRoundUp = (1 << jpegOptions.scale_shift) - 1;
+    int decodedWidth = (fullWidth + kRoundUp) >> jpegOptions.scale_shift;
+    int decodedHeight = (fullHeight + kRoundUp) >> jpegOptions.scale_shift;
+    jpegOptions.rgb565 = rgb565On && (decodedWidth <= maxImageWidth) && (decodedHeight == decodedWidth / 2);
+    jpegOptions.parallel_for = ParallelForJpeg; // Shares the decode out across the cores
+    jpegOptions.parallel_context = &GetWorkerPool();
+
+    LOGI("Decoding image of Width = %d, Height = %d, with JPEG scale 1/%d, RGB565 = %d\n", fullWidth, fullHeight, 1 << jpegOptions.scale_shift, jpegOptions.rgb565);
+    return jpegOptions;
+}
+
+// Stores one resampled pixel, from channels that have already been averaged down to 8 bits
+template<bool kRGB565>
+inline void StoreResampledPixel(stbi_uc* pDst, int x, int r, int g, int b)
+{
+    if (kRGB565)
+    {
+        const uint16_t kPixel = (uint16_t) (((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+        memcpy(pDst + x * kStrideRGB565, &kPixel, sizeof(kPixel));
+    }
+    else
+    {
+        pDst[x * kNumStbChannels + 0] = (stbi_uc) r;
+        pDst[x * kNumStbChannels + 1] = (stbi_uc) g;
+        pDst[x * kNumStbChannels + 2] = (stbi_uc) b;
+    }
+}
+
+#if defined(STBI_SSE2)
+// Packs the 4 RGB888 pixels which start kOffset, kOffset + 3, kOffset + 6 and kOffset + 9 bytes into pixels, one to each 32 bit lane,
+//  into RGB565. Each lane ends up sign extended from its 16 bits, so that _mm_packs_epi32() keeps them exactly
+template<int kOffset>
+inline __m128i PackRGB565(__m128i pixels)
+{
+    const __m128i kFirstPair = _mm_unpacklo_epi32(_mm_srli_si128(pixels, kOffset), _mm_srli_si128(pixels, kOffset + 3));
+    const __m128i kSecondPair = _mm_unpacklo_epi32(_mm_srli_si128(pixels, kOffset + 6), _mm_srli_si128(pixels, kOffset + 9));
+    const __m128i kRGB = _mm_unpacklo_epi64(kFirstPair, kSecondPair);
+    const __m128i kR = _mm_slli_epi32(_mm_and_si128(kRGB, _mm_set1_epi32(0xF8)), 8);
+    const __m128i kG = _mm_srli_epi32(_mm_and_si128(kRGB, _mm_set1_epi32(0xFC00)), 5);
+    const __m128i kB = _mm_srli_epi32(_mm_and_si128(kRGB, _mm_set1_epi32(0xF80000)), 19);
+    return _mm_srai_epi32(_mm_slli_epi32(_mm_or_si128(_mm_or_si128(kR, kG), kB), 16), 16);
+}
+#elif defined(STBI_NEON)
+// Packs 8 pixels of 8 bit channels into RGB565, keeping the top 5, 6 and 5 bits of each
+inline uint16x8_t PackRGB565(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+    return vsriq_n_u16(vsriq_n_u16(vshll_n_u8(r, 8), vshll_n_u8(g, 8), 5), vshll_n_u8(b, 8), 11);
+}
+#endif
+
+// Averages each kRatio x kRatio block of the RGB888 scanlines starting at pSrc into one pixel of the scanline pDst, which is dstWidth
+//  pixels wide and either RGB888 or RGB565. Sums are truncated rather than rounded, so the results are exactly those of the scalar
+//  loop in ResampleIntegerBand(). 1:1 is just a conversion into the destination format
+template<int kRatio, bool kRGB565>
+void ResampleBoxRow(stbi_uc* pDst, const stbi_uc* pSrc, int srcStride, int dstWidth)
+{
+    const int kShift = (kRatio == 1) ? 0 : (kRatio == 2) ? 2 : (kRatio == 4) ? 4 : 6; // log2(kRatio * kRatio)
+    if (kRatio == 1 && !kRGB565)
+    {
+        memcpy(pDst, pSrc, (size_t) dstWidth * kNumStbChannels);
+        return;
+    }
+
+    int x = 0;
+#if defined(STBI_SSE2)
+    if (kRatio == 1)
+    {
+        // The 24 bytes of 8 pixels are loaded as two overlapping halves, so nothing past them is read
+        for (; x + 8 <= dstWidth; x += 8)
+        {
+            const stbi_uc* pPixels = pSrc + x * kNumStbChannels;
+            const __m128i kFirstHalf = PackRGB565<0>(_mm_loadu_si128((const __m128i*) pPixels));
+            const __m128i kSecondHalf = PackRGB565<4>(_mm_loadu_si128((const __m128i*) (pPixels + 8)));
+            _mm_storeu_si128((__m128i*) (pDst + x * kStrideRGB565), _mm_packs_epi32(kFirstHalf, kSecondHalf));
+        }
+    }
+    else
+    {
+        // The kRatio scanlines are summed into 16 bits, then each destination pixel adds up the kRatio pixels along from the start of its
+        //  box, which are 3 channels apart. SSE2 has no byte shuffle to pack them with, so only the first 3 lanes of each sum are stored
+        const int kBlockSize = 8 * kRatio * kNumStbChannels; // The channels of 8 destination pixels, always a multiple of 16
+        uint16_t columnSums[kBlockSize + 8]; // The padding is only ever read into sums that aren't stored
+        uint16_t boxSum[8];
+        const __m128i kZero = _mm_setzero_si128();
+        memset(columnSums + kBlockSize, 0, 8 * sizeof(uint16_t));
+        for (; x + 8 <= dstWidth; x += 8)
+        {
+            const stbi_uc* pBlock = pSrc + x * kRatio * kNumStbChannels;
+            for (int k = 0; k < kBlockSize; k += 16)
+            {
+                __m128i lo = kZero;
+                __m128i hi = kZero;
+                for (int j = 0; j < kRatio; j++)
+                {
+                    const __m128i kBytes = _mm_loadu_si128((const __m128i*) (pBlock + (size_t) j * srcStride + k));
+                    lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(kBytes, kZero));
+                    hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(kBytes, kZero));
+                }
+                _mm_storeu_si128((__m128i*) (columnSums + k), lo);
+                _mm_storeu_si128((__m128i*) (columnSums + k + 8), hi);
+            }
+            for (int i = 0; i < 8; i++)
+            {
+                const uint16_t* pBox = columnSums + i * kRatio * kNumStbChannels;
+                __m128i sum = _mm_loadu_si128((const __m128i*) pBox);
+                for (int k = 1; k < kRatio; k++)
+                {
+                    sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*) (pBox + k * kNumStbChannels)));
+                }
+                _mm_storeu_si128((__m128i*) boxSum, _mm_srli_epi16(sum, kShift));
+                StoreResampledPixel<kRGB565>(pDst, x + i, boxSum[0], boxSum[1], boxSum[2]);
+            }
+        }
+    }
+#elif defined(STBI_NEON)
+    if (kRatio == 1)
+    {
+        for (; x + 8 <= dstWidth; x += 8)
+        {
+            const uint8x8x3_t kPixels = vld3_u8(pSrc + x * kNumStbChannels);
+            vst1q_u16((uint16_t*) (pDst + x * kStrideRGB565), PackRGB565(kPixels.val[0], kPixels.val[1], kPixels.val[2]));
+        }
+    }
+    else
+    {
+        // Each group of 16 source pixels is summed in pairs down the kRatio scanlines, then the pairs are added together
+        //  until there's one sum per block
+        const int kNumGroups = (kRatio > 1) ? kRatio / 2 : 1;
+        const int kNarrowShift = (kRatio > 1) ? kShift : 1; // vshrn_n_u16() only takes 1 to 8, even where it's never run
+        for (; x + 8 <= dstWidth; x += 8)
+        {
+            uint16x8_t sums[kNumGroups][3];
+            for (int group = 0; group < kNumGroups; group++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    sums[group][c] = vdupq_n_u16(0);
+                }
+            }
+            for (int j = 0; j < kRatio; j++)
+            {
+                const stbi_uc* pRow = pSrc + (size_t) j * srcStride + x * kRatio * kNumStbChannels;
+                for (int group = 0; group < kNumGroups; group++)
+                {
+                    const uint8x16x3_t kPixels = vld3q_u8(pRow + group * 16 * kNumStbChannels);
+                    for (int c = 0; c < 3; c++)
+                    {
+                        sums[group][c] = vpadalq_u8(sums[group][c], kPixels.val[c]);
+                    }
+                }
+            }
+            for (int numGroups = kNumGroups; numGroups > 1; numGroups /= 2)
+            {
+                for (int group = 0; group < numGroups / 2; group++)
+                {
+                    for (int c = 0; c < 3; c++)
+                    {
+                        const uint16x8_t kFirst = sums[group * 2][c];
+                        const uint16x8_t kSecond = sums[group * 2 + 1][c];
+                        sums[group][c] = vcombine_u16(vpadd_u16(vget_low_u16(kFirst), vget_high_u16(kFirst)),
+                                                      vpadd_u16(vget_low_u16(kSecond), vget_high_u16(kSecond)));
+                    }
+                }
+            }
+
+            uint8x8x3_t result;
+            for (int c = 0; c < 3; c++)
+            {
+                result.val[c] = vshrn_n_u16(sums[0][c], kNarrowShift);
+            }
+            if (kRGB565)
+            {
+                vst1q_u16((uint16_t*) (pDst + x * kStrideRGB565), PackRGB565(result.val[0], result.val[1], result.val[2]));
+            }
+            else
+            {
+                vst3_u8(pDst + x * kNumStbChannels, result);
+            }
+        }
+    }
+#endif
+    for (; x < dstWidth; x++)
+    {
+        int r = 0, g = 0, b = 0;
+        for (int j = 0; j < kRatio; j++)
+        {
+            const stbi_uc* pBox = pSrc + (size_t) j * srcStride + x * kRatio * kNumStbChannels;
+            for (int i = 0; i < kRatio; i++)
+            {
+                r += pBox[i * kNumStbChannels + 0];
+                g += pBox[i * kNumStbChannels + 1];
+                b += pBox[i * kNumStbChannels + 2];
+            }
+        }
+        StoreResampledPixel<kRGB565>(pDst, x, r >> kShift, g >> kShift, b >> kShift);
+    }
+}
+
+// The image that ResampleIntegerRGB() and ResampleIntegerRGB565() resample, which each of the bands of rows it's split into reads and writes
+struct IntegerResample
+{
+    stbi_uc* result;
+    const stbi_uc* rgb_in;
+    int stride;
+    int new_w;
+    int new_stride;
+    int x_ratio;
+    int y_ratio;
+};
+
+template<int kRatio, bool kRGB565>
+void ResampleBoxBand(void* pArg, int firstRow, int endRow)
+{
+    const IntegerResample& resample = *(const IntegerResample*) pArg;
+    for (int y = firstRow; y != endRow; ++y)
+    {
+        ResampleBoxRow<kRatio, kRGB565>(resample.result + (size_t) y * resample.new_stride, resample.rgb_in + (size_t) y * kRatio * resample.stride,
+                                        resample.stride, resample.new_w);
+    }
+}
+
+// Any box that ResampleBoxRow() has no kernel for is averaged a pixel at a time
+template<bool kRGB565>
+void ResampleIntegerBand(void* pArg, int firstRow, int endRow)
+{
+    const IntegerResample& resample = *(const IntegerResample*) pArg;
+    const int area_ratio = resample.x_ratio * resample.y_ratio;
+    for (int y = firstRow; y != endRow; ++y)
+    {
+        stbi_uc* pDst = resample.result + (size_t) y * resample.new_stride;
+        for (int x = 0; x != resample.new_w; ++x)
+        {
+            // take the average of the pixels in the NxM box, a scanline at a time
+            int r = 0, g = 0, b = 0;
+            for (int j = 0; j != resample.y_ratio; ++j)
+            {
+                const stbi_uc* pBox = resample.rgb_in + (size_t) (y * resample.y_ratio + j) * resample.stride + x * resample.x_ratio * kNumStbChannels;
+                for (int i = 0; i != resample.x_ratio; ++i)
+                {
+                    r += pBox[i * kNumStbChannels + 0];
+                    g += pBox[i * kNumStbChannels + 1];
+                    b += pBox[i * kNumStbChannels + 2];
+                }
+            }
+            StoreResampledPixel<kRGB565>(pDst, x, r / area_ratio, g / area_ratio, b / area_ratio);
+        }
+    }
+}
+
+// Picks the kernel specialised for a square box of this size if there is one, then runs it over bands of the result's rows at once
+template<bool kRGB565>
+void ResampleInteger(stbi_uc* result, const stbi_uc* rgb_in, int w, int h, int stride, int new_w, int new_h, int new_stride)
+{
+    IntegerResample resample = { result, rgb_in, stride, new_w, new_stride, w / new_w, h / new_h };
+    void (*pBand)(void* pArg, int firstRow, int endRow) = ResampleIntegerBand<kRGB565>;
+    if (resample.x_ratio == resample.y_ratio)
+    {
+        switch (resample.x_ratio)
+        {
+            case 1: pBand = ResampleBoxBand<1, kRGB565>; break;
+            case 2: pBand = ResampleBoxBand<2, kRGB565>; break;
+            case 4: pBand = ResampleBoxBand<4, kRGB565>; break;
+            case 8: pBand = ResampleBoxBand<8, kRGB565>; break;
+            default: break;
+        }
+    }
+    ParallelForRowBands(new_h, pBand, &resample);
+}
+
+void ResampleIntegerRGB(stbi_uc *result, stbi_uc *rgb_in, int w, int h, int stride, int new_w, int new_h, int new_stride)
+{
+    ResampleInteger<false>(result, rgb_in, w, h, stride, new_w, new_h, new_stride);
+}
+
+void ResampleIntegerRGB565(stbi_uc *result, stbi_uc *rgb_in, int w, int h, int stride, int new_w, int new_h, int new_stride)
+{
+    ResampleInteger<true>(result, rgb_in, w, h, stride, new_w, new_h, new_stride);
+}
+
+const int kResampleWeightBits = 14; // Separable resampling weights are fixed point, with each pixel's adding up to 1 << kResampleWeightBits
+
+// The pixels along one axis of the source image that each pixel along the same axis of a separable resample is made from, and the weights
+//  of each. Pixel i has counts[i] of them from firsts[i] on, whose weights start at weights[i * maxCount]
+struct ResampleTaps
+{
+    int maxCount = 0;
+    std::vector<int> firsts;
+    std::vector<int> counts;
+    std::vector<int16_t> weights;
+};
+
+// How much of a source pixel at distance x from a destination pixel's centre counts towards it, in destination pixels. Area weights are the
+//  overlap of the source pixel with the destination pixel, and Lanczos-3 weights are sinc(x) * sinc(x / 3) out to 3 pixels either side
+double CalcResampleWeight(double x, double sourcePixelSize, int resampleMode)
+{
+    if (resampleMode == kResampleArea)
+    {
+        return std::max(0.0, std::min(x + sourcePixelSize / 2, 0.5) - std::max(x - sourcePixelSize / 2, -0.5));
+    }
+
+    const double kPi = 3.14159265358979;
+    x = fabs(x);
+    if (x >= 3.0)
+    {
+        return 0.0;
+    }
+    if (x < 1e-6)
+    {
+        return 1.0;
+    }
+    return 3.0 * sin(kPi * x) * sin(kPi * x / 3.0) / (kPi * kPi * x * x);
+}
+
+// Works out the taps for resampling srcSize pixels into dstSize, with the filter widened to cover every source pixel when shrinking. Weights
+//  are normalised after being clipped at the edges, and rounded so they add up to exactly 1 << kResampleWeightBits - flat colours stay flat
+void CalcResampleTaps(ResampleTaps& taps, int srcSize, int dstSize, int resampleMode)
+{
+    const double kScale = (double) srcSize / dstSize;
+    const double kFilterScale = std::max(kScale, 1.0);
+    const double kSupport = (resampleMode == kResampleArea ? 0.5 + 0.5 / kFilterScale : 3.0) * kFilterScale; // In source pixels
+
+    taps.maxCount = (int) ceil(kSupport) * 2 + 1;
+    taps.firsts.resize(dstSize);
+    taps.counts.resize(dstSize);
+    taps.weights.assign((size_t) dstSize * taps.maxCount, 0);
+    std::vector<double> weights(taps.maxCount);
+    for (int i = 0; i < dstSize; i++)
+    {
+        const double kCentre = (i + 0.5) * kScale;
+        const int kFirst = std::max((int) floor(kCentre - kSupport + 0.5), 0);
+        const int kEnd = std::min((int) floor(kCentre + kSupport + 0.5), srcSize);
+        double sum = 0.0;
+        for (int x = kFirst; x < kEnd; x++)
+        {
+            weights[x - kFirst] = CalcResampleWeight((x + 0.5 - kCentre) / kFilterScale, 1.0 / kFilterScale, resampleMode);
+            sum += weights[x - kFirst];
+        }
+
+        int16_t* pWeights = &taps.weights[(size_t) i * taps.maxCount];
+        int fixedSum = 0;
+        int largest = 0;
+        for (int x = 0; x < kEnd - kFirst; x++)
+        {
+            pWeights[x] = (int16_t) lround(weights[x] / sum * (1 << kResampleWeightBits));
+            fixedSum += pWeights[x];
+            largest = (pWeights[x] > pWeights[largest]) ? x : largest;
+        }
+        pWeights[largest] += (int16_t) ((1 << kResampleWeightBits) - fixedSum);
+        taps.firsts[i] = kFirst;
+        taps.counts[i] = kEnd - kFirst;
+    }
+}
+
+// Sums are rounded back down to 8 bits, clamping the ringing Lanczos-3 can add around hard edges
+inline stbi_uc ClampResampledSum(int sum)
+{
+    return (stbi_uc) std::min(std::max((sum + (1 << (kResampleWeightBits - 1))) >> kResampleWeightBits, 0), 255);
+}
+
+// Loads the 2 RGB888 pixels at pPixels into the low 6 bytes. Unless they're at the end of the scanline, the next 2 bytes are read as well
+inline uint64_t LoadResamplePixelPair(const stbi_uc* pPixels, bool canReadPast)
+{
+    uint64_t pixels = 0;
+    if (canReadPast)
+    {
+        memcpy(&pixels, pPixels, sizeof(pixels));
+    }
+    else
+    {
+        memcpy(&pixels, pPixels, 2 * kNumStbChannels);
+    }
+    return pixels;
+}
+
+// Resamples an RGB888 scanline srcWidth pixels wide along its length, into pDst which is as wide as taps has pixels
+void ResampleRowHorizontally(stbi_uc* pDst, const stbi_uc* pSrc, int srcWidth, const ResampleTaps& taps)
+{
+    const int kDstWidth = (int) taps.firsts.size();
+    for (int x = 0; x < kDstWidth; x++)
+    {
+        const stbi_uc* pFirst = pSrc + taps.firsts[x] * kNumStbChannels;
+        const int16_t* pWeights = &taps.weights[(size_t) x * taps.maxCount];
+        const int kCount = taps.counts[x];
+        const bool kCanReadPast = taps.firsts[x] + kCount < srcWidth;
+        int i = 0;
+#if defined(STBI_SSE2)
+        // Two taps at a time - the second pixel's shifted down beside the first, so that their channels are interleaved and
+        //  _mm_madd_epi16() can weight and add them in one go
+        const __m128i kZero = _mm_setzero_si128();
+        __m128i sum = _mm_set1_epi32(1 << (kResampleWeightBits - 1));
+        for (; i + 2 <= kCount; i += 2)
+        {
+            const uint64_t kPixels = LoadResamplePixelPair(pFirst + i * kNumStbChannels, kCanReadPast);
+            const __m128i kPair = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) &kPixels), kZero);
+            int32_t weights;
+            memcpy(&weights, pWeights + i, sizeof(weights));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(kPair, _mm_srli_si128(kPair, 6)), _mm_set1_epi32(weights)));
+        }
+        if (i < kCount)
+        {
+            uint64_t pixel = 0;
+            memcpy(&pixel, pFirst + i * kNumStbChannels, kNumStbChannels);
+            const __m128i kPixel = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) &pixel), kZero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(kPixel, kZero), _mm_set1_epi32((uint16_t) pWeights[i])));
+        }
+        const __m128i kNarrowed = _mm_packs_epi32(_mm_srai_epi32(sum, kResampleWeightBits), kZero);
+        const uint32_t kPixel = (uint32_t) _mm_cvtsi128_si32(_mm_packus_epi16(kNarrowed, kNarrowed));
+        memcpy(pDst + x * kNumStbChannels, &kPixel, kNumStbChannels);
+#elif defined(STBI_NEON)
+        // Two taps at a time, with the second pixel moved down to the bottom lanes by vext
+        int32x4_t sum = vdupq_n_s32(1 << (kResampleWeightBits - 1));
+        for (; i + 2 <= kCount; i += 2)
+        {
+            const int16x8_t kPair = vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(LoadResamplePixelPair(pFirst + i * kNumStbChannels, kCanReadPast))));
+            sum = vmlal_n_s16(sum, vget_low_s16(kPair), pWeights[i]);
+            sum = vmlal_n_s16(sum, vget_low_s16(vextq_s16(kPair, kPair, 3)), pWeights[i + 1]);
+        }
+        if (i < kCount)
+        {
+            uint64_t pixel = 0;
+            memcpy(&pixel, pFirst + i * kNumStbChannels, kNumStbChannels);
+            sum = vmlal_n_s16(sum, vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(pixel)))), pWeights[i]);
+        }
+        const uint16x4_t kNarrowed = vqshrun_n_s32(sum, kResampleWeightBits);
+        const uint32_t kPixel = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(kNarrowed, kNarrowed))), 0);
+        memcpy(pDst + x * kNumStbChannels, &kPixel, kNumStbChannels);
+#else
+        int sums[3] = {};
+        for (; i < kCount; i++)
+        {
+            for (int c = 0; c < kNumStbChannels; c++)
+            {
+                sums[c] += pFirst[i * kNumStbChannels + c] * pWeights[i];
+            }
+        }
+        for (int c = 0; c < kNumStbChannels; c++)
+        {
+            pDst[x * kNumStbChannels + c] = ClampResampledSum(sums[c]);
+        }
+#endif
+    }
+}
+
+// Blends count scanlines of numBytes bytes together by their weights, down each column of bytes, into pDst
+void ResampleRowVertically(stbi_uc* pDst, const stbi_uc* const* pRows, const int16_t* pWeights, int count, int numBytes)
+{
+    int k = 0;
+#if defined(STBI_SSE2)
+    // Two scanlines at a time, interleaved for _mm_madd_epi16() just as ResampleRowHorizontally() does with pixels
+    const __m128i kZero = _mm_setzero_si128();
+    for (; k + 16 <= numBytes; k += 16)
+    {
+        __m128i sums[4];
+        for (__m128i& sum : sums)
+        {
+            sum = _mm_set1_epi32(1 << (kResampleWeightBits - 1));
+        }
+        for (int i = 0; i < count; i += 2)
+        {
+            const __m128i kFirst = _mm_loadu_si128((const __m128i*) (pRows[i] + k));
+            const __m128i kSecond = (i + 1 < count) ? _mm_loadu_si128((const __m128i*) (pRows[i + 1] + k)) : kZero;
+            const int16_t kSecondWeight = (i + 1 < count) ? pWeights[i + 1] : 0;
+            const __m128i kWeights = _mm_set1_epi32((int) ((uint16_t) pWeights[i] | ((uint32_t) (uint16_t) kSecondWeight << 16)));
+            const __m128i kLo = _mm_unpacklo_epi8(kFirst, kZero);
+            const __m128i kHi = _mm_unpackhi_epi8(kFirst, kZero);
+            const __m128i kSecondLo = _mm_unpacklo_epi8(kSecond, kZero);
+            const __m128i kSecondHi = _mm_unpackhi_epi8(kSecond, kZero);
+            sums[0] = _mm_add_epi32(sums[0], _mm_madd_epi16(_mm_unpacklo_epi16(kLo, kSecondLo), kWeights));
+            sums[1] = _mm_add_epi32(sums[1], _mm_madd_epi16(_mm_unpackhi_epi16(kLo, kSecondLo), kWeights));
+            sums[2] = _mm_add_epi32(sums[2], _mm_madd_epi16(_mm_unpacklo_epi16(kHi, kSecondHi), kWeights));
+            sums[3] = _mm_add_epi32(sums[3], _mm_madd_epi16(_mm_unpackhi_epi16(kHi, kSecondHi), kWeights));
+        }
+        const __m128i kLo = _mm_packs_epi32(_mm_srai_epi32(sums[0], kResampleWeightBits), _mm_srai_epi32(sums[1], kResampleWeightBits));
+        const __m128i kHi = _mm_packs_epi32(_mm_srai_epi32(sums[2], kResampleWeightBits), _mm_srai_epi32(sums[3], kResampleWeightBits));
+        _mm_storeu_si128((__m128i*) (pDst + k), _mm_packus_epi16(kLo, kHi));
+    }
+#elif defined(STBI_NEON)
+    for (; k + 8 <= numBytes; k += 8)
+    {
+        int32x4_t lo = vdupq_n_s32(1 << (kResampleWeightBits - 1));
+        int32x4_t hi = lo;
+        for (int i = 0; i < count; i++)
+        {
+            const int16x8_t kBytes = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pRows[i] + k)));
+            lo = vmlal_n_s16(lo, vget_low_s16(kBytes), pWeights[i]);
+            hi = vmlal_n_s16(hi, vget_high_s16(kBytes), pWeights[i]);
+        }
+        vst1_u8(pDst + k, vqmovn_u16(vcombine_u16(vqshrun_n_s32(lo, kResampleWeightBits), vqshrun_n_s32(hi, kResampleWeightBits))));
+    }
+#endif
+    for (; k < numBytes; k++)
+    {
+        int sum = 0;
+        for (int i = 0; i < count; i++)
+        {
+            sum += pRows[i][k] * pWeights[i];
+        }
+        pDst[k] = ClampResampledSum(sum);
+    }
+}
+
+// Everything about resampling an RGB888 image to any size with a separable filter. The aspect ratio's kept, so any of a taller image
+//  that's left below dstHeight is dropped, just as ResampleIntegerRGB() does
+struct SeparableResample
+{
+    SeparableResample(int srcWidth, int srcHeight, int dstWidth, int dstHeight, int resampleMode, bool rgb565On)
+        : srcWidth(srcWidth), dstWidth(dstWidth), dstHeight(dstHeight), rgb565On(rgb565On)
+    {
+        const int kSrcHeightUsed = (int) std::max(std::min((int64_t) srcHeight, (int64_t) dstHeight * srcWidth / dstWidth), (int64_t) 1);
+        CalcResampleTaps(horizontal, srcWidth, dstWidth, resampleMode);
+        CalcResampleTaps(vertical, kSrcHeightUsed, dstHeight, resampleMode);
+    }
+
+    int srcWidth;
+    int dstWidth;
+    int dstHeight;
+    bool rgb565On;
+    ResampleTaps horizontal;
+    ResampleTaps vertical;
+};
+
+// Runs a SeparableResample over the scanlines of the source image as they're handed to it, one after another from the first one that the
+//  destination's scanlines from firstDstRow to endDstRow need. Each is resampled horizontally into a ring of the few the next destination
+//  scanline needs, so the streaming decoder can feed it bands without the image ever being held at its decoded size
+class SeparableResampler
+{
+public:
+    SeparableResampler(const SeparableResample& resample, int firstDstRow, int endDstRow)
+        : m_resample(resample), m_nextSrcRow(resample.vertical.firsts[firstDstRow]), m_nextDstRow(firstDstRow), m_endDstRow(endDstRow),
+          m_ring((size_t) resample.vertical.maxCount * resample.dstWidth * kNumStbChannels), m_rows(resample.vertical.maxCount),
+          m_rowRGB888(resample.rgb565On ? (size_t) resample.dstWidth * kNumStbChannels : 0)
+    {
+    }
+
+    int GetNextSrcRow() const
+    {
+        return m_nextSrcRow;
+    }
+
+    bool IsFinished() const
+    {
+        return m_nextDstRow == m_endDstRow;
+    }
+
+    // Takes source scanline GetNextSrcRow(), and writes whichever destination scanlines it finishes into pDst, which holds the whole image
+    //  dstStride bytes apart in RGB888 or RGB565. Returns how far down the destination's scanlines are finished
+    int AddScanline(const stbi_uc* pScanline, stbi_uc* pDst, int dstStride)
+    {
+        const ResampleTaps& kVertical = m_resample.vertical;
+        const int kRowSize = m_resample.dstWidth * kNumStbChannels;
+        const int kSrcRow = m_nextSrcRow++;
+        if (IsFinished())
+        {
+            return m_nextDstRow;
+        }
+        ResampleRowHorizontally(GetRingRow(kSrcRow), pScanline, m_resample.srcWidth, m_resample.horizontal);
+
+        while (!IsFinished() && kVertical.firsts[m_nextDstRow] + kVertical.counts[m_nextDstRow] <= m_nextSrcRow)
+        {
+            const int kCount = kVertical.counts[m_nextDstRow];
+            for (int i = 0; i < kCount; i++)
+            {
+                m_rows[i] = GetRingRow(kVertical.firsts[m_nextDstRow] + i);
+            }
+
+            stbi_uc* pDstRow = pDst + (size_t) m_nextDstRow * dstStride;
+            const int16_t* pWeights = &kVertical.weights[(size_t) m_nextDstRow * kVertical.maxCount];
+            if (m_resample.rgb565On)
+            {
+                ResampleRowVertically(m_rowRGB888.data(), m_rows.data(), pWeights, kCount, kRowSize);
+                ResampleBoxRow<1, true>(pDstRow, m_rowRGB888.data(), kRowSize, m_resample.dstWidth);
+            }
+            else
+            {
+                ResampleRowVertically(pDstRow, m_rows.data(), pWeights, kCount, kRowSize);
+            }
+            m_nextDstRow++;
+        }
+        return m_nextDstRow;
+    }
+
+private:
+    stbi_uc* GetRingRow(int srcRow)
+    {
+        return m_ring.data() + (size_t) (srcRow % m_resample.vertical.maxCount) * m_resample.dstWidth * kNumStbChannels;
+    }
+
+    const SeparableResample& m_resample;
+    int m_nextSrcRow;
+    int m_nextDstRow;
+    const int m_endDstRow;
+    std::vector<stbi_uc> m_ring;      // Horizontally resampled source scanlines, each at srcRow % vertical.maxCount
+    std::vector<const stbi_uc*> m_rows; // The ones blended into the next destination scanline
+    std::vector<stbi_uc> m_rowRGB888; // RGB565 destinations are blended into this first
+};
+
+// Along with each band's SeparableResampler, the image that ResampleSeparableBand() reads from and writes into
+struct SeparableResampleBands
+{
+    const SeparableResample* pResample;
+    const stbi_uc* pSrc;
+    int srcStride;
+    stbi_uc* pDst;
+    int dstStride;
+};
+
+void ResampleSeparableBand(void* pArg, int firstDstRow, int endDstRow)
+{
+    const SeparableResampleBands& bands = *(const SeparableResampleBands*) pArg;
+    if (firstDstRow == endDstRow)
+    {
+        return;
+    }
+
+    SeparableResampler resampler(*bands.pResample, firstDstRow, endDstRow);
+    while (!resampler.IsFinished())
+    {
+        resampler.AddScanline(bands.pSrc + (size_t) resampler.GetNextSrcRow() * bands.srcStride, bands.pDst, bands.dstStride);
+    }
+}
+
+// Resamples the whole of an RGB888 image into pDst, which is RGB565 if rgb565On, with each band of its scanlines on a different core
+void ResampleSeparable(stbi_uc* pDst, const stbi_uc* pSrc, int srcWidth, int srcHeight, int dstWidth, int dstHeight, int dstStride,
+                       int resampleMode, bool rgb565On)
+{
+    const SeparableResample kResample(srcWidth, srcHeight, dstWidth, dstHeight, resampleMode, rgb565On);
+    SeparableResampleBands bands = { &kResample, pSrc, srcWidth * kNumStbChannels, pDst, dstStride };
+    ParallelForRowBands(dstHeight, ResampleSeparableBand, &bands);
+}
+
+// Resamples the image in place down to fit maxImageWidth, cropped to 2:1, and converts it to RGB565 if rgb565On. The exact resample modes
+//  use ResampleSeparable() to end up exactly maxImageWidth wide, halving uses the box kernels
+bool ReampleImageToMaxWidthAndNewType(stbi_uc* pImage, int& imageWidth, int& imageHeight, int maxImageWidth, int resampleMode, bool rgb565On)
+{
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    int newWidth = CalcResampledWidth(imageWidth, maxImageWidth, resampleMode);
+    int newHeight = newWidth / 2; // because of 2:1 ratio for 360-images
+    if (newWidth == imageWidth && newHeight == imageHeight && !rgb565On)
+    {
+        return true; // Already the right size and type
+    }
+
+    int newStride = newWidth * (rgb565On ? kStrideRGB565 : kNumStbChannels);
+    stbi_uc* new_rgb = (stbi_uc*) stbi__malloc((size_t) newHeight * newStride);
+
+    if (resampleMode != kResampleHalve && newWidth != imageWidth)
+    {
+        ResampleSeparable(new_rgb, pImage, imageWidth, imageHeight, newWidth, newHeight, newStride, resampleMode, rgb565On);
+    }
+    else if (rgb565On)
+    {
+        ResampleIntegerRGB565(new_rgb, pImage, imageWidth, imageHeight, imageWidth * kNumStbChannels,
+                                        newWidth, newHeight, newStride);
+    }
+    else
+    {
+        ResampleIntegerRGB(new_rgb, pImage, imageWidth, imageHeight, imageWidth * kNumStbChannels,
+                                        newWidth, newHeight, newStride);
+    }
+
+    memcpy(pImage, new_rgb, (size_t) newHeight * newStride);
+    stbi_image_free(new_rgb);
+
+    imageWidth = newWidth;
+    imageHeight = newHeight;
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("ReampleImageToMaxWidthAndNewType() walltime = %f", wctduration.count());
+
+    return true;
+}
+
+// Averages each 2x2 block of the two RGB888 scanlines pRow0 and pRow1 into one pixel of pDst, which is dstWidth = srcWidth / 2 pixels wide
+void DownsampleBoxRowRGB(stbi_uc* pDst, const stbi_uc* pRow0, const stbi_uc* pRow1, int srcWidth, int dstWidth)
+{
+    int x = 0;
+#if defined(STBI_SSE2)
+    // Each pair of destination pixels comes from 12 bytes of each scanline, after summing them vertically into 16 bits
+    const __m128i kZero = _mm_setzero_si128();
+    const __m128i kTwo = _mm_set1_epi16(2);
+    for (; x + 2 <= dstWidth && x * 6 + 16 <= srcWidth * kNumStbChannels; x += 2)
+    {
+        const __m128i kRow0 = _mm_loadu_si128((const __m128i*) (pRow0 + x * 6));
+        const __m128i kRow1 = _mm_loadu_si128((const __m128i*) (pRow1 + x * 6));
+        const __m128i kLo = _mm_add_epi16(_mm_unpacklo_epi8(kRow0, kZero), _mm_unpacklo_epi8(kRow1, kZero)); // Bytes 0-7
+        const __m128i kHi = _mm_add_epi16(_mm_unpackhi_epi8(kRow0, kZero), _mm_unpackhi_epi8(kRow1, kZero)); // Bytes 8-15
+        __m128i sum = _mm_add_epi16(kLo, _mm_or_si128(_mm_srli_si128(kLo, 6), _mm_slli_si128(kHi, 10))); // Byte i + byte i+3
+        const __m128i kLastSum = _mm_add_epi16(kHi, _mm_srli_si128(kHi, 6)); // Byte 8 + byte 11
+        sum = _mm_insert_epi16(sum, _mm_extract_epi16(sum, 6), 3);
+        sum = _mm_insert_epi16(sum, _mm_extract_epi16(sum, 7), 4);
+        sum = _mm_insert_epi16(sum, _mm_extract_epi16(kLastSum, 0), 5);
+        const __m128i kPacked = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(sum, kTwo), 2), kZero);
+        const int kFirstFour = _mm_cvtsi128_si32(kPacked);
+        const uint16_t kLastTwo = (uint16_t) _mm_extract_epi16(kPacked, 2);
+        memcpy(pDst + x * 3, &kFirstFour, 4);
+        memcpy(pDst + x * 3 + 4, &kLastTwo, 2);
+    }
+#elif defined(STBI_NEON)
+    for (; x + 8 <= dstWidth && x * 2 + 16 <= srcWidth; x += 8)
+    {
+        const uint8x16x3_t kRow0 = vld3q_u8(pRow0 + x * 6);
+        const uint8x16x3_t kRow1 = vld3q_u8(pRow1 + x * 6);
+        uint8x8x3_t result;
+        for (int c = 0; c < 3; c++)
+        {
+            result.val[c] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(kRow0.val[c]), kRow1.val[c]), 2);
+        }
+        vst3_u8(pDst + x * 3, result);
+    }
+#endif
+    for (; x < dstWidth; x++)
+    {
+        const int kX0 = x * 2 * kNumStbChannels;
+        const int kX1 = std::min(x * 2 + 1, srcWidth - 1) * kNumStbChannels;
+        for (int c = 0; c < kNumStbChannels; c++)
+        {
+            pDst[x * kNumStbChannels + c] = (stbi_uc) ((pRow0[kX0 + c] + pRow0[kX1 + c] + pRow1[kX0 + c] + pRow1[kX1 + c] + 2) >> 2);
+        }
+    }
+}
+
+// As DownsampleBoxRowRGB(), but averaging each of the 5, 6 and 5 bit channels of RGB565 scanlines
+void DownsampleBoxRowRGB565(uint16_t* pDst, const uint16_t* pRow0, const uint16_t* pRow1, int srcWidth, int dstWidth)
+{
+    int x = 0;
+#if defined(STBI_SSE2)
+    // _mm_madd_epi16() sums each horizontal pair of channels into 32 bits
+    const __m128i kOnes = _mm_set1_epi16(1);
+    const __m128i kTwo = _mm_set1_epi32(2);
+    const __m128i kMask5 = _mm_set1_epi16(0x1F);
+    const __m128i kMask6 = _mm_set1_epi16(0x3F);
+    for (; x + 4 <= dstWidth && x * 2 + 8 <= srcWidth; x += 4)
+    {
+        const __m128i kRow0 = _mm_loadu_si128((const __m128i*) (pRow0 + x * 2));
+        const __m128i kRow1 = _mm_loadu_si128((const __m128i*) (pRow1 + x * 2));
+        const __m128i kR = _mm_add_epi32(_mm_madd_epi16(_mm_srli_epi16(kRow0, 11), kOnes), _mm_madd_epi16(_mm_srli_epi16(kRow1, 11), kOnes));
+        const __m128i kG = _mm_add_epi32(_mm_madd_epi16(_mm_and_si128(_mm_srli_epi16(kRow0, 5), kMask6), kOnes),
+                                         _mm_madd_epi16(_mm_and_si128(_mm_srli_epi16(kRow1, 5), kMask6), kOnes));
+        const __m128i kB = _mm_add_epi32(_mm_madd_epi16(_mm_and_si128(kRow0, kMask5), kOnes), _mm_madd_epi16(_mm_and_si128(kRow1, kMask5), kOnes));
+        __m128i result = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_srli_epi32(_mm_add_epi32(kR, kTwo), 2), 11),
+                                                   _mm_slli_epi32(_mm_srli_epi32(_mm_add_epi32(kG, kTwo), 2), 5)),
+                                      _mm_srli_epi32(_mm_add_epi32(kB, kTwo), 2));
+        result = _mm_shufflelo_epi16(result, _MM_SHUFFLE(3, 3, 2, 0)); // Gathers the low 16 bits of each 32 bit result
+        result = _mm_shufflehi_epi16(result, _MM_SHUFFLE(3, 3, 2, 0));
+        result = _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 2, 0));
+        _mm_storel_epi64((__m128i*) (pDst + x), result);
+    }
+#elif defined(STBI_NEON)
+    const uint16x8_t kMask5 = vdupq_n_u16(0x1F);
+    const uint16x8_t kMask6 = vdupq_n_u16(0x3F);
+    for (; x + 4 <= dstWidth && x * 2 + 8 <= srcWidth; x += 4)
+    {
+        const uint16x8_t kRow0 = vld1q_u16(pRow0 + x * 2);
+        const uint16x8_t kRow1 = vld1q_u16(pRow1 + x * 2);
+        const uint16x4_t kR = vrshrn_n_u32(vpadalq_u16(vpaddlq_u16(vshrq_n_u16(kRow0, 11)), vshrq_n_u16(kRow1, 11)), 2);
+        const uint16x4_t kG = vrshrn_n_u32(vpadalq_u16(vpaddlq_u16(vandq_u16(vshrq_n_u16(kRow0, 5), kMask6)),
+                                                       vandq_u16(vshrq_n_u16(kRow1, 5), kMask6)), 2);
+        const uint16x4_t kB = vrshrn_n_u32(vpadalq_u16(vpaddlq_u16(vandq_u16(kRow0, kMask5)), vandq_u16(kRow1, kMask5)), 2);
+        vst1_u16(pDst + x, vorr_u16(vorr_u16(vshl_n_u16(kR, 11), vshl_n_u16(kG, 5)), kB));
+    }
+#endif
+    for (; x < dstWidth; x++)
+    {
+        const uint16_t kPixels[4] = { pRow0[x * 2], pRow0[std::min(x * 2 + 1, srcWidth - 1)], pRow1[x * 2], pRow1[std::min(x * 2 + 1, srcWidth - 1)] };
+        int r = 2, g = 2, b = 2;
+        for (uint16_t pixel : kPixels)
+        {
+            r += pixel >> 11;
+            g += (pixel >> 5) & 0x3F;
+            b += pixel & 0x1F;
+        }
+        pDst[x] = (uint16_t) (((r >> 2) << 11) | ((g >> 2) << 5) | (b >> 2));
+    }
+}
+
+// The mip level DownsampleBox() halves, and the one it's building, which each of the bands of rows it's split into reads and writes
+struct BoxDownsample
+{
+    const stbi_uc* pSrc;
+    int srcWidth;
+    int srcHeight;
+    stbi_uc* pDst;
+    int dstWidth;
+    bool rgb565On;
+};
+
+void DownsampleBoxBand(void* pArg, int firstRow, int endRow)
+{
+    const BoxDownsample& downsample = *(const BoxDownsample*) pArg;
+    const int kStride = downsample.rgb565On ? kStrideRGB565 : kNumStbChannels;
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const stbi_uc* pRow0 = downsample.pSrc + (size_t) (y * 2) * downsample.srcWidth * kStride;
+        const stbi_uc* pRow1 = downsample.pSrc + (size_t) std::min(y * 2 + 1, downsample.srcHeight - 1) * downsample.srcWidth * kStride;
+        stbi_uc* pDstRow = downsample.pDst + (size_t) y * downsample.dstWidth * kStride;
+        if (downsample.rgb565On)
+        {
+            DownsampleBoxRowRGB565((uint16_t*) pDstRow, (const uint16_t*) pRow0, (const uint16_t*) pRow1, downsample.srcWidth, downsample.dstWidth);
+        }
+        else
+        {
+            DownsampleBoxRowRGB(pDstRow, pRow0, pRow1, downsample.srcWidth, downsample.dstWidth);
+        }
+    }
+}
+
+// Halves pSrc into the next mip level down, averaging 2x2 blocks in bands of rows at once. Odd sizes lose their last row or column,
+//  as in glGenerateMipmap()
+stbi_uc* DownsampleBox(const stbi_uc* pSrc, int srcWidth, int srcHeight, bool rgb565On)
+{
+    const int kDstWidth = std::max(1, srcWidth / 2);
+    const int kDstHeight = std::max(1, srcHeight / 2);
+    const int kStride = rgb565On ? kStrideRGB565 : kNumStbChannels;
+    stbi_uc* pDst = (stbi_uc*) stbi__malloc((size_t) kDstWidth * kDstHeight * kStride);
+    if (pDst == NULL)
+    {
+        return NULL;
+    }
+
+    BoxDownsample downsample = { pSrc, srcWidth, srcHeight, pDst, kDstWidth, rgb565On };
+    ParallelForRowBands(kDstHeight, DownsampleBoxBand, &downsample);
+    return pDst;
+}
+
+const int kNumCubemapFaces = 6;
+const int kNumCubemapBandsPerFace = 8; // Faces are converted in bands, as the ones at the poles take longer than the rest
+
+// Along with faceSize, the equirectangular image that ConvertEquirectToCubemap()'s bands are sampled from and the faces they're written into
+struct CubemapConversion
+{
+    const stbi_uc* pImage;
+    int width;
+    int height;
+    bool rgb565On;
+    int faceSize;
+    stbi_uc* pFaces;
+};
+
+// The direction the texel at (s, t) of a cubemap face looks along, with s and t in [-1, 1] and laid out as GL samples them -
+//  faces go +X, -X, +Y, -Y, +Z, -Z and t goes down each face
+void CalcCubemapDirection(int face, float s, float t, float& x, float& y, float& z)
+{
+    switch (face)
+    {
+        case 0:  x = 1.0f;  y = -t;    z = -s;    break;
+        case 1:  x = -1.0f; y = -t;    z = s;     break;
+        case 2:  x = s;     y = 1.0f;  z = t;     break;
+        case 3:  x = s;     y = -1.0f; z = -t;    break;
+        case 4:  x = s;     y = -t;    z = 1.0f;  break;
+        default: x = -s;    y = -t;    z = -1.0f; break;
+    }
+}
+
+// Unpacks a pixel into 16 bit (r, g, b, 0) channels, which stay 5, 6 and 5 bits wide for RGB565
+inline void UnpackPixel(const stbi_uc* pPixel, bool rgb565On, uint16_t* pChannels)
+{
+    if (rgb565On)
+    {
+        uint16_t pixel;
+        memcpy(&pixel, pPixel, sizeof(pixel));
+        pChannels[0] = pixel >> 11;
+        pChannels[1] = (pixel >> 5) & 0x3F;
+        pChannels[2] = pixel & 0x1F;
+    }
+    else
+    {
+        pChannels[0] = pPixel[0];
+        pChannels[1] = pPixel[1];
+        pChannels[2] = pPixel[2];
+    }
+    pChannels[3] = 0;
+}
+
+// Blends four unpacked pixels - p00 and p01 above p10 and p11 - with 8 bit fixed point weights fx and fy in [0, 256], rounding to nearest.
+//  The horizontal pass blends both rows at once, so every product stays within 16 bits
+inline void BlendBilinear(const uint16_t* p00, const uint16_t* p01, const uint16_t* p10, const uint16_t* p11, int fx, int fy, uint16_t* pResult)
+{
+#if defined(STBI_SSE2)
+    const __m128i kLeft = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) p00), _mm_loadl_epi64((const __m128i*) p10));
+    const __m128i kRight = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) p01), _mm_loadl_epi64((const __m128i*) p11));
+    const __m128i kRows = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(kLeft, _mm_set1_epi16((short) (256 - fx))),
+                                                       _mm_mullo_epi16(kRight, _mm_set1_epi16((short) fx))), 8);
+    const __m128i kSum = _mm_add_epi16(_mm_mullo_epi16(kRows, _mm_set1_epi16((short) (256 - fy))),
+                                       _mm_mullo_epi16(_mm_srli_si128(kRows, 8), _mm_set1_epi16((short) fy)));
+    _mm_storel_epi64((__m128i*) pResult, _mm_srli_epi16(_mm_add_epi16(kSum, _mm_set1_epi16(128)), 8));
+#elif defined(STBI_NEON)
+    const uint16x8_t kRows = vshrq_n_u16(vmlaq_n_u16(vmulq_n_u16(vcombine_u16(vld1_u16(p00), vld1_u16(p10)), (uint16_t) (256 - fx)),
+                                                     vcombine_u16(vld1_u16(p01), vld1_u16(p11)), (uint16_t) fx), 8);
+    vst1_u16(pResult, vrshr_n_u16(vmla_n_u16(vmul_n_u16(vget_low_u16(kRows), (uint16_t) (256 - fy)), vget_high_u16(kRows), (uint16_t) fy), 8));
+#else
+    for (int c = 0; c < 4; c++)
+    {
+        const int kTop = (p00[c] * (256 - fx) + p01[c] * fx) >> 8;
+        const int kBottom = (p10[c] * (256 - fx) + p11[c] * fx) >> 8;
+        pResult[c] = (uint16_t) ((kTop * (256 - fy) + kBottom * fy + 128) >> 8);
+    }
+#endif
+}
+
+// Fills one band of one face, sampling the equirectangular image bilinearly where each texel's direction lands in it. Longitudes wrap
+//  around the image's sides, latitudes stop at its top and bottom rows. u = 0.5 faces +Z and goes up towards +X, v = 0 is straight up
+void ConvertCubemapBand(void* pArg, int i)
+{
+    const CubemapConversion& conversion = *(const CubemapConversion*) pArg;
+    const int kFace = i / kNumCubemapBandsPerFace;
+    const int kBand = i % kNumCubemapBandsPerFace;
+    const int kFaceSize = conversion.faceSize;
+    const int kWidth = conversion.width;
+    const int kHeight = conversion.height;
+    const int kStride = conversion.rgb565On ? kStrideRGB565 : kNumStbChannels;
+    const float kPi = 3.14159265f;
+
+    stbi_uc* pFace = conversion.pFaces + (size_t) kFace * kFaceSize * kFaceSize * kStride;
+    const int kFirstRow = kBand * kFaceSize / kNumCubemapBandsPerFace;
+    const int kEndRow = (kBand + 1) * kFaceSize / kNumCubemapBandsPerFace;
+    for (int row = kFirstRow; row < kEndRow; row++)
+    {
+        const float kT = 2.0f * (row + 0.5f) / kFaceSize - 1.0f;
+        stbi_uc* pDst = pFace + (size_t) row * kFaceSize * kStride;
+        for (int column = 0; column < kFaceSize; column++)
+        {
+            float x, y, z;
+            CalcCubemapDirection(kFace, 2.0f * (column + 0.5f) / kFaceSize - 1.0f, kT, x, y, z);
+            const float kU = 0.5f + atan2f(x, z) / (2.0f * kPi);
+            const float kV = 0.5f - atan2f(y, sqrtf(x * x + z * z)) / kPi;
+
+            const float kX = kU * kWidth - 0.5f;
+            const float kY = std::min(std::max(kV * kHeight - 0.5f, 0.0f), (float) (kHeight - 1));
+            const int kX0 = (int) floorf(kX);
+            const int kY0 = (int) kY;
+            const int kFx = (int) ((kX - kX0) * 256.0f);
+            const int kFy = (int) ((kY - kY0) * 256.0f);
+            const int kLeft = (kX0 % kWidth + kWidth) % kWidth;
+            const int kRight = (kLeft + 1) % kWidth;
+            const stbi_uc* pRow0 = conversion.pImage + (size_t) kY0 * kWidth * kStride;
+            const stbi_uc* pRow1 = conversion.pImage + (size_t) std::min(kY0 + 1, kHeight - 1) * kWidth * kStride;
+
+            uint16_t p00[4], p01[4], p10[4], p11[4], result[4];
+            UnpackPixel(pRow0 + kLeft * kStride, conversion.rgb565On, p00);
+            UnpackPixel(pRow0 + kRight * kStride, conversion.rgb565On, p01);
+            UnpackPixel(pRow1 + kLeft * kStride, conversion.rgb565On, p10);
+            UnpackPixel(pRow1 + kRight * kStride, conversion.rgb565On, p11);
+            BlendBilinear(p00, p01, p10, p11, kFx, kFy, result);
+
+            if (conversion.rgb565On)
+            {
+                const uint16_t kPixel = (uint16_t) ((result[0] << 11) | (result[1] << 5) | result[2]);
+                memcpy(pDst + column * kStrideRGB565, &kPixel, sizeof(kPixel));
+            }
+            else
+            {
+                pDst[column * kNumStbChannels + 0] = (stbi_uc) result[0];
+                pDst[column * kNumStbChannels + 1] = (stbi_uc) result[1];
+                pDst[column * kNumStbChannels + 2] = (stbi_uc) result[2];
+            }
+        }
+    }
+}
+
+// Resamples an equirectangular image into the six faces of a cubemap, one after another in the same format, spreading the faces' bands
+//  across the WorkerPool. The image has width / 2pi pixels per radian along its equator, and a face has faceSize / 2 at its centre - the
+//  least anywhere on it - so faces width / pi across keep the equator's resolution everywhere, in around 1.2 times the image's texels, as
+//  long as a cubemap can be that big
+stbi_uc* ConvertEquirectToCubemap(const stbi_uc* pImage, int width, int height, bool rgb565On, int& faceSize)
+{
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    const double kPi = 3.14159265358979;
+    faceSize = std::min((int) lround(width / kPi), m_maxCubemapFaceSize.load());
+    faceSize = std::max(faceSize, 1);
+    const size_t kFacesSize = (size_t) kNumCubemapFaces * faceSize * faceSize * (rgb565On ? kStrideRGB565 : kNumStbChannels);
+    stbi_uc* pFaces = (stbi_uc*) stbi__malloc(kFacesSize);
+    if (pFaces == NULL)
+    {
+        LOGI("Failed to allocate %zu bytes of cubemap faces\n", kFacesSize);
+        return NULL;
+    }
+
+    CubemapConversion conversion = { pImage, width, height, rgb565On, faceSize, pFaces };
+    GetWorkerPool().ParallelFor(kNumCubemapFaces * kNumCubemapBandsPerFace, ConvertCubemapBand, &conversion);
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("ConvertEquirectToCubemap() walltime = %f, for %d x %d faces", wctduration.count(), faceSize, faceSize);
+    return pFaces;
+}
+
+// ETC1's luminance modifier tables, which ETC2 keeps - each half block adds one of +small, +large, -small or -large to its base colour
+const int kEtc2Modifiers[8][2] = { {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183} };
+
+// An RGB888 image, one of whose levels is compressed into rows of 4x4 ETC2 blocks by CompressEtc2BlockRow()
+struct Etc2Compression
+{
+    const stbi_uc* pImage;
+    int width;
+    int height;
+    stbi_uc* pBlocks;
+};
+
+// Picks whichever of the table's modifiers moves each of the half block's eight pixels closest to baseColour, going by pOffsets - how much
+//  brighter or darker than it they are, three times over - and returns the resulting squared error. pIndices get ETC's pixel indices
+int FitEtc2Table(const int (*pPixels)[3], const int* pOffsets, const int* pBaseColour, int table, int* pIndices)
+{
+    const int kSmall = kEtc2Modifiers[table][0];
+    const int kLarge = kEtc2Modifiers[table][1];
+    const int kModifiers[4] = { kSmall, kLarge, -kSmall, -kLarge }; // In pixel index order
+    const int kThreshold = 3 * (kSmall + kLarge) / 2; // Beyond this the large modifier's closer than the small one
+
+    int error = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        const int kIndex = (pOffsets[i] < 0 ? 2 : 0) + (abs(pOffsets[i]) > kThreshold ? 1 : 0);
+        pIndices[i] = kIndex;
+        for (int c = 0; c < 3; c++)
+        {
+            const int kDifference = std::min(std::max(pBaseColour[c] + kModifiers[kIndex], 0), 255) - pPixels[i][c];
+            error += kDifference * kDifference;
+        }
+    }
+    return error;
+}
+
+// Compresses one 4x4 block, whose pixels are given a column at a time, using only the individual and differential modes that ETC2 shares
+//  with ETC1. Both ways of splitting the block in half are tried, with each half's average colour as its base and its best modifier table
+uint64_t CompressEtc2Block(const int (*pBlock)[3])
+{
+    uint64_t bestBlock = 0;
+    int bestError = INT_MAX;
+    for (int flip = 0; flip < 2; flip++)
+    {
+        // Without flipping the halves are the left and right pairs of columns, with it they're the top and bottom pairs of rows
+        int halves[2][8][3];
+        int halfPixelIndices[2][8];
+        int sums[2][3] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            const int kX = i / 4;
+            const int kY = i % 4;
+            const int kHalf = flip ? kY / 2 : kX / 2;
+            const int kSlot = flip ? kX + (kY % 2) * 4 : (kX % 2) * 4 + kY;
+            halfPixelIndices[kHalf][kSlot] = i;
+            for (int c = 0; c < 3; c++)
+            {
+                halves[kHalf][kSlot][c] = pBlock[i][c];
+                sums[kHalf][c] += pBlock[i][c];
+            }
+        }
+
+        // Differential mode's 5 bit base colours are more precise, as long as the second is within its 3 bit delta of the first
+        int quantised[2][3];
+        bool isDifferential = true;
+        for (int c = 0; c < 3; c++)
+        {
+            quantised[0][c] = (sums[0][c] * 31 + 1020) / 2040;
+            quantised[1][c] = (sums[1][c] * 31 + 1020) / 2040;
+            const int kDelta = quantised[1][c] - quantised[0][c];
+            isDifferential &= kDelta >= -4 && kDelta <= 3;
+        }
+
+        int baseColours[2][3];
+        for (int half = 0; half < 2; half++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                if (isDifferential)
+                {
+                    baseColours[half][c] = (quantised[half][c] << 3) | (quantised[half][c] >> 2);
+                }
+                else
+                {
+                    quantised[half][c] = (sums[half][c] * 15 + 1020) / 2040;
+                    baseColours[half][c] = (quantised[half][c] << 4) | quantised[half][c];
+                }
+            }
+        }
+
+        // Only the tables either side of the one whose modifiers best match how far the half's pixels stray from its base are tried
+        int error = 0;
+        int tables[2] = {};
+        int indices[2][8];
+        for (int half = 0; half < 2; half++)
+        {
+            int offsets[8];
+            int spread = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                offsets[i] = halves[half][i][0] + halves[half][i][1] + halves[half][i][2] - baseColours[half][0] - baseColours[half][1] - baseColours[half][2];
+                spread = std::max(spread, abs(offsets[i]));
+            }
+            int closestTable = 0;
+            while (closestTable < 7 && 3 * kEtc2Modifiers[closestTable][1] < spread)
+            {
+                closestTable++;
+            }
+
+            int bestHalfError = INT_MAX;
+            for (int table = std::max(closestTable - 1, 0); table <= std::min(closestTable + 1, 7); table++)
+            {
+                int tableIndices[8];
+                const int kError = FitEtc2Table(halves[half], offsets, baseColours[half], table, tableIndices);
+                if (kError < bestHalfError)
+                {
+                    bestHalfError = kError;
+                    tables[half] = table;
+                    memcpy(indices[half], tableIndices, sizeof(tableIndices));
+                }
+            }
+            error += bestHalfError;
+        }
+        if (error >= bestError)
+        {
+            continue;
+        }
+        bestError = error;
+
+        uint64_t block = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            const int kShift = 59 - c * 8;
+            if (isDifferential)
+            {
+                block |= (uint64_t) quantised[0][c] << kShift;
+                block |= (uint64_t) ((quantised[1][c] - quantised[0][c]) & 7) << (kShift - 3);
+            }
+            else
+            {
+                block |= (uint64_t) quantised[0][c] << (kShift + 1);
+                block |= (uint64_t) quantised[1][c] << (kShift - 3);
+            }
+        }
+        block |= (uint64_t) tables[0] << 37;
+        block |= (uint64_t) tables[1] << 34;
+        block |= (uint64_t) (isDifferential ? 1 : 0) << 33;
+        block |= (uint64_t) flip << 32;
+
+        // Each pixel's index is split into its high bit, in the upper 16 bits, and its low bit - both at bit (column * 4 + row)
+        for (int half = 0; half < 2; half++)
+        {
+            for (int slot = 0; slot < 8; slot++)
+            {
+                const int kPixel = halfPixelIndices[half][slot];
+                block |= (uint64_t) (indices[half][slot] >> 1) << (16 + kPixel);
+                block |= (uint64_t) (indices[half][slot] & 1) << kPixel;
+            }
+        }
+        bestBlock = block;
+    }
+    return bestBlock;
+}
+
+// Compresses row i of 4x4 blocks, repeating the last row and column of pixels for blocks that run off the image's edges
+void CompressEtc2BlockRow(void* pArg, int i)
+{
+    const Etc2Compression& compression = *(const Etc2Compression*) pArg;
+    const int kBlocksAcross = (compression.width + 3) / 4;
+    stbi_uc* pDst = compression.pBlocks + (size_t) i * kBlocksAcross * kEtc2BlockSize;
+    for (int blockX = 0; blockX < kBlocksAcross; blockX++)
+    {
+        int block[16][3];
+        for (int x = 0; x < 4; x++)
+        {
+            for (int y = 0; y < 4; y++)
+            {
+                const int kX = std::min(blockX * 4 + x, compression.width - 1);
+                const int kY = std::min(i * 4 + y, compression.height - 1);
+                const stbi_uc* pPixel = compression.pImage + ((size_t) kY * compression.width + kX) * kNumStbChannels;
+                block[x * 4 + y][0] = pPixel[0];
+                block[x * 4 + y][1] = pPixel[1];
+                block[x * 4 + y][2] = pPixel[2];
+            }
+        }
+
+        // Blocks are stored most significant byte first
+        const uint64_t kBlock = CompressEtc2Block(block);
+        for (int byte = 0; byte < kEtc2BlockSize; byte++)
+        {
+            pDst[blockX * kEtc2BlockSize + byte] = (stbi_uc) (kBlock >> (56 - byte * 8));
+        }
+    }
+}
+
+// Compresses a width x height RGB888 image into GL_COMPRESSED_RGB8_ETC2 blocks, sharing its rows of blocks out across the WorkerPool
+stbi_uc* CompressEtc2(const stbi_uc* pImage, int width, int height)
+{
+    const int kBlockRows = (height + 3) / 4;
+    const size_t kBlocksSize = (size_t) kBlockRows * ((width + 3) / 4) * kEtc2BlockSize;
+    stbi_uc* pBlocks = (stbi_uc*) stbi__malloc(kBlocksSize);
+    if (pBlocks == NULL)
+    {
+        return NULL;
+    }
+
+    Etc2Compression compression = { pImage, width, height, pBlocks };
+    GetWorkerPool().ParallelFor(kBlockRows, CompressEtc2BlockRow, &compression);
+    return pBlocks;
+}
+
+const char kDiskCacheExtension[] = ".vrtex";
+
+// Keeps finished loads on disk exactly as they're uploaded, so that revisiting an image skips reading, decoding and resampling it. Each entry
+//  is a file named after a hash of its key, and once they add up to more than maxBytes the least recently used are deleted. The directory is
+//  scanned on first use, taking each file's modification time as when it was last used - which is bumped whenever it's loaded from
+class DiskCache
+{
+public:
+    void SetDirectory(const std::string& directory, size_t maxBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_directory = directory;
+        m_maxBytes = maxBytes;
+        m_entries.clear();
+        m_numBytes = 0;
+        m_isScanned = false;
+        if (!m_directory.empty())
+        {
+            mkdir(m_directory.c_str(), 0700);
+        }
+    }
+
+    // Returns an empty path if there's no directory to cache in
+    std::string GetEntryPath(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_directory.empty())
+        {
+            return std::string();
+        }
+
+        uint64_t hash = 14695981039346656037ull; // FNV-1a
+        for (char c : key)
+        {
+            hash = (hash ^ (uint8_t) c) * 1099511628211ull;
+        }
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "/%016llx%s", (unsigned long long) hash, kDiskCacheExtension);
+        return m_directory + fileName;
+    }
+
+    bool Contains(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ScanIfNeeded();
+        return m_entries.count(path) > 0;
+    }
+
+    // Call whenever an entry's loaded from, making it the most recently used
+    void Touch(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ScanIfNeeded();
+        auto it = m_entries.find(path);
+        if (it != m_entries.end())
+        {
+            it->second.lastUsed = time(NULL);
+            utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+        }
+    }
+
+    // Call once an entry has been written in full to path, which evicts whichever others no longer fit
+    void Add(const std::string& path, size_t numBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ScanIfNeeded();
+        Forget(path);
+        m_entries[path] = { numBytes, time(NULL) };
+        m_numBytes += numBytes;
+
+        while (m_numBytes > m_maxBytes && m_entries.size() > 1)
+        {
+            auto leastRecentlyUsed = m_entries.end();
+            for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+            {
+                if (it->first != path && (leastRecentlyUsed == m_entries.end() || it->second.lastUsed < leastRecentlyUsed->second.lastUsed))
+                {
+                    leastRecentlyUsed = it;
+                }
+            }
+            LOGI("Evicting disk cache entry %s", leastRecentlyUsed->first.c_str());
+            unlink(leastRecentlyUsed->first.c_str()); // Loads that have it mapped keep it until they're done
+            m_numBytes -= leastRecentlyUsed->second.numBytes;
+            m_entries.erase(leastRecentlyUsed);
+        }
+    }
+
+    // Deletes an entry that turned out to be unusable
+    void Remove(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Forget(path);
+        unlink(path.c_str());
+    }
+
+private:
+    struct Entry
+    {
+        size_t numBytes;
+        time_t lastUsed;
+    };
+
+    // Call with m_mutex held
+    void Forget(const std::string& path)
+    {
+        auto it = m_entries.find(path);
+        if (it != m_entries.end())
+        {
+            m_numBytes -= it->second.numBytes;
+            m_entries.erase(it);
+        }
+    }
+
+    // Call with m_mutex held. Temporary files are what's left of entries that were being written when the app was killed
+    void ScanIfNeeded()
+    {
+        if (m_isScanned || m_directory.empty())
+        {
+            return;
+        }
+        m_isScanned = true;
+
+        DIR* pDirectory = opendir(m_directory.c_str());
+        if (pDirectory == NULL)
+        {
+            return;
+        }
+        const size_t kExtensionLength = strlen(kDiskCacheExtension);
+        while (dirent* pEntry = readdir(pDirectory))
+        {
+            const std::string kName = pEntry->d_name;
+            const std::string kPath = m_directory + "/" + kName;
+            struct stat fileStat;
+            if (kName.size() > 4 && kName.compare(kName.size() - 4, 4, ".tmp") == 0)
+            {
+                unlink(kPath.c_str());
+            }
+            else if (kName.size() > kExtensionLength && kName.compare(kName.size() - kExtensionLength, kExtensionLength, kDiskCacheExtension) == 0 &&
+                     stat(kPath.c_str(), &fileStat) == 0)
+            {
+                m_entries[kPath] = { (size_t) fileStat.st_size, fileStat.st_mtime };
+                m_numBytes += (size_t) fileStat.st_size;
+            }
+        }
+        closedir(pDirectory);
+        LOGI("The disk cache has %d entries, taking up %zu bytes", (int) m_entries.size(), m_numBytes);
+    }
+
+    std::mutex m_mutex;
+    std::string m_directory;
+    size_t m_maxBytes = 0;
+    size_t m_numBytes = 0;
+    bool m_isScanned = false;
+    std::map<std::string, Entry> m_entries; // By path
+};
+
+DiskCache& GetDiskCache()
+{
+    static DiskCache s_diskCache;
+    return s_diskCache;
+}
+
+// These are the states a LoadJob goes through, as reported to C# by GetLoadJobState()
+enum LoadJobState
+{
+    kLoadJobQueued = 0,
+    kLoadJobRunning = 1,
+    kLoadJobSucceeded = 2,
+    kLoadJobFailed = 3,
+    kLoadJobCancelled = 4
+};
+
+// How much of a load Unity can sample, as reported to C# by GetLoadJobPhase()
+enum LoadJobPhase
+{
+    kLoadJobNothingVisible = 0,
+    kLoadJobPlaceholderVisible = 1,
+    kLoadJobImageVisible = 2
+};
+
+// Higher priorities are decoded first - these match C#'s CppPlugin.LoadPriority
+enum LoadPriority
+{
+    kLoadPriorityPrefetch = 0,
+    kLoadPriorityVisibleSphere = 1,
+    kLoadPrioritySkybox = 2
+};
+
+// Everything about decoding one image: the settings it was requested with, which are captured when it's created so that
+//  several can be in flight at once, and the pixels it gets decoded into. While a job is in working memory (see
+//  MoveIntoWorkingMemory()) its pixels and scanlines are published through m_pCurrImage and friends as they're decoded
+struct LoadJob
+{
+    ~LoadJob()
+    {
+        if (pSourceFile == NULL)
+        {
+            stbi_image_free(pPixels);
+            for (stbi_uc* pMipLevel : pMipLevels)
+            {
+                stbi_image_free(pMipLevel);
+            }
+            for (stbi_uc* pCompressedLevel : pCompressedLevels)
+            {
+                stbi_image_free(pCompressedLevel);
+            }
+        }
+        else if (isSourceFileMapped)
+        {
+            munmap(pSourceFile, sourceFileLength);
+        }
+        else
+        {
+            stbi_image_free(pSourceFile);
+        }
+        stbi_image_free(pCubemapFaces);
+        stbi_image_free(pPlaceholderPixels);
+    }
+
+    int id = 0;
+    int priority = kLoadPriorityPrefetch; // Guarded by the LoadJobPool's mutex, as is...
+    bool isReleased = false;              // ...this, which is set if it's released while running, so it's forgotten about once it stops
+    std::atomic<int> state{kLoadJobQueued};
+    std::atomic<bool> isCancelled{false};
+
+    std::string filePath;         // Either a file to load...
+    const stbi_uc* pData = NULL;  // ...or image data that the caller keeps alive until the job has finished
+    int dataLength = 0;
+    bool resampleToMaxWidth = true;
+    int maxImageWidth = 4096;
+    int resampleMode = kResampleHalve;
+    bool rgb565On = false;
+    bool useExif = false;
+    bool useExifPlaceholder = false;
+    bool useCpuMipmaps = false;
+    bool useProgressiveUpload = false;
+    bool useViewPriorityUpload = false;
+    bool useCubemap = false;
+    bool useEtc2 = false;
+    bool isKtx = false; // Its file or data is a KTX file of compressed mip levels, which are uploaded as they are - see LoadKtxIntoLoadJob()
+    bool isGalleryThumbnail = false; // Its file's thumbnail is copied out of the gallery index instead, see LoadGalleryThumbnailIntoLoadJob()
+    std::string cacheKey;  // Empty unless it uses the disk cache, in which case it's loaded from the entry at cachePath if there is one,
+    std::string cachePath; //  or written to it once it's finished - see SetLoadJobCacheKey()
+    std::chrono::high_resolution_clock::time_point creationTime = std::chrono::high_resolution_clock::now();
+    std::atomic<float> timeToFirstVisiblePixel{-1.0f}; // In milliseconds from creation, or -1 until visibleMipLevel is first set
+
+    std::mutex mutex; // Guards the rest, which working memory follows
+    stbi_uc* pPixels = NULL;
+    int width = 0;
+    int height = 0;
+    int numScanlines = 0;
+    bool isInWorkingMemory = false;
+    stbi_uc* pMipLevels[kMaxMipLevels] = {}; // Each level below pPixels, once it's been built - see BuildMipLevels()
+    int numMipLevels = 1;
+    stbi_uc* pCubemapFaces = NULL; // Every face one after another, once ConvertLoadJobToCubemap() has built them
+    int cubemapFaceSize = 0;
+    stbi_uc* pCompressedLevels[kMaxMipLevels] = {}; // Each mip level compressed to ETC2 by CompressLoadJobToEtc2(), base level first, or
+    int numCompressedLevels = 0;                     //  pointing into the KTX file it was loaded from
+    CompressedFormat compressedFormat = kEtc2Format;
+    stbi_uc* pSourceFile = NULL; // The KTX file or disk cache entry its pixels or levels point into, if it was loaded from one - mapped into
+    size_t sourceFileLength = 0;  //  memory, or a copy of the KTX data it was given
+    bool isSourceFileMapped = false;
+    stbi_uc* pPlaceholderPixels = NULL; // Its file's EXIF thumbnail in RGB565, once LoadExifPlaceholderIntoLoadJob() has decoded it
+    int placeholderWidth = 0;
+    int placeholderHeight = 0;
+
+    // Where it's uploaded to - set by UploadLoadJobIntoTexture() and from then on only touched by the render thread
+    int textureIndex = 0;
+    bool isCubemapUpload = false; // Uploading its cubemap faces, rather than its pixels - uploadYOffset then runs down every face in turn
+    GLint uploadYOffset = 0;
+    GLint uploadXOffset = 0; // Non-zero while the band at uploadYOffset is being uploaded in tiles
+    int uploadLevel = 0; // Once the base level's uploaded, loads with their own mip levels go on to upload them from uploadYOffset = 0
+    int numTailLevelsUploaded = 0; // Progressive uploads send the levels below the base one coarsest first, see UploadMipTail()
+    GLint mipYOffset = 0;
+    bool isBaseLevelUploaded = false;
+    std::atomic<int> visibleMipLevel{-1}; // The finest mip level that Unity can sample from, or -1 until it can sample any
+    int placeholderTextureIndex = -1; // Where its placeholder's uploaded to, if anywhere
+    std::atomic<bool> isPlaceholderVisible{false};
+    std::vector<bool> uploadedViewTiles; // View-priority uploads only, which tiles of the base level have been uploaded
+    int numViewTilesUploaded = 0;
+    int numScanlinesUploaded = 0;
+    bool isTextureCreated = false;
+    std::atomic<bool> isUploading{false};
+    int stagedYOffset = 0; // Scanlines copied into pixel unpack buffers so far, see PixelUnpackBufferRing
+};
+
+// Takes the current settings, as set from C#
+std::shared_ptr<LoadJob> CreateLoadJob(bool resampleToMaxWidth)
+{
+    std::shared_ptr<LoadJob> pJob = std::make_shared<LoadJob>();
+    pJob->resampleToMaxWidth = resampleToMaxWidth;
+    pJob->maxImageWidth = m_maxImageWidth;
+    pJob->useEtc2 = m_useEtc2Compression && !m_useCubemaps;
+    pJob->rgb565On = m_rgb565On && !pJob->useEtc2; // The ETC2 encoder works from RGB888
+    pJob->useExif = m_useExif;
+    pJob->useExifPlaceholder = m_useExifPlaceholder && !m_useExif; // Which would have it decode nothing but the EXIF thumbnail anyway
+    pJob->useCpuMipmaps = (m_useCpuMipmaps || pJob->useEtc2) && !m_useCubemaps; // Compressed textures can't be glGenerateMipmap()'d, whereas
+    pJob->useProgressiveUpload = pJob->useCpuMipmaps && m_useProgressiveUpload && !pJob->useEtc2; //  cubemaps always are
+    pJob->useViewPriorityUpload = m_useViewPriorityUpload;
+    pJob->useCubemap = m_useCubemaps;
+    pJob->resampleMode = m_resampleMode;
+    if (pJob->resampleMode != kResampleHalve && m_maxImageBytes > 0)
+    {
+        const int kBitsPerPixel = pJob->useEtc2 ? 4 : (pJob->rgb565On ? 16 : 24);
+        pJob->maxImageWidth = std::min(pJob->maxImageWidth, CalcMaxImageWidthForBytes(m_maxImageBytes, kBitsPerPixel));
+    }
+    return pJob;
+}
+
+// KTX files already have every mip level they're going to have, and in the format they're uploaded in
+std::shared_ptr<LoadJob> CreateKtxLoadJob()
+{
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(false);
+    pJob->isKtx = true;
+    pJob->rgb565On = false;
+    pJob->useExif = false;
+    pJob->useExifPlaceholder = false;
+    pJob->useCpuMipmaps = false;
+    pJob->useProgressiveUpload = false;
+    pJob->useViewPriorityUpload = false;
+    pJob->useCubemap = false;
+    pJob->useEtc2 = false;
+    return pJob;
+}
+
+// Gallery thumbnails are stored in RGB565 at their final size, so are uploaded as they are - see GalleryIndex
+std::shared_ptr<LoadJob> CreateGalleryThumbnailLoadJob()
+{
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(false);
+    pJob->isGalleryThumbnail = true;
+    pJob->rgb565On = true;
+    pJob->useExif = false;
+    pJob->useExifPlaceholder = false;
+    pJob->useCpuMipmaps = m_useCpuMipmaps && !m_useCubemaps;
+    pJob->useProgressiveUpload = pJob->useCpuMipmaps && m_useProgressiveUpload;
+    pJob->useViewPriorityUpload = false;
+    pJob->useCubemap = false;
+    pJob->useEtc2 = false;
+    return pJob;
+}
+
+// What the job's pixels or levels end up as
+GLenum CalcLoadJobInternalFormat(const LoadJob& job)
+{
+    return job.useEtc2 ? GL_COMPRESSED_RGB8_ETC2 : (job.rgb565On ? GL_RGB565 : GL_RGB8);
+}
+
+// Identifies what the file at pFileName is by when it was last modified and how big it is, so that edited files get entries of their own.
+//  Returns an empty string if the file can't be found
+std::string CalcFileIdentity(const char* pFileName)
+{
+    struct stat fileStat;
+    if (stat(pFileName, &fileStat) != 0)
+    {
+        return std::string();
+    }
+
+    char identity[64];
+    snprintf(identity, sizeof(identity), "|%lld|%lld", (long long) fileStat.st_mtime, (long long) fileStat.st_size);
+    return pFileName + std::string(identity);
+}
+
+// Has the job use the disk cache entry for source - which has to identify the image exactly - and everything about how it's loaded, so that
+//  an entry's only ever used by loads that would have ended up exactly the same. Cubemap loads don't use it, as they're converted every time
+void SetLoadJobCacheKey(LoadJob& job, const std::string& source)
+{
+    if (job.useCubemap)
+    {
+        return;
+    }
+
+    char settings[96];
+    snprintf(settings, sizeof(settings), "|%d|%d|%d|0x%x|%d|%d", job.maxImageWidth, (int) job.resampleToMaxWidth, job.resampleMode,
+             CalcLoadJobInternalFormat(job), (int) job.useCpuMipmaps, (int) job.useExif);
+    job.cachePath = GetDiskCache().GetEntryPath(source + settings);
+    job.cacheKey = job.cachePath.empty() ? std::string() : source + settings;
+}
+
+// Call with job.mutex held
+void PublishIntoWorkingMemory(LoadJob& job)
+{
+    m_pCurrImage = job.pPixels;
+    m_currImageWidth = job.width;
+    m_currImageHeight = job.height;
+    m_numScanlinesInWorkingMemory = job.numScanlines;
+}
+
+void ClearWorkingMemory()
+{
+    if (m_pWorkingMemoryJob)
+    {
+        std::lock_guard<std::mutex> lock(m_pWorkingMemoryJob->mutex);
+        m_pWorkingMemoryJob->isInWorkingMemory = false;
+    }
+    m_pWorkingMemoryJob.reset();
+    m_pCurrImage = NULL;
+    m_numScanlinesInWorkingMemory = 0;
+}
+
+// Makes the job's pixels the ones that get uploaded, including any it hasn't decoded yet
+void MoveIntoWorkingMemory(const std::shared_ptr<LoadJob>& pJob)
+{
+    ClearWorkingMemory();
+    m_pWorkingMemoryJob = pJob;
+
+    std::lock_guard<std::mutex> lock(pJob->mutex);
+    pJob->isInWorkingMemory = true;
+    PublishIntoWorkingMemory(*pJob);
+}
+
+// Lets the PixelUnpackBufferRing know there may be new scanlines to copy into its buffers
+void WakePixelUnpackBufferStager()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pixelUnpackBuffersMutex); // So it can't be missed between the stager looking for scanlines and waiting
+    }
+    m_pixelUnpackBuffersChanged.notify_all();
+}
+
+// Hands pPixels over to the job
+void SetLoadJobPixels(LoadJob& job, stbi_uc* pPixels, int width, int height, int numScanlines)
+{
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.pPixels = pPixels;
+    job.width = width;
+    job.height = height;
+    job.numScanlines = numScanlines;
+    if (job.isInWorkingMemory)
+    {
+        PublishIntoWorkingMemory(job);
+    }
+    lock.unlock();
+
+    WakePixelUnpackBufferStager();
+}
+
+void SetLoadJobNumScanlines(LoadJob& job, int numScanlines)
+{
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.numScanlines = numScanlines;
+        if (job.isInWorkingMemory)
+        {
+            m_numScanlinesInWorkingMemory = numScanlines;
+        }
+    }
+
+    WakePixelUnpackBufferStager();
+}
+
+// Where each band handed over by the streaming JPEG decoder ends up. Rows are downsampled and format-converted straight
+//  into their final place in the job's pixels, so only a few bands are ever held on top of them
+struct StreamingState
+{
+    LoadJob* pJob = NULL;
+    int ratio = 1; // How many decoded pixels along each axis make up one pixel of the job's image
+    int numPendingRows = 0;
+    std::vector<stbi_uc> pendingRows; // Decoded rows waiting until there are enough of them to downsample
+    std::unique_ptr<SeparableResample> pResample; // Set instead of ratio for the exact resample modes, which every row is fed through
+    std::unique_ptr<SeparableResampler> pResampler;
+};
+
+int StreamBandIntoLoadJob(void* pUser, const stbi_jpeg_band* pBand)
+{
+    StreamingState* pState = (StreamingState*) pUser;
+    LoadJob& job = *pState->pJob;
+    if (job.isCancelled)
+    {
+        return 0; // Stops the decoder
+    }
+
+    // Only this thread writes the pixels, so they can be read without the lock
+    const int kStride = job.width * (job.rgb565On ? kStrideRGB565 : kNumStbChannels);
+    int numScanlines = 0;
+
+    for (int row = 0; row < pBand->num_rows; row++)
+    {
+        const stbi_uc* pDecodedRow = pBand->pixels + row * pBand->stride;
+        if (pState->pResampler)
+        {
+            if (pState->pResampler->IsFinished())
+            {
+                break;
+            }
+            numScanlines = pState->pResampler->AddScanline(pDecodedRow, job.pPixels, kStride);
+            continue;
+        }
+
+        int y = (pBand->y + row) / pState->ratio;
+        if (y >= job.height)
+        {
+            break; // Anything below the 2:1 height is dropped, just like ReampleImageToMaxWidthAndNewType() does
+        }
+
+        // The decoder has already produced these rows at their final size and format
+        if (pState->ratio == 1)
+        {
+            memcpy(job.pPixels + y * kStride, pDecodedRow, (size_t) kStride);
+            numScanlines = y + 1;
+            continue;
+        }
+
+        memcpy(pState->pendingRows.data() + pState->numPendingRows * pBand->stride, pDecodedRow, (size_t) pBand->stride);
+        if (++pState->numPendingRows == pState->ratio)
+        {
+            if (job.rgb565On)
+            {
+                ResampleIntegerRGB565(job.pPixels + y * kStride, pState->pendingRows.data(), pBand->width, pState->ratio, pBand->stride,
+                                      job.width, 1, kStride);
+            }
+            else
+            {
+                ResampleIntegerRGB(job.pPixels + y * kStride, pState->pendingRows.data(), pBand->width, pState->ratio, pBand->stride,
+                                   job.width, 1, kStride);
+            }
+            pState->numPendingRows = 0;
+            numScanlines = y + 1;
+        }
+    }
+
+    if (numScanlines > 0)
+    {
+        SetLoadJobNumScanlines(job, numScanlines);
+    }
+    return 1;
+}
+
+// Decodes a JPEG a band at a time, publishing each finished scanline as it goes so that LoadScanlinesIntoTextureFromWorkingMemory()
+//  can upload them while the rest of the image is still being decoded. With resampleToMaxWidth it produces the same 2:1 image
+//  at maxImageWidth as ReampleImageToMaxWidthAndNewType() would, otherwise the image is kept at whatever size the decoder's downscaling gives.
+//  The exact resample modes feed each row through a SeparableResampler as it arrives
+bool StreamIntoLoadJob(LoadJob& job, const stbi_uc* pData, int dataLength)
+{
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    int comp = -1;
+    int fullWidth = 0, fullHeight = 0;
+    if (!stbi_info_from_memory(pData, dataLength, &fullWidth, &fullHeight, &comp))
+    {
+        LOGI("Failed to read image header: %s\n", stbi_failure_reason());
+        return false;
+    }
+
+    stbi_jpeg_options jpegOptions = {};
+    jpegOptions.scale_shift = CalcJpegScaleShift(fullWidth, job.maxImageWidth, job.resampleMode);
+    const int kRoundUp = (1 << jpegOptions.scale_shift) - 1;
+    int decodedWidth = (fullWidth + kRoundUp) >> jpegOptions.scale_shift;
+    int decodedHeight = (fullHeight + kRoundUp) >> jpegOptions.scale_shift;
+
+    int newWidth = decodedWidth;
+    int newHeight = decodedHeight;
+    if (job.resampleToMaxWidth)
+    {
+        newWidth = CalcResampledWidth(decodedWidth, job.maxImageWidth, job.resampleMode);
+        newHeight = newWidth / 2; // because of 2:1 ratio for 360-images
+    }
+
+    StreamingState state;
+    state.pJob = &job;
+    if (job.resampleMode != kResampleHalve && newWidth != decodedWidth)
+    {
+        state.pResample.reset(new SeparableResample(decodedWidth, decodedHeight, newWidth, newHeight, job.resampleMode, job.rgb565On));
+        state.pResampler.reset(new SeparableResampler(*state.pResample, 0, newHeight));
+    }
+    else
+    {
+        state.ratio = decodedWidth / newWidth;
+        state.pendingRows.resize((size_t) state.ratio * decodedWidth * kNumStbChannels);
+    }
+    jpegOptions.rgb565 = job.rgb565On && state.ratio == 1 && !state.pResampler;
+    jpegOptions.parallel_for = ParallelForJpeg;
+    jpegOptions.parallel_context = &GetWorkerPool();
+
+    LOGI("Streaming image of Width = %d, Height = %d, with JPEG scale 1/%d, into Width = %d, Height = %d\n",
+         fullWidth, fullHeight, 1 << jpegOptions.scale_shift, newWidth, newHeight);
+
+    // Rows the image doesn't cover (or that fail to decode) are left black
+    const size_t kImageSize = (size_t) newHeight * newWidth * (job.rgb565On ? kStrideRGB565 : kNumStbChannels);
+    stbi_uc* pPixels = (stbi_uc*) stbi__malloc(kImageSize);
+    if (pPixels == NULL)
+    {
+        LOGI("Failed to allocate %zu bytes of working memory\n", kImageSize);
+        return false;
+    }
+    memset(pPixels, 0, kImageSize);
+    SetLoadJobPixels(job, pPixels, newWidth, newHeight, 0);
+
+    int width = 0, height = 0;
+    bool success = stbi_jpeg_stream_from_memory(pData, dataLength, &width, &height, &comp, kNumStbChannels, &jpegOptions,
+                                                StreamBandIntoLoadJob, &state) != 0;
+    if (!success)
+    {
+        LOGI("Failed to stream image: %s\n", stbi_failure_reason());
+    }
+
+    // Only this thread adds scanlines, and uploading can't have finished while some are missing
+    if (job.numScanlines < job.height)
+    {
+        SetLoadJobNumScanlines(job, job.height);
+    }
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("StreamIntoLoadJob() walltime = %f", wctduration.count());
+
+    return success;
+}
+
+// Decodes the whole image in one go, letting the JPEG decoder do as much of the downscaling as it can so the full sized image
+//  is never allocated. EXIF thumbnails are used as they are
+bool LoadIntoLoadJob(LoadJob& job, const stbi_uc* pData, int dataLength, bool isExifThumbnail)
+{
+    int comp = -1;
+    int width = 0, height = 0;
+
+    stbi_jpeg_options jpegOptions = {};
+    int fullWidth = 0, fullHeight = 0;
+    if (!isExifThumbnail && stbi_info_from_memory(pData, dataLength, &fullWidth, &fullHeight, &comp))
+    {
+        jpegOptions = CalcJpegOptions(fullWidth, fullHeight, IsJpegData(pData, dataLength), job.maxImageWidth, job.resampleMode, job.rgb565On);
+    }
+
+    stbi_uc* pPixels = stbi_load_from_memory_with_options(pData, dataLength, &width, &height, &comp, kNumStbChannels, &jpegOptions);
+
+    // The decoder may already have packed them to 565 at their final size
+    if (pPixels != NULL && !isExifThumbnail && job.resampleToMaxWidth && !jpegOptions.rgb565)
+    {
+        ReampleImageToMaxWidthAndNewType(pPixels, width, height, job.maxImageWidth, job.resampleMode, job.rgb565On);
+    }
+
+    SetLoadJobPixels(job, pPixels, width, height, height);
+
+    LOGI("Image Loaded has Width = %d, Height = %d, Comp = %d\n", width, height, comp);
+
+    return (width * height) > 0;
+}
+
+// APP1 segments holding EXIF data start with "Exif\0\0" and then TIFF data, in either byte order, whose IFDs say where the thumbnail is
+//  relative to the TIFF header. Returns NULL if the segment hasn't got one, or it doesn't fit inside the segment
+const stbi_uc* FindExifJpegInApp1(const stbi_uc* pSegment, size_t size, int& jpegLength)
+{
+    static const stbi_uc kExifHeader[6] = { 'E', 'x', 'i', 'f', 0, 0 };
+    if (size < sizeof(kExifHeader) + 8 || memcmp(pSegment, kExifHeader, sizeof(kExifHeader)) != 0)
+    {
+        return NULL;
+    }
+
+    const stbi_uc* pTiff = pSegment + sizeof(kExifHeader);
+    const size_t kTiffSize = size - sizeof(kExifHeader);
+    const bool kIsBigEndian = pTiff[0] == 'M' && pTiff[1] == 'M';
+    if (!kIsBigEndian && !(pTiff[0] == 'I' && pTiff[1] == 'I'))
+    {
+        return NULL;
+    }
+    auto read16 = [pTiff, kIsBigEndian](size_t offset) -> uint32_t
+    {
+        return kIsBigEndian ? (pTiff[offset] << 8) | pTiff[offset + 1] : pTiff[offset] | (pTiff[offset + 1] << 8);
+    };
+    auto read32 = [&read16, kIsBigEndian](size_t offset) -> uint32_t
+    {
+        return kIsBigEndian ? (read16(offset) << 16) | read16(offset + 2) : read16(offset) | (read16(offset + 2) << 16);
+    };
+
+    // The thumbnail's IFD is normally the second, but they're all looked through - up to a point, in case one links back to another
+    uint32_t jpegOffset = 0, jpegSize = 0;
+    size_t ifdOffset = read32(4);
+    for (int numIfds = 0; ifdOffset != 0 && numIfds < 8; numIfds++)
+    {
+        if (ifdOffset > kTiffSize - 2)
+        {
+            break;
+        }
+        const size_t kNumEntries = read16(ifdOffset);
+        if (kNumEntries * 12 + 6 > kTiffSize - ifdOffset)
+        {
+            break;
+        }
+        for (size_t i = 0; i < kNumEntries; i++)
+        {
+            const size_t kEntry = ifdOffset + 2 + i * 12;
+            const uint32_t kTag = read16(kEntry);
+            if (kTag == 0x0201) // JPEGInterchangeFormat
+            {
+                jpegOffset = read32(kEntry + 8);
+            }
+            else if (kTag == 0x0202) // JPEGInterchangeFormatLength
+            {
+                jpegSize = read32(kEntry + 8);
+            }
+        }
+        ifdOffset = read32(ifdOffset + 2 + kNumEntries * 12);
+    }
+
+    if (jpegOffset == 0 || jpegSize == 0 || jpegOffset > kTiffSize || jpegSize > kTiffSize - jpegOffset)
+    {
+        return NULL;
+    }
+    jpegLength = (int) jpegSize;
+    return pTiff + jpegOffset;
+}
+
+// Finds the JPEG thumbnail in a length-long EXIF file by walking its markers up to where the image data starts. Only each segment's marker
+//  and size, and the APP1 segment, are ever read - so with the file mapped into memory nothing else is read off storage. Returns NULL if it
+//  hasn't got one
+const stbi_uc* FindExifJpeg(const stbi_uc* pFile, size_t length, int& jpegLength)
+{
+    size_t offset = 0;
+    while (offset + 4 <= length && pFile[offset] == 0xFF)
+    {
+        const int kMarker = pFile[offset + 1];
+        if (kMarker == 0xD8 || kMarker == 0xD9) // Start/end of image
+        {
+            offset += 2;
+            continue;
+        }
+        if (kMarker == 0xDA) // Start of scan, which the image data follows
+        {
+            break;
+        }
+
+        // Every other segment's size, which counts its own two bytes, is big-endian after its marker
+        const size_t kSegmentSize = (pFile[offset + 2] << 8) | pFile[offset + 3];
+        if (kSegmentSize < 2 || kSegmentSize > length - offset - 2)
+        {
+            break;
+        }
+        if (kMarker == 0xE1)
+        {
+            const stbi_uc* pJpeg = FindExifJpegInApp1(pFile + offset + 4, kSegmentSize - 2, jpegLength);
+            if (pJpeg != NULL)
+            {
+                return pJpeg;
+            }
+        }
+        offset += 2 + kSegmentSize;
+    }
+
+    return NULL;
+}
+
+// Decodes the EXIF thumbnail of the job's mapped file, if it has one, into a placeholder to show while the image itself is decoded. Panoramas'
+//  thumbnails are often letterboxed into 4:3, so ones taller than 2:1 are cropped to the band across their middle
+void LoadExifPlaceholderIntoLoadJob(LoadJob& job, const stbi_uc* pFile, size_t length)
+{
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    int jpegLength = 0;
+    const stbi_uc* pJpeg = FindExifJpeg(pFile, length, jpegLength);
+    int width = 0, height = 0, comp = 0;
+    stbi_uc* pThumbnail = pJpeg != NULL ? stbi_load_from_memory(pJpeg, jpegLength, &width, &height, &comp, kNumStbChannels) : NULL;
+    if (pThumbnail == NULL || width < 2 || height < 1)
+    {
+        LOGI("LoadJob %d has no EXIF thumbnail to use as a placeholder", job.id);
+        stbi_image_free(pThumbnail);
+        return;
+    }
+
+    const int kCroppedHeight = std::max(1, std::min(height, width / 2));
+    const int kTop = (height - kCroppedHeight) / 2;
+    stbi_uc* pPixels = (stbi_uc*) stbi__malloc((size_t) width * kCroppedHeight * kStrideRGB565);
+    if (pPixels != NULL)
+    {
+        ResampleIntegerRGB565(pPixels, pThumbnail + (size_t) kTop * width * kNumStbChannels, width, kCroppedHeight, width * kNumStbChannels,
+                              width, kCroppedHeight, width * kStrideRGB565);
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.pPlaceholderPixels = pPixels;
+        job.placeholderWidth = width;
+        job.placeholderHeight = kCroppedHeight;
+    }
+    stbi_image_free(pThumbnail);
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("LoadExifPlaceholderIntoLoadJob() walltime = %f, for LoadJob %d of %d x %d", wctduration.count(), job.id, width, kCroppedHeight);
+}
+
+// Builds every mip level below the decoded image, one from the next, publishing each as soon as it's done so it can be uploaded while
+//  the rest are built. If it's cancelled or runs out of memory the remaining levels are left for glGenerateMipmap()
+void BuildMipLevels(LoadJob& job)
+{
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    const stbi_uc* pSrc = NULL;
+    int width = 0, height = 0;
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        pSrc = job.pPixels;
+        width = job.width;
+        height = job.height;
+    }
+
+    const int kNumLevels = std::min(CalcNumMipLevels(width, height), kMaxMipLevels);
+    for (int level = 1; level < kNumLevels && !job.isCancelled; level++)
+    {
+        stbi_uc* pLevel = DownsampleBox(pSrc, std::max(1, width >> (level - 1)), std::max(1, height >> (level - 1)), job.rgb565On);
+        if (pLevel == NULL)
+        {
+            LOGI("Ran out of memory building mip level %d of LoadJob %d", level, job.id);
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.pMipLevels[level] = pLevel;
+        job.numMipLevels = level + 1;
+        pSrc = pLevel;
+    }
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("BuildMipLevels() walltime = %f, for LoadJob %d", wctduration.count(), job.id);
+}
+
+// Builds the job's cubemap faces from its decoded image, which stays as it is. If it's cancelled or runs out of memory it's left without
+//  any, and cubemap uploads of it are abandoned
+void ConvertLoadJobToCubemap(LoadJob& job)
+{
+    if (job.isCancelled)
+    {
+        return;
+    }
+
+    // Only this thread writes the pixels, and it's finished with them
+    int faceSize = 0;
+    stbi_uc* pFaces = ConvertEquirectToCubemap(job.pPixels, job.width, job.height, job.rgb565On, faceSize);
+
+    std::lock_guard<std::mutex> lock(job.mutex);
+    job.pCubemapFaces = pFaces;
+    job.cubemapFaceSize = pFaces != NULL ? faceSize : 0;
+}
+
+// Compresses the job's image and every mip level it has built to ETC2, publishing each level as soon as it's done. If it's cancelled or runs
+//  out of memory it stops short, and if that's before the base level's done the load can't be uploaded at all
+void CompressLoadJobToEtc2(LoadJob& job)
+{
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    // Only this thread writes the pixels and mip levels, and it's finished with them
+    for (int level = 0; level < job.numMipLevels && !job.isCancelled; level++)
+    {
+        const int kLevelWidth = std::max(1, job.width >> level);
+        const int kLevelHeight = std::max(1, job.height >> level);
+        stbi_uc* pBlocks = CompressEtc2(level == 0 ? job.pPixels : job.pMipLevels[level], kLevelWidth, kLevelHeight);
+        if (pBlocks == NULL)
+        {
+            LOGI("Ran out of memory compressing mip level %d of LoadJob %d", level, job.id);
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.pCompressedLevels[level] = pBlocks;
+        job.numCompressedLevels = level + 1;
+    }
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("CompressLoadJobToEtc2() walltime = %f, for LoadJob %d", wctduration.count(), job.id);
+}
+
+// Maps the whole of the file into memory, read-only, returning NULL if it can't be or it's empty
+stbi_uc* MapFile(const char* pFileName, size_t& length)
+{
+    const int kFile = open(pFileName, O_RDONLY);
+    struct stat fileStat;
+    if (kFile < 0 || fstat(kFile, &fileStat) != 0 || fileStat.st_size <= 0)
+    {
+        if (kFile >= 0)
+        {
+            close(kFile);
+        }
+        return NULL;
+    }
+
+    length = (size_t) fileStat.st_size;
+    void* pMapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, kFile, 0);
+    close(kFile); // The mapping keeps the file open
+    return pMapping != MAP_FAILED ? (stbi_uc*) pMapping : NULL;
+}
+
+// Reads every page of the job's mapped file in on the load thread, so that uploading it never has to wait on storage
+void FaultInMappedFile(const LoadJob& job, stbi_uc* pFile, size_t length)
+{
+    madvise(pFile, length, MADV_WILLNEED);
+    const size_t kPageSize = (size_t) sysconf(_SC_PAGESIZE);
+    volatile stbi_uc touched = 0;
+    for (size_t offset = 0; offset < length && !job.isCancelled; offset += kPageSize)
+    {
+        touched = touched ^ pFile[offset];
+    }
+}
+
+// KTX 1.1's file identifier, which is followed by a KtxHeader
+const stbi_uc kKtxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+const uint32_t kKtxEndianness = 0x04030201;
+
+struct KtxHeader
+{
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+// The compressed formats KTX files can be in. ETC2 decodes ETC1 blocks just the same, and the ASTC ones need GL_KHR_texture_compression_astc_ldr
+const CompressedFormat kKtxFormats[] =
+{
+    { GL_COMPRESSED_RGB8_ETC2, 4, 4, 8 },
+    { GL_COMPRESSED_RGBA8_ETC2_EAC, 4, 4, 16 },
+    { 0x93B0, 4, 4, 16 },   // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+    { 0x93B1, 5, 4, 16 },   // ...and so on, through each block size
+    { 0x93B2, 5, 5, 16 },
+    { 0x93B3, 6, 5, 16 },
+    { 0x93B4, 6, 6, 16 },
+    { 0x93B5, 8, 5, 16 },
+    { 0x93B6, 8, 6, 16 },
+    { 0x93B7, 8, 8, 16 },
+    { 0x93B8, 10, 5, 16 },
+    { 0x93B9, 10, 6, 16 },
+    { 0x93BA, 10, 8, 16 },
+    { 0x93BB, 10, 10, 16 },
+    { 0x93BC, 12, 10, 16 },
+    { 0x93BD, 12, 12, 16 }  // GL_COMPRESSED_RGBA_ASTC_12x12_KHR
+};
+const GLenum kGlEtc1Rgb8 = 0x8D64; // GL_ETC1_RGB8_OES
+
+// Returns NULL if glInternalFormat isn't one that can be loaded
+const CompressedFormat* FindKtxFormat(uint32_t glInternalFormat)
+{
+    if (glInternalFormat == kGlEtc1Rgb8)
+    {
+        glInternalFormat = GL_COMPRESSED_RGB8_ETC2;
+    }
+    for (const CompressedFormat& format : kKtxFormats)
+    {
+        if (format.internalFormat == glInternalFormat)
+        {
+            const bool kIsAstc = format.internalFormat >= 0x93B0 && format.internalFormat <= 0x93BD;
+            return (kIsAstc && !m_isAstcSupported) ? NULL : &format;
+        }
+    }
+    return NULL;
+}
+
+// Checks the header of the length-long KTX file and finds each of its mip levels, which must fit inside it. Only single 2D textures of one of
+//  kKtxFormats are accepted. Fills in the job's size, format and levels, returning false if the file can't be uploaded as it is
+bool ParseKtxFile(LoadJob& job, stbi_uc* pFile, size_t length)
+{
+    KtxHeader header;
+    if (length < sizeof(kKtxIdentifier) + sizeof(header) || memcmp(pFile, kKtxIdentifier, sizeof(kKtxIdentifier)) != 0)
+    {
+        LOGI("LoadJob %d isn't a KTX file", job.id);
+        return false;
+    }
+    memcpy(&header, pFile + sizeof(kKtxIdentifier), sizeof(header));
+
+    const CompressedFormat* pFormat = FindKtxFormat(header.glInternalFormat);
+    if (header.endianness != kKtxEndianness || header.glType != 0 || header.glFormat != 0 || pFormat == NULL)
+    {
+        LOGI("LoadJob %d's KTX file has endianness 0x%x and format 0x%x, which can't be uploaded", job.id, header.endianness, header.glInternalFormat);
+        return false;
+    }
+
+    // A level count of 0 asks for the rest to be generated, which compressed textures can't be - so they're left off
+    const int kMaxLevels = std::min(CalcNumMipLevels((int) std::min(header.pixelWidth, 16384u), (int) std::min(header.pixelHeight, 16384u)), kMaxMipLevels);
+    const int kNumLevels = std::max((int) std::min(header.numberOfMipmapLevels, 1000u), 1);
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelWidth > 16384 || header.pixelHeight > 16384 || header.pixelDepth != 0 ||
+        header.numberOfArrayElements != 0 || header.numberOfFaces != 1 || kNumLevels > kMaxLevels)
+    {
+        LOGI("LoadJob %d's KTX file is %u x %u x %u, with %u array elements, %u faces and %u mip levels, which isn't a single 2D texture", job.id,
+             header.pixelWidth, header.pixelHeight, header.pixelDepth, header.numberOfArrayElements, header.numberOfFaces, header.numberOfMipmapLevels);
+        return false;
+    }
+
+    // Each level is its size, its blocks and then padding up to the next 4 bytes
+    const int kWidth = (int) header.pixelWidth;
+    const int kHeight = (int) header.pixelHeight;
+    size_t offset = sizeof(kKtxIdentifier) + sizeof(header);
+    if (header.bytesOfKeyValueData > length - offset)
+    {
+        LOGI("LoadJob %d's KTX file is cut short", job.id);
+        return false;
+    }
+    offset += header.bytesOfKeyValueData;
+
+    stbi_uc* pLevels[kMaxMipLevels] = {};
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        const size_t kBlocksAcross = (std::max(1, kWidth >> level) + pFormat->blockWidth - 1) / pFormat->blockWidth;
+        const size_t kBlocksDown = (std::max(1, kHeight >> level) + pFormat->blockHeight - 1) / pFormat->blockHeight;
+        const size_t kLevelSize = kBlocksAcross * kBlocksDown * pFormat->blockSize;
+        uint32_t imageSize = 0;
+        if (length - offset < sizeof(imageSize))
+        {
+            LOGI("LoadJob %d's KTX file is cut short", job.id);
+            return false;
+        }
+        memcpy(&imageSize, pFile + offset, sizeof(imageSize));
+        offset += sizeof(imageSize);
+        if (imageSize != kLevelSize)
+        {
+            LOGI("LoadJob %d's KTX file has %u bytes for mip level %d, rather than %zu", job.id, imageSize, level, kLevelSize);
+            return false;
+        }
+        if (kLevelSize > length - offset)
+        {
+            LOGI("LoadJob %d's KTX file is cut short", job.id);
+            return false;
+        }
+        pLevels[level] = pFile + offset;
+        offset += (kLevelSize + 3) & ~(size_t) 3;
+        offset = std::min(offset, length);
+    }
+
+    std::lock_guard<std::mutex> lock(job.mutex);
+    job.width = kWidth;
+    job.height = kHeight;
+    job.compressedFormat = *pFormat;
+    std::copy(pLevels, pLevels + kNumLevels, job.pCompressedLevels);
+    job.numCompressedLevels = kNumLevels;
+    return true;
+}
+
+// Maps the job's KTX file into memory - or copies its KTX data, which only has to outlive the load, not the upload - then checks it and faults
+//  it all in, so that uploading it never waits on storage and there's nothing to decode
+bool LoadKtxIntoLoadJob(LoadJob& job)
+{
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    stbi_uc* pFile = NULL;
+    size_t length = 0;
+    if (!job.filePath.empty())
+    {
+        pFile = MapFile(job.filePath.c_str(), length);
+        if (pFile == NULL)
+        {
+            LOGI("Couldn't map KTX file %s", job.filePath.c_str());
+            return false;
+        }
+    }
+    else
+    {
+        length = (size_t) std::max(job.dataLength, 0);
+        pFile = (stbi_uc*) stbi__malloc(std::max(length, (size_t) 1));
+        if (pFile == NULL)
+        {
+            return false;
+        }
+        memcpy(pFile, job.pData, length);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.pSourceFile = pFile;
+        job.sourceFileLength = length;
+        job.isSourceFileMapped = !job.filePath.empty();
+    }
+    if (!ParseKtxFile(job, pFile, length))
+    {
+        return false;
+    }
+
+    if (job.isSourceFileMapped)
+    {
+        FaultInMappedFile(job, pFile, length);
+    }
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("LoadKtxIntoLoadJob() walltime = %f, for LoadJob %d of %d x %d with %d mip levels", wctduration.count(), job.id, job.width, job.height,
+         job.numCompressedLevels);
+    return true;
+}
+
+// Disk cache entries start with this, which is followed by their key and then each of their levels
+struct DiskCacheHeader
+{
+    char identifier[8];
+    uint32_t version;
+    uint32_t internalFormat; // GL_RGB565, GL_RGB8 or GL_COMPRESSED_RGB8_ETC2
+    int32_t width;
+    int32_t height;
+    int32_t numLevels;
+    uint32_t keyLength;
+    uint64_t levelOffsets[kMaxMipLevels]; // From the start of the file
+    uint64_t levelSizes[kMaxMipLevels];
+};
+
+const char kDiskCacheIdentifier[8] = { 'V', 'R', 'E', 'E', 'L', 'T', 'E', 'X' };
+const uint32_t kDiskCacheVersion = 1;
+const size_t kDiskCacheAlignment = 64; // Each level starts this many bytes into the file, or a multiple of it
+
+// Bytes in a width x height level of internalFormat, which disk cache entries store without any padding
+size_t CalcDiskCacheLevelSize(GLenum internalFormat, int width, int height)
+{
+    if (internalFormat == GL_COMPRESSED_RGB8_ETC2)
+    {
+        return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * kEtc2BlockSize;
+    }
+    return (size_t) width * height * (internalFormat == GL_RGB565 ? kStrideRGB565 : kNumStbChannels);
+}
+
+// How many levels a load should have, and so how many its disk cache entry should have
+int CalcNumLoadJobLevels(const LoadJob& job, int width, int height)
+{
+    return job.useCpuMipmaps ? std::min(CalcNumMipLevels(width, height), kMaxMipLevels) : 1;
+}
+
+// Loads the job from its disk cache entry if it has one, pointing its pixels and levels straight into the mapped file so that there's nothing
+//  to read or decode. Entries that don't match what the job would have ended up with are deleted, and it's loaded as normal instead
+bool LoadDiskCacheEntryIntoLoadJob(LoadJob& job)
+{
+    if (job.cachePath.empty() || !GetDiskCache().Contains(job.cachePath))
+    {
+        return false;
+    }
+
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    size_t length = 0;
+    stbi_uc* pFile = MapFile(job.cachePath.c_str(), length);
+    DiskCacheHeader header = {};
+    bool isValid = pFile != NULL && length >= sizeof(header);
+    if (isValid)
+    {
+        memcpy(&header, pFile, sizeof(header));
+        isValid = memcmp(header.identifier, kDiskCacheIdentifier, sizeof(kDiskCacheIdentifier)) == 0 && header.version == kDiskCacheVersion &&
+                  header.internalFormat == CalcLoadJobInternalFormat(job) && header.width > 0 && header.height > 0 && header.width <= 16384 &&
+                  header.height <= 16384 && header.keyLength == job.cacheKey.size() && header.keyLength <= length - sizeof(header) &&
+                  memcmp(pFile + sizeof(header), job.cacheKey.data(), header.keyLength) == 0 &&
+                  header.numLevels == CalcNumLoadJobLevels(job, header.width, header.height);
+    }
+    for (int level = 0; isValid && level < header.numLevels; level++)
+    {
+        const size_t kLevelSize = CalcDiskCacheLevelSize(header.internalFormat, std::max(1, header.width >> level), std::max(1, header.height >> level));
+        isValid = header.levelSizes[level] == kLevelSize && header.levelOffsets[level] <= length && kLevelSize <= length - header.levelOffsets[level];
+    }
+    if (!isValid)
+    {
+        LOGI("Disk cache entry %s can't be used for LoadJob %d", job.cachePath.c_str(), job.id);
+        if (pFile != NULL)
+        {
+            munmap(pFile, length);
+        }
+        GetDiskCache().Remove(job.cachePath);
+        return false;
+    }
+
+    FaultInMappedFile(job, pFile, length);
+    GetDiskCache().Touch(job.cachePath);
+
+    // ETC2 loads only ever have compressed levels
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.pSourceFile = pFile;
+        job.sourceFileLength = length;
+        job.isSourceFileMapped = true;
+        job.width = header.width;
+        job.height = header.height;
+        for (int level = 0; level < header.numLevels; level++)
+        {
+            stbi_uc* pLevel = pFile + header.levelOffsets[level];
+            if (job.useEtc2)
+            {
+                job.pCompressedLevels[level] = pLevel;
+            }
+            else if (level == 0)
+            {
+                job.pPixels = pLevel;
+            }
+            else
+            {
+                job.pMipLevels[level] = pLevel;
+            }
+        }
+        job.numCompressedLevels = job.useEtc2 ? header.numLevels : 0;
+        job.numMipLevels = job.useEtc2 ? 1 : header.numLevels;
+        job.numScanlines = job.useEtc2 ? 0 : header.height;
+    }
+    WakePixelUnpackBufferStager();
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("LoadDiskCacheEntryIntoLoadJob() walltime = %f, for LoadJob %d of %d x %d with %d levels", wctduration.count(), job.id, job.width,
+         job.height, header.numLevels);
+    return true;
+}
+
+// Writes the finished job to its disk cache entry exactly as it's uploaded, unless it came from a file that's already like that. Jobs that
+//  stopped short of any of their levels aren't written. It goes into a temporary file first, so that no entry's ever seen half-written
+void WriteLoadJobToDiskCache(const LoadJob& job)
+{
+    if (job.cachePath.empty() || job.pSourceFile != NULL || job.state != kLoadJobSucceeded)
+    {
+        return;
+    }
+
+    // It's finished, so nothing writes to it any more
+    const int kNumLevels = job.useEtc2 ? job.numCompressedLevels : job.numMipLevels;
+    if (job.width <= 0 || job.height <= 0 || kNumLevels != CalcNumLoadJobLevels(job, job.width, job.height))
+    {
+        LOGI("LoadJob %d only has %d levels, so isn't being written to the disk cache", job.id, kNumLevels);
+        return;
+    }
+
+    auto wcts = std::chrono::high_resolution_clock::now();
+
+    DiskCacheHeader header = {};
+    memcpy(header.identifier, kDiskCacheIdentifier, sizeof(kDiskCacheIdentifier));
+    header.version = kDiskCacheVersion;
+    header.internalFormat = CalcLoadJobInternalFormat(job);
+    header.width = job.width;
+    header.height = job.height;
+    header.numLevels = kNumLevels;
+    header.keyLength = (uint32_t) job.cacheKey.size();
+    const stbi_uc* pLevels[kMaxMipLevels] = {};
+    size_t length = sizeof(header) + header.keyLength;
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        length = (length + kDiskCacheAlignment - 1) / kDiskCacheAlignment * kDiskCacheAlignment;
+        header.levelOffsets[level] = length;
+        header.levelSizes[level] = CalcDiskCacheLevelSize(header.internalFormat, std::max(1, job.width >> level), std::max(1, job.height >> level));
+        pLevels[level] = job.useEtc2 ? job.pCompressedLevels[level] : (level == 0 ? job.pPixels : job.pMipLevels[level]);
+        length += header.levelSizes[level];
+    }
+
+    char tempSuffix[32];
+    snprintf(tempSuffix, sizeof(tempSuffix), ".%d.tmp", job.id);
+    const std::string kTempPath = job.cachePath + tempSuffix;
+    std::ofstream file(kTempPath, std::ios::binary | std::ios::trunc);
+    file.write((const char*) &header, sizeof(header));
+    file.write(job.cacheKey.data(), job.cacheKey.size());
+    size_t position = sizeof(header) + header.keyLength;
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        static const char kPadding[kDiskCacheAlignment] = {};
+        file.write(kPadding, header.levelOffsets[level] - position);
+        file.write((const char*) pLevels[level], header.levelSizes[level]);
+        position = header.levelOffsets[level] + header.levelSizes[level];
+    }
+    file.close();
+    if (!file || rename(kTempPath.c_str(), job.cachePath.c_str()) != 0)
+    {
+        LOGI("Couldn't write disk cache entry %s for LoadJob %d", job.cachePath.c_str(), job.id);
+        unlink(kTempPath.c_str());
+        return;
+    }
+    GetDiskCache().Add(job.cachePath, length);
+
+    std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+    LOGI("WriteLoadJobToDiskCache() walltime = %f, for LoadJob %d, writing %zu bytes", wctduration.count(), job.id, length);
+}
+
+// Gallery indexes start with this, which is followed by each image's GalleryIndexEntry, newest first, and then their paths and thumbnails
+struct GalleryIndexHeader
+{
+    char identifier[8];
+    uint32_t version;
+    int32_t thumbnailWidth; // The widest any of its thumbnails can be
+    uint32_t numEntries;
+    uint32_t padding;
+};
+
+struct GalleryIndexEntry
+{
+    int64_t modifiedTime; // Along with its size, what says whether the image has changed since it was indexed
+    int64_t fileSize;
+    int32_t width;        // 0 if its header couldn't be read
+    int32_t height;
+    float aspectRatio;
+    int32_t thumbnailWidth; // In RGB565, and 0 x 0 unless the image is 2:1
+    int32_t thumbnailHeight;
+    uint32_t pathLength;
+    uint64_t pathOffset;  // From the start of the file
+    uint64_t thumbnailOffset;
+};
+
+const char kGalleryIndexIdentifier[8] = { 'V', 'R', 'E', 'E', 'L', 'G', 'A', 'L' };
+const uint32_t kGalleryIndexVersion = 1;
+const char* const kGalleryImageExtensions[] = { ".jpg", ".jpe", ".bmp", ".gif", ".png" };
+
+// An image found by GalleryIndex::Scan(), and what it's indexed as - either taken from the previous index, or read from the image itself
+struct GalleryScanFile
+{
+    std::string path;
+    GalleryIndexEntry entry;
+    const stbi_uc* pThumbnail;
+    std::vector<stbi_uc> thumbnail; // Only for images that weren't in the previous index
+};
+
+struct GalleryScan
+{
+    std::vector<GalleryScanFile>* pFiles;
+    std::vector<int> newFiles; // Which of pFiles need reading
+    int thumbnailWidth;
+};
+
+// Reads the header of one of the scan's new files and, if it's 2:1, makes its thumbnail - from its EXIF thumbnail when that's 2:1 as well,
+//  which is all that's read of the file then, or by decoding it at the JPEG decoder's smallest scale that's still wide enough otherwise
+void IndexGalleryFile(void* pArg, int i)
+{
+    GalleryScan* pScan = (GalleryScan*) pArg;
+    GalleryScanFile& file = (*pScan->pFiles)[pScan->newFiles[i]];
+    GalleryIndexEntry& entry = file.entry;
+
+    size_t length = 0;
+    stbi_uc* pFile = MapFile(file.path.c_str(), length);
+    const int kDataLength = (int) std::min(length, (size_t) INT_MAX);
+    int comp = 0;
+    if (pFile == NULL || !stbi_info_from_memory(pFile, kDataLength, &entry.width, &entry.height, &comp) || entry.height <= 0)
+    {
+        LOGI("Couldn't read the header of %s", file.path.c_str());
+        entry.width = entry.height = 0;
+    }
+    entry.aspectRatio = entry.height > 0 ? (float) entry.width / entry.height : 0.0f;
+
+    stbi_uc* pPixels = NULL;
+    int width = 0, height = 0;
+    if (entry.width > 0 && entry.width == entry.height * 2)
+    {
+        int jpegLength = 0;
+        const stbi_uc* pJpeg = FindExifJpeg(pFile, length, jpegLength);
+        if (pJpeg != NULL && stbi_info_from_memory(pJpeg, jpegLength, &width, &height, &comp) && width == height * 2)
+        {
+            pPixels = stbi_load_from_memory(pJpeg, jpegLength, &width, &height, &comp, kNumStbChannels);
+        }
+        if (pPixels == NULL)
+        {
+            madvise(pFile, length, MADV_SEQUENTIAL);
+            stbi_jpeg_options jpegOptions = {};
+            jpegOptions.scale_shift = IsJpegData(pFile, kDataLength) ? CalcJpegScaleShift(entry.width, pScan->thumbnailWidth, kResampleHalve) : 0;
+            pPixels = stbi_load_from_memory_with_options(pFile, kDataLength, &width, &height, &comp, kNumStbChannels, &jpegOptions);
+        }
+    }
+    if (pPixels != NULL && width >= 2 && ReampleImageToMaxWidthAndNewType(pPixels, width, height, pScan->thumbnailWidth, kResampleHalve, true))
+    {
+        file.thumbnail.assign(pPixels, pPixels + (size_t) width * height * kStrideRGB565);
+        entry.thumbnailWidth = width;
+        entry.thumbnailHeight = height;
+    }
+    stbi_image_free(pPixels);
+    file.pThumbnail = file.thumbnail.data();
+
+    if (pFile != NULL)
+    {
+        munmap(pFile, length);
+    }
+}
+
+// Everything the gallery needs to know about each image under a directory - its size, aspect ratio, and a small RGB565 thumbnail if it's
+//  2:1 - kept in an index file that's mapped into memory, so that showing the gallery never has to read the images themselves. Scanning
+//  the directory again only reads images that are new or have changed since the last index was written, and does so across every core
+class GalleryIndex
+{
+public:
+    ~GalleryIndex()
+    {
+        Unmap();
+    }
+
+    // Brings the index at indexPath up to date with every image under directory and maps it in, returning how many images it has - or -1
+    //  if the directory can't be read, in which case the index is left as it was. Images that can't be read are still counted, with a size of 0
+    int Scan(const std::string& directory, const std::string& indexPath, int thumbnailWidth)
+    {
+        std::lock_guard<std::mutex> scanLock(m_scanMutex); // Only scans change the mapping, so it can be read without m_mutex below
+        auto wcts = std::chrono::high_resolution_clock::now();
+
+        if (indexPath != m_indexPath)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Map(indexPath);
+        }
+
+        std::vector<GalleryScanFile> files;
+        if (!FindImages(directory, files))
+        {
+            LOGI("Couldn't read the gallery directory %s", directory.c_str());
+            return -1;
+        }
+
+        GalleryScan scan;
+        scan.pFiles = &files;
+        scan.thumbnailWidth = thumbnailWidth;
+        for (int i = 0; i < (int) files.size(); i++)
+        {
+            auto it = m_entryIndices.find(files[i].path);
+            const GalleryIndexEntry* pOldEntry = (it != m_entryIndices.end() && m_pHeader->thumbnailWidth == thumbnailWidth) ? &m_pEntries[it->second] : NULL;
+            if (pOldEntry != NULL && pOldEntry->modifiedTime == files[i].entry.modifiedTime && pOldEntry->fileSize == files[i].entry.fileSize)
+            {
+                files[i].entry = *pOldEntry;
+                files[i].pThumbnail = m_pFile + pOldEntry->thumbnailOffset;
+            }
+            else
+            {
+                scan.newFiles.push_back(i);
+            }
+        }
+        GetWorkerPool().ParallelFor((int) scan.newFiles.size(), IndexGalleryFile, &scan);
+
+        std::sort(files.begin(), files.end(), [](const GalleryScanFile& a, const GalleryScanFile& b)
+        {
+            return a.entry.modifiedTime != b.entry.modifiedTime ? a.entry.modifiedTime > b.entry.modifiedTime : a.path < b.path;
+        });
+        bool isWritten = Write(indexPath, files, thumbnailWidth);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Map(indexPath);
+        std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+        LOGI("GalleryIndex::Scan() walltime = %f, finding %d images of which %d were read, and %s", wctduration.count(), (int) files.size(),
+             (int) scan.newFiles.size(), isWritten ? "writing the index" : "failing to write the index");
+        return (int) m_numEntries;
+    }
+
+    int GetNumImages()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return (int) m_numEntries;
+    }
+
+    // Returns -1 if the image isn't in the index
+    int Find(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entryIndices.find(path);
+        return it != m_entryIndices.end() ? it->second : -1;
+    }
+
+    // Returns false if index is out of range
+    bool GetImage(int index, GalleryIndexEntry& entry, std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < 0 || index >= (int) m_numEntries)
+        {
+            return false;
+        }
+        entry = m_pEntries[index];
+        path.assign((const char*) m_pFile + entry.pathOffset, entry.pathLength);
+        return true;
+    }
+
+    bool HasThumbnail(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entryIndices.find(path);
+        return it != m_entryIndices.end() && m_pEntries[it->second].thumbnailWidth > 0;
+    }
+
+    // Returns a copy of the image's thumbnail that's the caller's to free, or NULL if it hasn't got one. It's copied so that scanning again
+    //  can unmap the index whenever it likes
+    stbi_uc* CopyThumbnail(const std::string& path, int& width, int& height)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entryIndices.find(path);
+        if (it == m_entryIndices.end() || m_pEntries[it->second].thumbnailWidth <= 0)
+        {
+            return NULL;
+        }
+
+        const GalleryIndexEntry& kEntry = m_pEntries[it->second];
+        const size_t kSize = (size_t) kEntry.thumbnailWidth * kEntry.thumbnailHeight * kStrideRGB565;
+        stbi_uc* pThumbnail = (stbi_uc*) stbi__malloc(kSize);
+        if (pThumbnail != NULL)
+        {
+            memcpy(pThumbnail, m_pFile + kEntry.thumbnailOffset, kSize);
+            width = kEntry.thumbnailWidth;
+            height = kEntry.thumbnailHeight;
+        }
+        return pThumbnail;
+    }
+
+private:
+    // Hidden files and directories are skipped, as they were by the C# that this replaces
+    static bool FindImages(const std::string& directory, std::vector<GalleryScanFile>& files)
+    {
+        DIR* pDirectory = opendir(directory.c_str());
+        if (pDirectory == NULL)
+        {
+            return false;
+        }
+        while (dirent* pDirectoryEntry = readdir(pDirectory))
+        {
+            const std::string kName = pDirectoryEntry->d_name;
+            const std::string kPath = directory + "/" + kName;
+            struct stat fileStat;
+            if (kName[0] == '.' || lstat(kPath.c_str(), &fileStat) != 0)
+            {
+                continue;
+            }
+            if (S_ISDIR(fileStat.st_mode))
+            {
+                FindImages(kPath, files);
+                continue;
+            }
+
+            bool isImage = false;
+            for (const char* pExtension : kGalleryImageExtensions)
+            {
+                const size_t kExtensionLength = strlen(pExtension);
+                isImage |= kName.size() > kExtensionLength && strcasecmp(kName.c_str() + kName.size() - kExtensionLength, pExtension) == 0;
+            }
+            if (isImage && S_ISREG(fileStat.st_mode))
+            {
+                GalleryScanFile file = {};
+                file.path = kPath;
+                file.entry.modifiedTime = (int64_t) fileStat.st_mtime;
+                file.entry.fileSize = (int64_t) fileStat.st_size;
+                files.push_back(file);
+            }
+        }
+        closedir(pDirectory);
+        return true;
+    }
+
+    // Writes into a temporary file first, like the disk cache does, so that the index is never seen half-written
+    static bool Write(const std::string& indexPath, std::vector<GalleryScanFile>& files, int thumbnailWidth)
+    {
+        GalleryIndexHeader header = {};
+        memcpy(header.identifier, kGalleryIndexIdentifier, sizeof(kGalleryIndexIdentifier));
+        header.version = kGalleryIndexVersion;
+        header.thumbnailWidth = thumbnailWidth;
+        header.numEntries = (uint32_t) files.size();
+
+        uint64_t offset = sizeof(header) + files.size() * sizeof(GalleryIndexEntry);
+        for (GalleryScanFile& file : files)
+        {
+            file.entry.pathOffset = offset;
+            file.entry.pathLength = (uint32_t) file.path.size();
+            offset += file.path.size();
+        }
+        for (GalleryScanFile& file : files)
+        {
+            offset = (offset + 3) & ~(uint64_t) 3; // Each thumbnail starts on a 4 byte boundary
+            file.entry.thumbnailOffset = offset;
+            offset += (uint64_t) file.entry.thumbnailWidth * file.entry.thumbnailHeight * kStrideRGB565;
+        }
+
+        const std::string kTempPath = indexPath + ".tmp";
+        std::ofstream file(kTempPath, std::ios::binary | std::ios::trunc);
+        file.write((const char*) &header, sizeof(header));
+        for (const GalleryScanFile& scanFile : files)
+        {
+            file.write((const char*) &scanFile.entry, sizeof(scanFile.entry));
+        }
+        uint64_t position = sizeof(header) + files.size() * sizeof(GalleryIndexEntry);
+        for (const GalleryScanFile& scanFile : files)
+        {
+            file.write(scanFile.path.data(), scanFile.path.size());
+            position += scanFile.path.size();
+        }
+        for (const GalleryScanFile& scanFile : files)
+        {
+            static const char kPadding[4] = {};
+            file.write(kPadding, scanFile.entry.thumbnailOffset - position);
+            const size_t kSize = (size_t) scanFile.entry.thumbnailWidth * scanFile.entry.thumbnailHeight * kStrideRGB565;
+            file.write((const char*) scanFile.pThumbnail, kSize);
+            position = scanFile.entry.thumbnailOffset + kSize;
+        }
+        file.close();
+        if (!file || rename(kTempPath.c_str(), indexPath.c_str()) != 0)
+        {
+            unlink(kTempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Call with m_mutex held. Leaves nothing mapped if the index at indexPath is missing or can't be used
+    void Map(const std::string& indexPath)
+    {
+        Unmap();
+        m_indexPath = indexPath;
+
+        size_t length = 0;
+        stbi_uc* pFile = MapFile(indexPath.c_str(), length);
+        const GalleryIndexHeader* pHeader = (const GalleryIndexHeader*) pFile;
+        bool isValid = pFile != NULL && length >= sizeof(GalleryIndexHeader) &&
+                       memcmp(pHeader->identifier, kGalleryIndexIdentifier, sizeof(kGalleryIndexIdentifier)) == 0 &&
+                       pHeader->version == kGalleryIndexVersion && pHeader->numEntries <= (length - sizeof(GalleryIndexHeader)) / sizeof(GalleryIndexEntry);
+        const GalleryIndexEntry* pEntries = (const GalleryIndexEntry*) (pFile + sizeof(GalleryIndexHeader));
+        for (uint32_t i = 0; isValid && i < pHeader->numEntries; i++)
+        {
+            const GalleryIndexEntry& kEntry = pEntries[i];
+            const uint64_t kThumbnailSize = (uint64_t) std::max(kEntry.thumbnailWidth, 0) * std::max(kEntry.thumbnailHeight, 0) * kStrideRGB565;
+            isValid = kEntry.pathOffset <= length && kEntry.pathLength <= length - kEntry.pathOffset && kEntry.thumbnailWidth <= pHeader->thumbnailWidth &&
+                      kEntry.thumbnailHeight <= pHeader->thumbnailWidth && kEntry.thumbnailOffset <= length && kThumbnailSize <= length - kEntry.thumbnailOffset;
+        }
+        if (!isValid)
+        {
+            if (pFile != NULL)
+            {
+                LOGI("The gallery index %s can't be used", indexPath.c_str());
+                munmap(pFile, length);
+            }
+            return;
+        }
+
+        m_pFile = pFile;
+        m_fileLength = length;
+        m_pHeader = pHeader;
+        m_pEntries = pEntries;
+        m_numEntries = pHeader->numEntries;
+        for (uint32_t i = 0; i < m_numEntries; i++)
+        {
+            m_entryIndices[std::string((const char*) pFile + pEntries[i].pathOffset, pEntries[i].pathLength)] = (int) i;
+        }
+    }
+
+    // Call with m_mutex held
+    void Unmap()
+    {
+        if (m_pFile != NULL)
+        {
+            munmap(m_pFile, m_fileLength);
+        }
+        m_pFile = NULL;
+        m_fileLength = 0;
+        m_pHeader = NULL;
+        m_pEntries = NULL;
+        m_numEntries = 0;
+        m_entryIndices.clear();
+    }
+
+    std::mutex m_scanMutex;
+    std::mutex m_mutex; // Guards the rest, which only scans change
+    std::string m_indexPath;
+    stbi_uc* m_pFile = NULL;
+    size_t m_fileLength = 0;
+    const GalleryIndexHeader* m_pHeader = NULL;
+    const GalleryIndexEntry* m_pEntries = NULL;
+    uint32_t m_numEntries = 0;
+    std::map<std::string, int> m_entryIndices; // By path
+};
+
+GalleryIndex& GetGalleryIndex()
+{
+    static GalleryIndex s_galleryIndex;
+    return s_galleryIndex;
+}
+
+// Gallery thumbnails are already at their final size and format, so only need copying out of the index
+bool LoadGalleryThumbnailIntoLoadJob(LoadJob& job)
+{
+    int width = 0, height = 0;
+    stbi_uc* pPixels = GetGalleryIndex().CopyThumbnail(job.filePath, width, height);
+    if (pPixels == NULL)
+    {
+        LOGI("The gallery index has no thumbnail for %s", job.filePath.c_str());
+        return false;
+    }
+    SetLoadJobPixels(job, pPixels, width, height, height);
+    return true;
+}
+
+// Reads the job's image in and decodes it - JPEGs are streamed, anything else (or an EXIF thumbnail) is loaded in one go
+bool RunLoadJob(LoadJob& job)
+{
+    if (job.isKtx)
+    {
+        return LoadKtxIntoLoadJob(job);
+    }
+    if (job.isGalleryThumbnail)
+    {
+        bool success = LoadGalleryThumbnailIntoLoadJob(job);
+        if (success && job.useCpuMipmaps)
+        {
+            BuildMipLevels(job);
+        }
+        return success;
+    }
+    if (LoadDiskCacheEntryIntoLoadJob(job))
+    {
+        return true;
+    }
+    if (job.filePath.empty() && job.pData == NULL)
+    {
+        return false; // Queued by QueueLoadFromDiskCache(), but its entry has since been evicted
+    }
+
+    // Files are decoded straight out of memory they're mapped into, so only what the decoder looks at is read off storage. EXIF thumbnails
+    //  are decoded where they are in the file, and files without one are decoded in full instead
+    const stbi_uc* pData = job.pData;
+    int dataLength = job.dataLength;
+    size_t fileLength = 0;
+    stbi_uc* pFile = NULL;
+    bool isExifThumbnail = false;
+    if (!job.filePath.empty())
+    {
+        pFile = MapFile(job.filePath.c_str(), fileLength);
+        if (pFile == NULL)
+        {
+            LOGI("Couldn't map %s", job.filePath.c_str());
+            return false;
+        }
+        pData = pFile;
+        dataLength = (int) std::min(fileLength, (size_t) INT_MAX);
+
+        if (job.useExifPlaceholder)
+        {
+            LoadExifPlaceholderIntoLoadJob(job, pFile, fileLength);
+        }
+
+        int jpegLength = 0;
+        const stbi_uc* pJpeg = job.useExif ? FindExifJpeg(pFile, fileLength, jpegLength) : NULL;
+        if (pJpeg != NULL)
+        {
+            pData = pJpeg;
+            dataLength = jpegLength;
+            isExifThumbnail = true;
+        }
+        else
+        {
+            madvise(pFile, fileLength, MADV_SEQUENTIAL);
+        }
+    }
+
+    bool success = (isExifThumbnail || !IsJpegData(pData, dataLength)) ? LoadIntoLoadJob(job, pData, dataLength, isExifThumbnail)
+                                                                       : StreamIntoLoadJob(job, pData, dataLength);
+    if (pFile != NULL)
+    {
+        munmap(pFile, fileLength); // Nothing that's been decoded points into it
+    }
+    if (success && job.useCpuMipmaps)
+    {
+        BuildMipLevels(job);
+    }
+    if (success && job.useCubemap)
+    {
+        ConvertLoadJobToCubemap(job);
+    }
+    if (success && job.useEtc2)
+    {
+        CompressLoadJobToEtc2(job);
+    }
+    return success;
+}
+
+// Runs LoadJobs on threads of its own, highest priority first and oldest first within a priority. Jobs that are still queued
+//  can be reprioritised, or cancelled without ever being decoded; running ones stop at the next band the decoder hands over.
+//  These threads only ever wait on the WorkerPool and never the other way round, so the decoder's ParallelFor() can't deadlock.
+//  They share one queue rather than each having a deque to steal from: a thread stealing from another's deque would take whatever
+//  was there, not the highest priority job anywhere, so a skybox could wait behind prefetches. The queue's only ever a handful of
+//  whole images long, so its lock is taken once per image, and the work inside each image is spread by the WorkerPool.
+//  Finished jobs are written to the disk cache by a thread of the pool's own, so that the next decode doesn't wait on the disk
+class LoadJobPool
+{
+public:
+    explicit LoadJobPool(int numThreads)
+    {
+        for (int i = 0; i < numThreads; i++)
+        {
+            m_threads.emplace_back(&LoadJobPool::WorkerLoop, this);
+        }
+        m_diskCacheWriter = std::thread(&LoadJobPool::DiskCacheWriterLoop, this);
+        LOGI("Started LoadJobPool with %d threads\n", numThreads);
+    }
+
+    ~LoadJobPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            for (auto& job : m_jobs)
+            {
+                Cancel(*job.second);
+            }
+        }
+        m_jobQueued.notify_all();
+        m_diskCacheWriteQueued.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+        m_diskCacheWriter.join();
+    }
+
+    int Queue(const std::shared_ptr<LoadJob>& pJob, int priority)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            pJob->id = m_nextId++;
+            pJob->priority = priority;
+            m_jobs[pJob->id] = pJob;
+            m_queue.push_back(pJob);
+        }
+        m_jobQueued.notify_one();
+        return pJob->id;
+    }
+
+    std::shared_ptr<LoadJob> Find(int id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(id);
+        return it != m_jobs.end() ? it->second : std::shared_ptr<LoadJob>();
+    }
+
+    void SetPriority(int id, int priority)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(id);
+        if (it != m_jobs.end())
+        {
+            it->second->priority = priority;
+        }
+    }
+
+    // Cancels the job if it hasn't finished, and forgets about it - although a running job can still be found until it stops,
+    //  so that callers know when it's finished with their image data. Working memory keeps hold of its job regardless
+    void Release(int id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(id);
+        if (it != m_jobs.end())
+        {
+            Release(it);
+        }
+    }
+
+    void ReleaseAll()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_jobs.begin(); it != m_jobs.end(); )
+        {
+            it = Release(it);
+        }
+    }
+
+private:
+    // Call with m_mutex held
+    std::map<int, std::shared_ptr<LoadJob>>::iterator Release(std::map<int, std::shared_ptr<LoadJob>>::iterator it)
+    {
+        Cancel(*it->second);
+        if (it->second->state == kLoadJobRunning)
+        {
+            it->second->isReleased = true;
+            return ++it;
+        }
+        return m_jobs.erase(it);
+    }
+
+    // Call with m_mutex held
+    void Cancel(LoadJob& job)
+    {
+        job.isCancelled = true;
+        if (job.state == kLoadJobQueued)
+        {
+            m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(),
+                                         [&job](const std::shared_ptr<LoadJob>& pQueued) { return pQueued.get() == &job; }), m_queue.end());
+            job.state = kLoadJobCancelled;
+        }
+    }
+
+    // Call with m_mutex held. Jobs are queued in id order, so the first of the highest priority is the oldest
+    std::shared_ptr<LoadJob> TakeHighestPriorityJob()
+    {
+        auto best = m_queue.begin();
+        for (auto it = m_queue.begin(); it != m_queue.end(); ++it)
+        {
+            if ((*it)->priority > (*best)->priority)
+            {
+                best = it;
+            }
+        }
+        std::shared_ptr<LoadJob> pJob = *best;
+        m_queue.erase(best);
+        return pJob;
+    }
+
+    void WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_jobQueued.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            std::shared_ptr<LoadJob> pJob = TakeHighestPriorityJob();
+            pJob->state = kLoadJobRunning;
+            lock.unlock();
+
+            auto wcts = std::chrono::high_resolution_clock::now();
+            bool success = RunLoadJob(*pJob);
+            pJob->state = pJob->isCancelled ? kLoadJobCancelled : (success ? kLoadJobSucceeded : kLoadJobFailed);
+            std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+            LOGI("LoadJob %d finished with state = %d, walltime = %f", pJob->id, pJob->state.load(), wctduration.count());
+
+            lock.lock();
+            std::shared_ptr<LoadJob> pDroppedJob;
+            if (pJob->state == kLoadJobSucceeded && !pJob->cachePath.empty())
+            {
+                pDroppedJob = QueueDiskCacheWrite(pJob);
+            }
+            if (pJob->isReleased)
+            {
+                m_jobs.erase(pJob->id);
+            }
+            lock.unlock();
+            pJob.reset(); // Might be the last reference, in which case the pixels get freed outside the lock
+            pDroppedJob.reset();
+            lock.lock();
+        }
+    }
+
+    // Call with m_mutex held. Each pending write keeps its job's pixels alive, so if the disk falls that far behind the oldest is
+    //  dropped - the cache only saves a decode, and the newest images are the likeliest to be asked for again. Returns the dropped job,
+    //  for the caller to let go of once it's released the lock
+    std::shared_ptr<LoadJob> QueueDiskCacheWrite(const std::shared_ptr<LoadJob>& pJob)
+    {
+        std::shared_ptr<LoadJob> pDroppedJob;
+        if (m_diskCacheWrites.size() >= kMaxPendingDiskCacheWrites)
+        {
+            pDroppedJob = m_diskCacheWrites.front();
+            m_diskCacheWrites.erase(m_diskCacheWrites.begin());
+            LOGI("LoadJob %d isn't being written to the disk cache, as it's fallen behind", pDroppedJob->id);
+        }
+        m_diskCacheWrites.push_back(pJob);
+        m_diskCacheWriteQueued.notify_one();
+        return pDroppedJob;
+    }
+
+    // Writes finished jobs one at a time, oldest first, and drops any still waiting when the pool stops
+    void DiskCacheWriterLoop()
+    {
+        // On Linux this only lowers the calling thread's priority, so it yields to the decoders and Unity's threads
+        setpriority(PRIO_PROCESS, 0, kDiskCacheWriterNice);
+
+        std::vector<std::shared_ptr<LoadJob>> droppedWrites;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_diskCacheWriteQueued.wait(lock, [this]() { return m_stopping || !m_diskCacheWrites.empty(); });
+            if (m_stopping)
+            {
+                droppedWrites.swap(m_diskCacheWrites);
+                return; // The lock's released before droppedWrites frees their pixels
+            }
+
+            std::shared_ptr<LoadJob> pJob = m_diskCacheWrites.front();
+            m_diskCacheWrites.erase(m_diskCacheWrites.begin());
+            lock.unlock();
+
+            WriteLoadJobToDiskCache(*pJob);
+            pJob.reset(); // Might be the last reference, in which case the pixels get freed outside the lock
+            lock.lock();
+        }
+    }
+
+    static const size_t kMaxPendingDiskCacheWrites = 4;
+    static const int kDiskCacheWriterNice = 10;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobQueued;
+    std::condition_variable m_diskCacheWriteQueued;
+    std::vector<std::shared_ptr<LoadJob>> m_queue;
+    std::vector<std::shared_ptr<LoadJob>> m_diskCacheWrites; // Finished jobs waiting for m_diskCacheWriter, oldest first
+    std::map<int, std::shared_ptr<LoadJob>> m_jobs; // Every job that hasn't been released, by id
+    std::vector<std::thread> m_threads;
+    std::thread m_diskCacheWriter;
+    int m_nextId = 1;
+    bool m_stopping = false;
+};
+
+// On big.LITTLE phones only the cores with the highest maximum frequency are worth decoding on - a LITTLE core would hold up
+//  whichever image it got. Counts every core if the frequencies can't be read
+int CountBigCores()
+{
+    const int kNumCores = (int) std::max(1u, std::thread::hardware_concurrency());
+    std::vector<long> maxFrequencies;
+    for (int i = 0; i < kNumCores; i++)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+        long frequency = 0;
+        std::ifstream(path) >> frequency;
+        if (frequency <= 0)
+        {
+            return kNumCores;
+        }
+        maxFrequencies.push_back(frequency);
+    }
+
+    long fastest = *std::max_element(maxFrequencies.begin(), maxFrequencies.end());
+    return (int) std::count(maxFrequencies.begin(), maxFrequencies.end(), fastest);
+}
+
+// Started on first use, with a thread per big core
+LoadJobPool& GetLoadJobPool()
+{
+    static LoadJobPool s_loadJobPool(CountBigCores());
+    return s_loadJobPool;
+}
+
+// Runs a load on the calling thread, straight into working memory
+bool RunLoadJobInWorkingMemory(const std::shared_ptr<LoadJob>& pJob)
+{
+    MoveIntoWorkingMemory(pJob);
+    pJob->state = kLoadJobRunning;
+    bool success = RunLoadJob(*pJob);
+    pJob->state = success ? kLoadJobSucceeded : kLoadJobFailed;
+    return success;
+}
+
+void StopUploadingLoadJob(LoadJob& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_uploadingJobsMutex);
+        m_uploadingJobs.erase(std::remove_if(m_uploadingJobs.begin(), m_uploadingJobs.end(),
+                                             [&job](const std::shared_ptr<LoadJob>& pUploading) { return pUploading.get() == &job; }), m_uploadingJobs.end());
+    }
+    job.isUploading = false;
+}
+
+// Hands the load over to whichever thread uploads, from scratch, into the texture at textureIndex
+void StartUploadingLoadJob(const std::shared_ptr<LoadJob>& pJob, int textureIndex, bool isCubemapUpload, int placeholderTextureIndex)
+{
+    pJob->textureIndex = textureIndex;
+    pJob->isCubemapUpload = isCubemapUpload;
+    pJob->placeholderTextureIndex = placeholderTextureIndex;
+    pJob->isPlaceholderVisible = false;
+    pJob->uploadYOffset = 0;
+    pJob->uploadXOffset = 0;
+    pJob->uploadLevel = 0;
+    pJob->numTailLevelsUploaded = 0;
+    pJob->mipYOffset = 0;
+    pJob->isBaseLevelUploaded = false;
+    pJob->visibleMipLevel = -1;
+    pJob->timeToFirstVisiblePixel = -1.0f;
+    pJob->uploadedViewTiles.clear();
+    pJob->numViewTilesUploaded = 0;
+    pJob->numScanlinesUploaded = 0;
+    pJob->isTextureCreated = false;
+    pJob->isUploading = true;
+    {
+        std::lock_guard<std::mutex> lock(m_pixelUnpackBuffersMutex);
+        pJob->stagedYOffset = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_uploadingJobsMutex);
+        m_uploadingJobs.push_back(pJob);
+    }
+
+    m_uploadingJobsChanged.notify_all();
+    WakePixelUnpackBufferStager();
+}
+
+// Uploads as many of the scanlines of the load's own mip levels as numPixelsLeft allows, from yOffset of level onwards, moving both on as
+//  it goes. Levels that haven't been built yet are waited for, unless the load has finished without them, in which case they're generated.
+//  Returns true once every level has been uploaded
+bool UploadMipLevels(LoadJob& job, int textureIndex, int& level, GLint& yOffset, int& numPixelsLeft)
+{
+    const bool kHasFinished = job.state != kLoadJobQueued && job.state != kLoadJobRunning;
+    int width = 0, height = 0, numMipLevels = 0;
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        width = job.width;
+        height = job.height;
+        numMipLevels = job.numMipLevels;
+    }
+
+    const int kNumLevels = CalcNumMipLevels(width, height);
+    while (level < kNumLevels && numPixelsLeft > 0)
+    {
+        if (level >= numMipLevels)
+        {
+            if (!kHasFinished)
+            {
+                return false;
+            }
+
+            LOGI("LoadJob %d only has %d mip levels, glGenerateMipmap(GL_TEXTURE_2D)", job.id, numMipLevels);
+            glBindTexture(GL_TEXTURE_2D, m_textureIDs[textureIndex]);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            PrintAllGlError();
+            level = kNumLevels;
+            break;
+        }
+
+        // Levels are never written again once they've been published
+        const int kLevelWidth = std::max(1, width >> level);
+        const int kLevelHeight = std::max(1, height >> level);
+        const GLsizei kNumScanlines = std::min(kLevelHeight - yOffset, std::max(1, numPixelsLeft / kLevelWidth));
+        UploadTile(textureIndex, level, job.pMipLevels[level], kLevelWidth, 0, yOffset, kLevelWidth, kNumScanlines, job.rgb565On);
+        numPixelsLeft -= kNumScanlines * kLevelWidth;
+        yOffset += kNumScanlines;
+        if (yOffset >= kLevelHeight)
+        {
+            level++;
+            yOffset = 0;
+        }
+    }
+
+    return level >= kNumLevels;
+}
+
+// Unity's context only sees what's been uploaded once it's been completely written, which matters when it's been uploaded on the UploadThread
+void WaitForUploadsToComplete()
+{
+    if (m_pUploadThread != NULL)
+    {
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kWaitForGpuTimeout) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        glDeleteSync(fence);
+    }
+}
+
+// Call once whatever's been uploaded can be sampled. The first time, records how long the load took to show anything at all
+void SetVisibleMipLevel(LoadJob& job, int level)
+{
+    if (job.visibleMipLevel < 0)
+    {
+        std::chrono::duration<float, std::milli> timeToFirstVisiblePixel = (std::chrono::high_resolution_clock::now() - job.creationTime);
+        job.timeToFirstVisiblePixel = timeToFirstVisiblePixel.count(); // Before visibleMipLevel, so it's set by the time C# sees that
+        LOGI("LoadJob %d time to first visible pixel = %f ms", job.id, timeToFirstVisiblePixel.count());
+    }
+    job.visibleMipLevel = level;
+}
+
+// Lets Unity sample the load's texture from level downwards, once every level below it has arrived
+void ShowMipLevels(LoadJob& job, int level)
+{
+    LOGI("glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, %d) for LoadJob %d", level, job.id);
+    glBindTexture(GL_TEXTURE_2D, m_textureIDs[job.textureIndex]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    PrintAllGlError();
+
+    WaitForUploadsToComplete();
+    SetVisibleMipLevel(job, level);
+}
+
+// Progressive uploads send every level below the base one as soon as they've all been built, coarsest first and ahead of the rest of the
+//  base level, so the texture can be shown blurry within a frame and sharpen as each finer level arrives. The base level carries on being
+//  uploaded as it's decoded. Returns true once every level, base included, has been uploaded
+bool UploadMipTail(LoadJob& job, bool hasFinished, int& numPixelsLeft)
+{
+    int width = 0, height = 0, numMipLevels = 0;
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        width = job.width;
+        height = job.height;
+        numMipLevels = job.numMipLevels;
+    }
+
+    const int kNumLevels = CalcNumMipLevels(width, height);
+    if (numMipLevels < kNumLevels)
+    {
+        if (!hasFinished || !job.isBaseLevelUploaded)
+        {
+            return false;
+        }
+
+        LOGI("LoadJob %d only has %d mip levels, glGenerateMipmap(GL_TEXTURE_2D)", job.id, numMipLevels);
+        glBindTexture(GL_TEXTURE_2D, m_textureIDs[job.textureIndex]);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        PrintAllGlError();
+        ShowMipLevels(job, 0);
+        return true;
+    }
+
+    while (job.numTailLevelsUploaded < kNumLevels - 1 && numPixelsLeft > 0)
+    {
+        if (!job.isTextureCreated)
+        {
+            AcquireTexture(job.textureIndex, width, height, job.rgb565On, job.useCpuMipmaps);
+            job.isTextureCreated = true;
+        }
+
+        // Levels are never written again once they've been published
+        const int kLevel = kNumLevels - 1 - job.numTailLevelsUploaded;
+        const int kLevelWidth = std::max(1, width >> kLevel);
+        const int kLevelHeight = std::max(1, height >> kLevel);
+        const GLsizei kNumScanlines = std::min(kLevelHeight - job.mipYOffset, std::max(1, numPixelsLeft / kLevelWidth));
+        UploadTile(job.textureIndex, kLevel, job.pMipLevels[kLevel], kLevelWidth, 0, job.mipYOffset, kLevelWidth, kNumScanlines, job.rgb565On);
+        numPixelsLeft -= kNumScanlines * kLevelWidth;
+        job.mipYOffset += kNumScanlines;
+        if (job.mipYOffset >= kLevelHeight)
+        {
+            job.numTailLevelsUploaded++;
+            job.mipYOffset = 0;
+            ShowMipLevels(job, kLevel);
+        }
+    }
+
+    if (job.numTailLevelsUploaded >= kNumLevels - 1 && job.isBaseLevelUploaded)
+    {
+        ShowMipLevels(job, 0);
+        return true;
+    }
+    return false;
+}
+
+// Call once every scanline has been uploaded
+void FinishUploadingLoadJob(LoadJob& job)
+{
+    if (job.isCubemapUpload)
+    {
+        LOGI("glGenerateMipmap(GL_TEXTURE_CUBE_MAP)");
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureIDs[job.textureIndex]);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        PrintAllGlError();
+    }
+    else if (!job.useCpuMipmaps)
+    {
+        LOGI("glBindTexture(GL_TEXTURE_2D, textureId)");
+        glBindTexture(GL_TEXTURE_2D, m_textureIDs[job.textureIndex]);
+        LOGI("glGenerateMipmap(GL_TEXTURE_2D)");
+        glGenerateMipmap(GL_TEXTURE_2D);
+        PrintAllGlError();
+    }
+
+    WaitForUploadsToComplete();
+    SetVisibleMipLevel(job, 0);
+
+    LOGI("LoadJob %d has been uploaded into texture %d", job.id, job.textureIndex);
+    StopUploadingLoadJob(job);
+}
+
+// Uploads the load's placeholder in one go as soon as it's been decoded - it's small enough not to need spreading over frames - so that Unity
+//  has something to show until the load's own texture is visible
+void UploadPlaceholder(LoadJob& job, int& numPixelsLeft)
+{
+    const stbi_uc* pPixels = NULL;
+    int width = 0, height = 0;
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        pPixels = job.pPlaceholderPixels;
+        width = job.placeholderWidth;
+        height = job.placeholderHeight;
+    }
+    if (pPixels == NULL)
+    {
+        return;
+    }
+
+    AcquireTexture(job.placeholderTextureIndex, width, height, true, false);
+    UploadScanlines(job.placeholderTextureIndex, pPixels, width, 0, height, true);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    PrintAllGlError();
+    numPixelsLeft -= width * height;
+
+    WaitForUploadsToComplete();
+    job.isPlaceholderVisible = true;
+    LOGI("LoadJob %d has uploaded its %d x %d placeholder into texture %d", job.id, width, height, job.placeholderTextureIndex);
+}
+
+// Call once every scanline of the base level has been uploaded
+void FinishUploadingBaseLevel(LoadJob& job)
+{
+    if (job.useProgressiveUpload)
+    {
+        job.isBaseLevelUploaded = true; // UploadMipTail() finishes it off once the levels below have arrived too
+        return;
+    }
+    if (job.useCpuMipmaps)
+    {
+        job.uploadLevel = 1;
+        job.uploadYOffset = 0;
+        return;
+    }
+    FinishUploadingLoadJob(job);
+}
+
+// Cubemap uploads wait until the load has finished and its faces have been built, then send them a band of scanlines at a time just like
+//  anything else, never letting a band run from one face into the next. Returns true once every face has been uploaded
+bool UploadCubemapFaces(LoadJob& job, const stbi_uc* pFaces, int faceSize, int& numPixelsLeft)
+{
+    if (!job.isTextureCreated)
+    {
+        AcquireCubemapTexture(job.textureIndex, faceSize, job.rgb565On);
+        job.isTextureCreated = true;
+    }
+
+    // Faces are never written again once the load has finished
+    const size_t kFaceBytes = (size_t) faceSize * faceSize * (job.rgb565On ? kStrideRGB565 : kNumStbChannels);
+    while (job.uploadYOffset < kNumCubemapFaces * faceSize && numPixelsLeft > 0)
+    {
+        const int kFace = job.uploadYOffset / faceSize;
+        const GLint kYOffset = job.uploadYOffset % faceSize;
+        const GLsizei kNumScanlines = std::min(faceSize - kYOffset, std::max(1, numPixelsLeft / faceSize));
+        UploadTileIntoTexture(m_textureIDs[job.textureIndex], GL_TEXTURE_CUBE_MAP_POSITIVE_X + kFace, 0, pFaces + kFace * kFaceBytes, faceSize, 0,
+                              kYOffset, faceSize, kNumScanlines, job.rgb565On);
+        numPixelsLeft -= kNumScanlines * faceSize;
+        job.uploadYOffset += kNumScanlines;
+    }
+
+    return job.uploadYOffset >= kNumCubemapFaces * faceSize;
+}
+
+// Compressed uploads wait until the load has finished compressing (or loading its KTX file), then send its levels base level first, a band of
+//  block rows at a time. Levels it doesn't have are cut off the texture. Returns true once every level has been uploaded
+bool UploadCompressedLevels(LoadJob& job, const CompressedFormat& format, int width, int height, int numCompressedLevels, int& numPixelsLeft)
+{
+    if (!job.isTextureCreated)
+    {
+        AcquireCompressedTexture(job.textureIndex, width, height, format.internalFormat);
+        job.isTextureCreated = true;
+    }
+
+    // Levels are never written again once the load has finished
+    const int kPixelsPerBlock = format.blockWidth * format.blockHeight;
+    while (job.uploadLevel < numCompressedLevels && numPixelsLeft > 0)
+    {
+        const int kLevelWidth = std::max(1, width >> job.uploadLevel);
+        const int kLevelHeight = std::max(1, height >> job.uploadLevel);
+        const int kBlocksAcross = (kLevelWidth + format.blockWidth - 1) / format.blockWidth;
+        const int kBlocksDown = (kLevelHeight + format.blockHeight - 1) / format.blockHeight;
+        const int kFirstBlockRow = job.uploadYOffset / format.blockHeight;
+        const int kNumBlockRows = std::min(kBlocksDown - kFirstBlockRow, std::max(1, numPixelsLeft / (kBlocksAcross * kPixelsPerBlock)));
+        UploadCompressedBlockRows(m_textureIDs[job.textureIndex], job.uploadLevel, format,
+                                  job.pCompressedLevels[job.uploadLevel] + (size_t) kFirstBlockRow * kBlocksAcross * format.blockSize,
+                                  kLevelWidth, kLevelHeight, job.uploadYOffset, kNumBlockRows);
+        numPixelsLeft -= kNumBlockRows * kBlocksAcross * kPixelsPerBlock;
+        job.uploadYOffset += kNumBlockRows * format.blockHeight;
+        if (job.uploadYOffset >= kLevelHeight)
+        {
+            job.uploadLevel++;
+            job.uploadYOffset = 0;
+        }
+    }
+
+    if (job.uploadLevel < numCompressedLevels)
+    {
+        return false;
+    }
+    if (numCompressedLevels < CalcNumMipLevels(width, height))
+    {
+        LOGI("LoadJob %d only has %d compressed mip levels", job.id, numCompressedLevels);
+        glBindTexture(GL_TEXTURE_2D, m_textureIDs[job.textureIndex]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numCompressedLevels - 1);
+        PrintAllGlError();
+    }
+    return true;
+}
+
+// How close the point at (u, v) of an equirectangular image is to where the user's looking, as the cosine of the great-circle angle between
+//  them. u = 0.5 is yaw 0 and goes up with yaw, v = 0 is straight up
+float CalcViewCloseness(float u, float v, float viewYaw, float viewPitch)
+{
+    const float kLongitude = (u - 0.5f) * 360.0f * kDegreesToRadians;
+    const float kLatitude = (0.5f - v) * 180.0f * kDegreesToRadians;
+    const float kViewLongitude = viewYaw * kDegreesToRadians;
+    const float kViewLatitude = viewPitch * kDegreesToRadians;
+    return sinf(kLatitude) * sinf(kViewLatitude) + cosf(kLatitude) * cosf(kViewLatitude) * cosf(kLongitude - kViewLongitude);
+}
+
+// View-priority uploads send the base level a tile at a time, always picking whichever decoded tile is closest to where the user's looking
+//  right now, so what's in view arrives first and the rest spirals out from it. Loads without progressive mip levels are shown as soon as
+//  a tile in view has arrived, with the rest of the texture filling in around it. Returns true once every tile has been uploaded
+bool UploadViewTiles(LoadJob& job, const stbi_uc* pPixels, int width, int height, int numScanlines, int& numPixelsLeft)
+{
+    const int kNumColumns = std::min(kNumViewTilesAcross, width);
+    const int kNumRows = std::min(kNumViewTilesAcross, height);
+    if (job.uploadedViewTiles.empty())
+    {
+        job.uploadedViewTiles.assign(kNumColumns * kNumRows, false);
+    }
+
+    const float kViewYaw = m_viewYaw;
+    const float kViewPitch = m_viewPitch;
+    const float kMinVisibleCloseness = cosf(kViewHalfAngle * kDegreesToRadians);
+    while (numPixelsLeft > 0 && job.numViewTilesUploaded < kNumColumns * kNumRows)
+    {
+        int closestTile = -1;
+        float closestCloseness = -2.0f;
+        for (int row = 0; row < kNumRows && (row + 1) * height / kNumRows <= numScanlines; row++) // Only rows that have been decoded
+        {
+            for (int column = 0; column < kNumColumns; column++)
+            {
+                const float kCloseness = CalcViewCloseness((column + 0.5f) / kNumColumns, (row + 0.5f) / kNumRows, kViewYaw, kViewPitch);
+                if (!job.uploadedViewTiles[row * kNumColumns + column] && kCloseness > closestCloseness)
+                {
+                    closestTile = row * kNumColumns + column;
+                    closestCloseness = kCloseness;
+                }
+            }
+        }
+        if (closestTile == -1)
+        {
+            break; // Waiting on the decoder
+        }
+
+        if (!job.isTextureCreated)
+        {
+            AcquireTexture(job.textureIndex, width, height, job.rgb565On, job.useCpuMipmaps);
+            job.isTextureCreated = true;
+        }
+
+        // Rows below numScanlines are never written again, so can be read without the lock
+        const int kColumn = closestTile % kNumColumns;
+        const int kRow = closestTile / kNumColumns;
+        const GLint kX = kColumn * width / kNumColumns;
+        const GLint kY = kRow * height / kNumRows;
+        const GLsizei kTileWidth = (kColumn + 1) * width / kNumColumns - kX;
+        const GLsizei kTileHeight = (kRow + 1) * height / kNumRows - kY;
+        UploadTile(job.textureIndex, 0, pPixels, width, kX, kY, kTileWidth, kTileHeight, job.rgb565On);
+        numPixelsLeft -= kTileWidth * kTileHeight;
+        job.uploadedViewTiles[closestTile] = true;
+        job.numViewTilesUploaded++;
+
+        if (!job.useProgressiveUpload && job.visibleMipLevel < 0 && closestCloseness >= kMinVisibleCloseness)
+        {
+            WaitForUploadsToComplete();
+            SetVisibleMipLevel(job, 0);
+        }
+    }
+
+    return job.numViewTilesUploaded >= kNumColumns * kNumRows;
+}
+
+// Uploads go through these buffers so that the render thread never touches the pixels itself: a stager thread copies each uploading load's
+//  decoded scanlines into whichever buffers are mapped, then the render thread unmaps them, issues glTexSubImage2D() from the buffer and fences it.
+//  Once the GPU has read a buffer it's mapped again, ready for more scanlines. GLES 3.0 has no persistent mapping, so buffers are
+//  remapped every time round the ring instead - but never while the stager might want them
+class PixelUnpackBufferRing
+{
+public:
+    // Call from the render thread
+    PixelUnpackBufferRing() : m_buffers(kNumBuffers)
+    {
+        LOGI("Creating %d pixel unpack buffers of %d bytes", kNumBuffers, kBufferSize);
+        for (auto& buffer : m_buffers)
+        {
+            glGenBuffers(1, &buffer.id);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, kBufferSize, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        PrintAllGlError();
+
+        RecycleBuffers();
+        m_stager = std::thread(&PixelUnpackBufferRing::StagerLoop, this);
+    }
+
+    // Call from the render thread
+    ~PixelUnpackBufferRing()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_pixelUnpackBuffersMutex);
+            m_stopping = true;
+        }
+        m_pixelUnpackBuffersChanged.notify_all();
+        m_stager.join();
+
+        for (auto& buffer : m_buffers)
+        {
+            if (buffer.fence != 0)
+            {
+                glDeleteSync(buffer.fence);
+            }
+            if (buffer.pMapped != NULL)
+            {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            glDeleteBuffers(1, &buffer.id);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        PrintAllGlError();
+    }
+
+    // Call from the render thread. Maps every buffer that the GPU has finished reading from
+    void RecycleBuffers()
+    {
+        bool isAnyMapped = false;
+        for (auto& buffer : m_buffers)
+        {
+            // Only these states belong to the render thread
+            BufferState state = GetState(buffer);
+            if (state != kBufferInFlight && state != kBufferUnmapped)
+            {
+                continue;
+            }
+
+            if (state == kBufferInFlight)
+            {
+                if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                {
+                    continue;
+                }
+                glDeleteSync(buffer.fence);
+                buffer.fence = 0;
+            }
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+            buffer.pMapped = (stbi_uc*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, kBufferSize,
+                                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            SetState(buffer, buffer.pMapped != NULL ? kBufferMapped : kBufferUnmapped); // Tries again next time if it failed
+            isAnyMapped |= buffer.pMapped != NULL;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        PrintAllGlError();
+
+        if (isAnyMapped)
+        {
+            m_pixelUnpackBuffersChanged.notify_all();
+        }
+    }
+
+    // Call from the render thread. Uploads the buffers the stager has filled, oldest first, until numPixels have been uploaded
+    void UploadFilledBuffers(int numPixels)
+    {
+        std::vector<Buffer*> filledBuffers;
+        {
+            std::lock_guard<std::mutex> lock(m_pixelUnpackBuffersMutex);
+            for (auto& buffer : m_buffers)
+            {
+                if (buffer.state == kBufferFilled)
+                {
+                    filledBuffers.push_back(&buffer);
+                }
+            }
+        }
+        std::sort(filledBuffers.begin(), filledBuffers.end(), [](const Buffer* pA, const Buffer* pB) { return pA->sequence < pB->sequence; });
+
+        // The stager leaves filled buffers alone, so they can be used without the lock
+        for (Buffer* pBuffer : filledBuffers)
+        {
+            if (numPixels <= 0)
+            {
+                break;
+            }
+
+            std::shared_ptr<LoadJob> pJob = std::move(pBuffer->pJob);
+            LoadJob& job = *pJob;
+            if (!job.isUploading || job.isCancelled)
+            {
+                SetState(*pBuffer, kBufferMapped); // Still mapped, so can be refilled straight away
+                m_pixelUnpackBuffersChanged.notify_all();
+                continue;
+            }
+
+            int width = 0, height = 0;
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                width = job.width;
+                height = job.height;
+            }
+
+            if (!job.isTextureCreated)
+            {
+                AcquireTexture(job.textureIndex, width, height, job.rgb565On, job.useCpuMipmaps);
+                job.isTextureCreated = true;
+            }
+
+            LOGI("glBindTexture(GL_TEXTURE_2D, textureId)");
+            glBindTexture(GL_TEXTURE_2D, m_textureIDs[job.textureIndex]);
+            auto wcts = std::chrono::high_resolution_clock::now();
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pBuffer->id);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            pBuffer->pMapped = NULL;
+
+            // The stager packs scanlines tightly, as UploadTileIntoTexture() is given them
+            const bool kIsUnaligned = (width * (job.rgb565On ? kStrideRGB565 : kNumStbChannels)) % 4 != 0;
+            if (kIsUnaligned)
+            {
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            }
+            LOGI("glTexSubImage2D(GL_TEXTURE_2D, 0, 0, %d, %d, %d, ...) from pixel unpack buffer %u", pBuffer->yOffset, width, pBuffer->numScanlines, pBuffer->id);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, pBuffer->yOffset, width, pBuffer->numScanlines, GL_RGB,
+                            job.rgb565On ? GL_UNSIGNED_SHORT_5_6_5 : GL_UNSIGNED_BYTE, (const void*) 0);
+            RecordUploadTime(pBuffer->numScanlines * width, std::chrono::high_resolution_clock::now() - wcts);
+            if (kIsUnaligned)
+            {
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            pBuffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            PrintAllGlError();
+            SetState(*pBuffer, kBufferInFlight);
+
+            numPixels -= pBuffer->numScanlines * width;
+            job.numScanlinesUploaded += pBuffer->numScanlines;
+            if (job.numScanlinesUploaded >= height)
+            {
+                FinishUploadingBaseLevel(job);
+            }
+        }
+    }
+
+private:
+    static const int kNumBuffers = 8;
+    static const int kBufferSize = 1024 * 1024;
+
+    enum BufferState
+    {
+        kBufferUnmapped,  // Waiting for the render thread to map it
+        kBufferMapped,    // Ready for the stager to fill
+        kBufferFilling,   // Being filled by the stager, without the lock
+        kBufferFilled,    // Waiting for the render thread to upload it
+        kBufferInFlight   // Waiting for the GPU to finish reading it
+    };
+
+    struct Buffer
+    {
+        GLuint id = 0;
+        BufferState state = kBufferUnmapped; // Guarded by m_pixelUnpackBuffersMutex
+        stbi_uc* pMapped = NULL;
+        GLsync fence = 0;
+        std::shared_ptr<LoadJob> pJob; // Whose scanlines it's filled with...
+        int yOffset = 0;               // ...starting from this one...
+        int numScanlines = 0;
+        int sequence = 0;              // ...in the order they were filled
+    };
+
+    BufferState GetState(const Buffer& buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_pixelUnpackBuffersMutex);
+        return buffer.state;
+    }
+
+    void SetState(Buffer& buffer, BufferState state)
+    {
+        std::lock_guard<std::mutex> lock(m_pixelUnpackBuffersMutex);
+        buffer.state = state;
+    }
+
+    // Call with m_pixelUnpackBuffersMutex held. Takes as many of the next uploading load's decoded scanlines as fit into the buffer,
+    //  taking turns between loads just like UploadLoadJobs() does
+    bool TakeScanlinesToStage(Buffer& buffer, const stbi_uc*& pSource, size_t& numBytes)
+    {
+        std::vector<std::shared_ptr<LoadJob>> uploadingJobs;
+        {
+            std::lock_guard<std::mutex> lock(m_uploadingJobsMutex);
+            uploadingJobs = m_uploadingJobs;
+        }
+
+        const int kNumUploadingJobs = (int) uploadingJobs.size();
+        for (int i = 0; i < kNumUploadingJobs; i++)
+        {
+            std::shared_ptr<LoadJob>& pJob = uploadingJobs[(m_nextJobToStage + i) % kNumUploadingJobs];
+            if (pJob->isCancelled || pJob->useViewPriorityUpload || pJob->isCubemapUpload || pJob->useEtc2 || pJob->isKtx) // These upload directly
+            {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(pJob->mutex);
+            const int kScanlineSize = pJob->width * (pJob->rgb565On ? kStrideRGB565 : kNumStbChannels);
+            const int kNumScanlines = std::min(pJob->numScanlines - pJob->stagedYOffset, kBufferSize / std::max(1, kScanlineSize));
+            if (pJob->pPixels == NULL || kNumScanlines <= 0)
+            {
+                continue;
+            }
+
+            // Scanlines below numScanlines are never written again, so can be copied without the job's lock
+            pSource = pJob->pPixels + (size_t) pJob->stagedYOffset * kScanlineSize;
+            numBytes = (size_t) kNumScanlines * kScanlineSize;
+            buffer.pJob = pJob;
+            buffer.yOffset = pJob->stagedYOffset;
+            buffer.numScanlines = kNumScanlines;
+            pJob->stagedYOffset += kNumScanlines;
+            m_nextJobToStage = (m_nextJobToStage + i + 1) % kNumUploadingJobs;
+            return true;
+        }
+        return false;
+    }
+
+    void StagerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_pixelUnpackBuffersMutex);
+        while (!m_stopping)
+        {
+            auto mappedBuffer = std::find_if(m_buffers.begin(), m_buffers.end(), [](const Buffer& buffer) { return buffer.state == kBufferMapped; });
+            const stbi_uc* pSource = NULL;
+            size_t numBytes = 0;
+            if (mappedBuffer == m_buffers.end() || !TakeScanlinesToStage(*mappedBuffer, pSource, numBytes))
+            {
+                m_pixelUnpackBuffersChanged.wait(lock);
+                continue;
+            }
+
+            mappedBuffer->state = kBufferFilling;
+            lock.unlock();
+            memcpy(mappedBuffer->pMapped, pSource, numBytes);
+            lock.lock();
+            mappedBuffer->state = kBufferFilled;
+            mappedBuffer->sequence = m_nextSequence++;
+        }
+    }
+
+    std::vector<Buffer> m_buffers;
+    std::thread m_stager;
+    int m_nextJobToStage = 0; // These are guarded by m_pixelUnpackBuffersMutex
+    int m_nextSequence = 0;
+    bool m_stopping = false;
+};
+
+// Shares m_maxPixelsUploadedPerFrame between every load that's uploading. Each load's texture is created as soon as its first
+//  scanlines are decoded, then its scanlines are uploaded as they're decoded until it's complete or cancelled
+void UploadLoadJobs()
+{
+    LOGI("Calling UploadLoadJobs()");
+
+    std::vector<std::shared_ptr<LoadJob>> uploadingJobs;
+    {
+        std::lock_guard<std::mutex> lock(m_uploadingJobsMutex);
+        uploadingJobs = m_uploadingJobs;
+    }
+
+    if (m_pPixelUnpackBuffers != NULL)
+    {
+        m_pPixelUnpackBuffers->RecycleBuffers();
+    }
+
+    const int kNumUploadingJobs = (int) uploadingJobs.size();
+    int numPixelsLeft = m_maxPixelsUploadedPerFrame;
+    m_firstUploadingJob++;
+
+    for (int i = 0; i < kNumUploadingJobs && numPixelsLeft > 0; i++)
+    {
+        LoadJob& job = *uploadingJobs[(m_firstUploadingJob + i) % kNumUploadingJobs];
+
+        // Read first, as once it has finished its pixels can't change
+        const bool kHasFinished = job.state != kLoadJobQueued && job.state != kLoadJobRunning;
+        stbi_uc* pPixels = NULL;
+        stbi_uc* pCubemapFaces = NULL;
+        int width = 0, height = 0, numScanlines = 0, cubemapFaceSize = 0, numCompressedLevels = 0;
+        CompressedFormat compressedFormat = {};
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            pPixels = job.pPixels;
+            width = job.width;
+            height = job.height;
+            numScanlines = job.numScanlines;
+            pCubemapFaces = job.pCubemapFaces;
+            cubemapFaceSize = job.cubemapFaceSize;
+            numCompressedLevels = job.numCompressedLevels;
+            compressedFormat = job.compressedFormat;
+        }
+
+        // Compressed loads don't need any pixels, only compressed levels
+        const bool kIsCompressed = job.useEtc2 || job.isKtx;
+        const bool kIsMissingPixels = pPixels == NULL && !kIsCompressed;
+        const bool kIsMissingCubemap = job.isCubemapUpload && pCubemapFaces == NULL;
+        const bool kIsMissingCompressed = !job.isCubemapUpload && kIsCompressed && numCompressedLevels == 0;
+        if (job.isCancelled || (kHasFinished && (kIsMissingPixels || kIsMissingCubemap || kIsMissingCompressed)))
+        {
+            LOGI("LoadJob %d won't be uploaded", job.id);
+            StopUploadingLoadJob(job);
+            continue;
+        }
+        if (job.placeholderTextureIndex >= 0 && !job.isPlaceholderVisible && job.visibleMipLevel < 0)
+        {
+            UploadPlaceholder(job, numPixelsLeft);
+        }
+        if (job.isCubemapUpload)
+        {
+            if (kHasFinished && UploadCubemapFaces(job, pCubemapFaces, cubemapFaceSize, numPixelsLeft))
+            {
+                FinishUploadingLoadJob(job);
+            }
+            continue;
+        }
+        if (kIsCompressed)
+        {
+            if (kHasFinished && UploadCompressedLevels(job, compressedFormat, width, height, numCompressedLevels, numPixelsLeft))
+            {
+                FinishUploadingLoadJob(job);
+            }
+            continue;
+        }
+        if (job.useProgressiveUpload)
+        {
+            if (UploadMipTail(job, kHasFinished, numPixelsLeft))
+            {
+                FinishUploadingLoadJob(job);
+                continue;
+            }
+        }
+        else if (job.uploadLevel > 0)
+        {
+            if (UploadMipLevels(job, job.textureIndex, job.uploadLevel, job.uploadYOffset, numPixelsLeft))
+            {
+                FinishUploadingLoadJob(job);
+            }
+            continue;
+        }
+        if (pPixels == NULL || (m_pPixelUnpackBuffers != NULL && !job.useViewPriorityUpload) || job.isBaseLevelUploaded)
+        {
+            continue; // Still reading the header, or it's the stager's job to get its scanlines ready for uploading
+        }
+        if (job.useViewPriorityUpload)
+        {
+            if (UploadViewTiles(job, pPixels, width, height, numScanlines, numPixelsLeft))
+            {
+                FinishUploadingBaseLevel(job);
+            }
+            continue;
+        }
+
+        // Rows below numScanlines are never written again, so can be read without the lock. When there aren't enough pixels left
+        //  for a band of kMinScanlinesPerBand full scanlines, that band is uploaded in tiles across it over as many frames as it takes
+        const GLsizei kBandHeight = std::min(kMinScanlinesPerBand, height - job.uploadYOffset);
+        const bool kUploadTile = job.uploadXOffset > 0 || numPixelsLeft < kBandHeight * width;
+        const GLsizei kNumScanlines = kUploadTile ? kBandHeight : std::min(numScanlines - job.uploadYOffset, numPixelsLeft / width);
+        if (kNumScanlines <= 0 || job.uploadYOffset + kNumScanlines > numScanlines)
+        {
+            continue;
+        }
+
+        if (!job.isTextureCreated)
+        {
+            AcquireTexture(job.textureIndex, width, height, job.rgb565On, job.useCpuMipmaps);
+            job.isTextureCreated = true;
+        }
+
+        if (kUploadTile)
+        {
+            const GLsizei kTileWidth = std::min(width - job.uploadXOffset, std::max(1, numPixelsLeft / kNumScanlines));
+            UploadTile(job.textureIndex, 0, pPixels, width, job.uploadXOffset, job.uploadYOffset, kTileWidth, kNumScanlines, job.rgb565On);
+            numPixelsLeft -= kTileWidth * kNumScanlines;
+            job.uploadXOffset += kTileWidth;
+            if (job.uploadXOffset < width)
+            {
+                continue;
+            }
+            job.uploadXOffset = 0;
+        }
+        else
+        {
+            UploadScanlines(job.textureIndex, pPixels, width, job.uploadYOffset, kNumScanlines, job.rgb565On);
+            numPixelsLeft -= kNumScanlines * width;
+        }
+        job.uploadYOffset += kNumScanlines;
+
+        if (job.uploadYOffset >= height)
+        {
+            FinishUploadingBaseLevel(job);
+        }
+    }
+
+    if (m_pPixelUnpackBuffers != NULL)
+    {
+        m_pPixelUnpackBuffers->UploadFilledBuffers(numPixelsLeft);
+    }
+
+    LOGI("Finished UploadLoadJobs()! %d loads were uploading, with %d pixels to upload at %f pixels/ms", kNumUploadingJobs,
+         m_maxPixelsUploadedPerFrame.load(), m_uploadPixelsPerMillisecond.load());
+}
+
+// Optionally does all the uploading on a thread of its own, with its own EGL context sharing textures and buffers with Unity's, so
+//  glTexImage2D() and glGenerateMipmap() never hold up the render thread. Loads are only reported as uploaded once the GPU has finished
+//  with them, so Unity never sees a texture that's still being written to
+class UploadThread
+{
+public:
+    // Call from the render thread, with Unity's context current. Check IsRunning() afterwards, as its context might not have been created
+    UploadThread()
+    {
+        m_display = eglGetCurrentDisplay();
+        EGLContext unityContext = eglGetCurrentContext();
+        EGLint configId = 0;
+        EGLint numConfigs = 0;
+        eglQueryContext(m_display, unityContext, EGL_CONFIG_ID, &configId);
+        const EGLint kConfigAttributes[] = { EGL_CONFIG_ID, configId, EGL_NONE };
+        EGLConfig config = NULL;
+        if (unityContext == EGL_NO_CONTEXT || !eglChooseConfig(m_display, kConfigAttributes, &config, 1, &numConfigs) || numConfigs == 0)
+        {
+            LOGI("UploadThread couldn't find Unity's EGL config, error = 0x%x", eglGetError());
+            return;
+        }
+
+        const EGLint kContextAttributes[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+        m_context = eglCreateContext(m_display, config, unityContext, kContextAttributes);
+        if (m_context == EGL_NO_CONTEXT)
+        {
+            LOGI("UploadThread couldn't create a shared EGL context, error = 0x%x", eglGetError());
+            return;
+        }
+
+        // Nothing is drawn, but not every driver can make a context current without a surface
+        const EGLint kSurfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        m_surface = eglCreatePbufferSurface(m_display, config, kSurfaceAttributes);
+
+        std::unique_lock<std::mutex> lock(m_uploadingJobsMutex);
+        m_thread = std::thread(&UploadThread::UploadLoop, this);
+        m_started.wait(lock, [this]() { return m_hasStarted; });
+    }
+
+    // Call from the render thread
+    ~UploadThread()
+    {
+        if (m_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_uploadingJobsMutex);
+                m_stopping = true;
+            }
+            m_uploadingJobsChanged.notify_all();
+            m_thread.join();
+        }
+
+        if (m_surface != EGL_NO_SURFACE)
+        {
+            eglDestroySurface(m_display, m_surface);
+        }
+        if (m_context != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(m_display, m_context);
+        }
+    }
+
+    bool IsRunning()
+    {
+        return m_isRunning;
+    }
+
+private:
+    const std::chrono::milliseconds kUploadInterval{4};   // Gives the decoders a chance to get ahead between uploads
+
+    void UploadLoop()
+    {
+        bool isCurrent = eglMakeCurrent(m_display, m_surface, m_surface, m_context) == EGL_TRUE;
+        if (isCurrent)
+        {
+            LOGI("UploadThread started");
+            if (m_usePixelUnpackBuffers)
+            {
+                m_pPixelUnpackBuffers = new PixelUnpackBufferRing();
+            }
+        }
+        else
+        {
+            LOGI("UploadThread couldn't make its EGL context current, error = 0x%x", eglGetError());
+        }
+
+        std::unique_lock<std::mutex> lock(m_uploadingJobsMutex);
+        m_isRunning = isCurrent;
+        m_hasStarted = true;
+        m_started.notify_all();
+
+        while (isCurrent)
+        {
+            m_uploadingJobsChanged.wait(lock, [this]() { return m_stopping || !m_uploadingJobs.empty(); });
+            if (m_stopping)
+            {
+                break;
+            }
+
+            lock.unlock();
+            UploadLoadJobs();
+            glFlush();
+            lock.lock();
+            m_uploadingJobsChanged.wait_for(lock, kUploadInterval, [this]() { return m_stopping; });
+        }
+        lock.unlock();
+
+        if (isCurrent)
+        {
+            delete m_pPixelUnpackBuffers;
+            m_pPixelUnpackBuffers = NULL;
+            eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+    }
+
+    EGLDisplay m_display = EGL_NO_DISPLAY;
+    EGLContext m_context = EGL_NO_CONTEXT;
+    EGLSurface m_surface = EGL_NO_SURFACE;
+    std::thread m_thread;
+    std::condition_variable m_started;
+    bool m_hasStarted = false; // These are guarded by m_uploadingJobsMutex
+    bool m_isRunning = false;
+    bool m_stopping = false;
+};
+
+std::shared_ptr<TiledPanorama> FindTiledPanorama(int id)
+{
+    std::lock_guard<std::mutex> lock(m_tiledPanoramasMutex);
+    auto it = m_tiledPanoramas.find(id);
+    return it != m_tiledPanoramas.end() ? it->second : std::shared_ptr<TiledPanorama>();
+}
+
+// Shows panoramas wider than maxImageWidth at their full resolution. The image is split into a grid of m_panoramaTileSize tiles, and only
+//  those around the view direction are decoded and uploaded, each into one of m_panoramaTileTextures. Those are shared by every panorama
+//  and reused least recently viewed first, so tiles take up a fixed amount of GPU memory however big the image is - anywhere without a
+//  tile is left to the ordinary, downsampled load of the same image, which C# shows behind them. JPEGs can only be decoded from the top,
+//  so whenever tiles come into view a decoder thread streams the image down to the lowest of them, copying out just their pixels
+class TiledPanorama
+{
+public:
+    TiledPanorama(int id, const std::string& filePath, int maxImageWidth) : m_id(id), m_filePath(filePath), m_maxImageWidth(maxImageWidth)
+    {
+        m_decoder = std::thread(&TiledPanorama::DecoderLoop, this);
+    }
+
+    ~TiledPanorama()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_tilesWanted.notify_all();
+        m_decoder.join();
+
+        for (Tile& tile : m_tiles)
+        {
+            stbi_image_free(tile.pPixels);
+        }
+    }
+
+    // In degrees, as for SetViewDirection()
+    void SetViewDirection(float yaw, float pitch)
+    {
+        m_viewYaw = yaw;
+        m_viewPitch = pitch;
+    }
+
+    // These are all 0 until the decoder has read the image's header, and stay that way unless it's a JPEG wider than maxImageWidth
+    int GetWidth()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_width;
+    }
+
+    int GetHeight()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_height;
+    }
+
+    int GetNumColumns()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_numColumns;
+    }
+
+    int GetNumRows()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_numRows;
+    }
+
+    // Returns 0 unless the whole tile has been uploaded
+    GLuint GetTileTexture(int column, int row)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (column < 0 || column >= m_numColumns || row < 0 || row >= m_numRows)
+        {
+            return 0;
+        }
+
+        const Tile& tile = m_tiles[row * m_numColumns + column];
+        return tile.isResident ? m_panoramaTileTextures[tile.textureSlot].id : 0;
+    }
+
+    // Call from the render thread. Works out which tiles are in view, keeping their tile textures from being reused, asks the decoder for
+    //  any that haven't been decoded, and uploads those that have, closest to the view direction first
+    void Update(int& numPixelsLeft)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_numColumns == 0)
+        {
+            return;
+        }
+
+        const float kViewYaw = m_viewYaw;
+        const float kViewPitch = m_viewPitch;
+        bool isAnyToDecode = false;
+        std::vector<std::pair<float, int>> tilesToUpload; // Furthest from the view direction last
+        for (int i = 0; i < (int) m_tiles.size(); i++)
+        {
+            Tile& tile = m_tiles[i];
+            int x = 0, y = 0, width = 0, height = 0;
+            GetTileRect(i, x, y, width, height);
+
+            // Anywhere in the tile is within this of its centre
+            const float kLongitudeSpan = width * 360.0f / m_width;
+            const float kLatitudeSpan = height * 180.0f / m_height;
+            const float kTileRadius = 0.5f * sqrtf(kLongitudeSpan * kLongitudeSpan + kLatitudeSpan * kLatitudeSpan);
+            const float kMaxAngle = std::min(kViewHalfAngle + kPanoramaViewMargin + kTileRadius, 180.0f);
+            const float kCloseness = CalcViewCloseness((x + 0.5f * width) / m_width, (y + 0.5f * height) / m_height, kViewYaw, kViewPitch);
+            tile.isWanted = kCloseness >= cosf(kMaxAngle * kDegreesToRadians);
+            tile.closeness = kCloseness;
+
+            if (tile.isWanted && tile.isResident)
+            {
+                m_panoramaTileTextures[tile.textureSlot].lastUsedFrame = m_panoramaFrame;
+            }
+            else if (tile.isWanted && tile.pPixels != NULL)
+            {
+                tilesToUpload.push_back(std::make_pair(-kCloseness, i));
+            }
+            else if (tile.isWanted)
+            {
+                isAnyToDecode |= !tile.isDecoding;
+            }
+            else if (tile.pPixels != NULL) // It's been looked away from before it could be uploaded
+            {
+                if (tile.textureSlot != -1)
+                {
+                    ReleaseTileTexture(tile.textureSlot);
+                }
+                stbi_image_free(tile.pPixels);
+                tile.pPixels = NULL;
+            }
+        }
+
+        std::sort(tilesToUpload.begin(), tilesToUpload.end());
+        for (size_t i = 0; i < tilesToUpload.size() && numPixelsLeft > 0; i++)
+        {
+            Tile& tile = m_tiles[tilesToUpload[i].second];
+            if (tile.textureSlot == -1)
+            {
+                tile.textureSlot = TakeTileTexture();
+                if (tile.textureSlot == -1)
+                {
+                    EvictFurtherTile(tile.closeness); // Every tile texture is in view already, but this one can have one that's further away
+                    break;
+                }
+            }
+            PanoramaTileTexture& tileTexture = m_panoramaTileTextures[tile.textureSlot];
+            tileTexture.lastUsedFrame = m_panoramaFrame;
+
+            int x = 0, y = 0, width = 0, height = 0;
+            GetTileRect(tilesToUpload[i].second, x, y, width, height);
+            const GLsizei kNumScanlines = std::min(height - tile.numScanlinesUploaded, std::max(1, numPixelsLeft / width));
+            UploadTileIntoTexture(tileTexture.id, GL_TEXTURE_2D, 0, tile.pPixels, width, 0, tile.numScanlinesUploaded, width, kNumScanlines, m_panoramaTilesRGB565On);
+            numPixelsLeft -= kNumScanlines * width;
+            tile.numScanlinesUploaded += kNumScanlines;
+
+            if (tile.numScanlinesUploaded >= height)
+            {
+                glBindTexture(GL_TEXTURE_2D, tileTexture.id);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                PrintAllGlError();
+
+                stbi_image_free(tile.pPixels);
+                tile.pPixels = NULL;
+                tile.isResident = true;
+                LOGI("TiledPanorama %d has uploaded tile %d into texture %u", m_id, tilesToUpload[i].second, tileTexture.id);
+            }
+        }
+        lock.unlock();
+
+        if (isAnyToDecode)
+        {
+            m_tilesWanted.notify_all();
+        }
+    }
+
+private:
+    struct Tile
+    {
+        bool isWanted = false;
+        bool isDecoding = false;
+        stbi_uc* pPixels = NULL;      // Once it's been decoded, until it's been uploaded
+        int textureSlot = -1;         // Which of m_panoramaTileTextures it's being uploaded into, or is resident in
+        int numScanlinesUploaded = 0;
+        bool isResident = false;
+        float closeness = -1.0f;      // To the view direction, as of the last Update()
+    };
+
+    // Where each band handed over by the streaming JPEG decoder gets copied into
+    struct DecodingState
+    {
+        TiledPanorama* pPanorama = NULL;
+        std::vector<int> tiles;
+        std::vector<stbi_uc*> pixels; // One for each of tiles
+        int numRowsNeeded = 0;
+        int numRowsDecoded = 0;
+    };
+
+    // Tiles along the right and bottom edges are cut short by the image
+    void GetTileRect(int tileIndex, int& x, int& y, int& width, int& height)
+    {
+        x = (tileIndex % m_numColumns) * m_panoramaTileSize;
+        y = (tileIndex / m_numColumns) * m_panoramaTileSize;
+        width = std::min(m_panoramaTileSize, m_width - x);
+        height = std::min(m_panoramaTileSize, m_height - y);
+    }
+
+    // Call with m_mutex held
+    bool IsTileToDecode(const Tile& tile)
+    {
+        return tile.isWanted && !tile.isDecoding && !tile.isResident && tile.pPixels == NULL;
+    }
+
+    // Call with m_mutex held. Gives up the tile texture, which might still be half uploaded
+    void ReleaseTileTexture(int slot)
+    {
+        for (Tile& tile : m_tiles)
+        {
+            if (tile.textureSlot == slot)
+            {
+                tile.textureSlot = -1;
+                tile.numScanlinesUploaded = 0;
+                tile.isResident = false;
+            }
+        }
+        m_panoramaTileTextures[slot].panoramaId = 0;
+        m_panoramaTileTextures[slot].lastUsedFrame = -1;
+    }
+
+    // Call from the render thread with m_mutex held. Gives up the tile texture of whichever resident tile is furthest from the view direction,
+    //  if it's further than closeness. It's only taken for another tile once it's been out of use for as long as any other
+    void EvictFurtherTile(float closeness)
+    {
+        Tile* pFurthestTile = NULL;
+        for (Tile& tile : m_tiles)
+        {
+            if (tile.isResident && tile.closeness < closeness && (pFurthestTile == NULL || tile.closeness < pFurthestTile->closeness))
+            {
+                pFurthestTile = &tile;
+            }
+        }
+        if (pFurthestTile != NULL)
+        {
+            const int kSlot = pFurthestTile->textureSlot;
+            ReleaseTileTexture(kSlot);
+            m_panoramaTileTextures[kSlot].lastUsedFrame = m_panoramaFrame;
+        }
+    }
+
+    // Call from the render thread with m_mutex held. Takes whichever tile texture has been out of view the longest, from whichever
+    //  panorama has it, or returns -1 if they're all in view. Ones in view last frame might still be being drawn, so are left alone too
+    int TakeTileTexture()
+    {
+        int slot = -1;
+        for (int i = 0; i < (int) m_panoramaTileTextures.size(); i++)
+        {
+            const int kLastUsedFrame = m_panoramaTileTextures[i].lastUsedFrame;
+            if (kLastUsedFrame < m_panoramaFrame - 1 && (slot == -1 || kLastUsedFrame < m_panoramaTileTextures[slot].lastUsedFrame))
+            {
+                slot = i;
+            }
+        }
+        if (slot == -1)
+        {
+            return -1;
+        }
+
+        const int kPanoramaId = m_panoramaTileTextures[slot].panoramaId;
+        if (kPanoramaId == m_id)
+        {
+            ReleaseTileTexture(slot);
+        }
+        else if (kPanoramaId != 0)
+        {
+            std::shared_ptr<TiledPanorama> pPanorama = FindTiledPanorama(kPanoramaId); // Only the render thread ever holds two panoramas' locks
+            if (pPanorama)
+            {
+                std::lock_guard<std::mutex> lock(pPanorama->m_mutex);
+                pPanorama->ReleaseTileTexture(slot);
+            }
+        }
+
+        m_panoramaTileTextures[slot].panoramaId = m_id;
+        m_panoramaTileTextures[slot].lastUsedFrame = m_panoramaFrame;
+        return slot;
+    }
+
+    static int CopyBandIntoTiles(void* pUser, const stbi_jpeg_band* pBand)
+    {
+        DecodingState* pState = (DecodingState*) pUser;
+        TiledPanorama& panorama = *pState->pPanorama;
+        if (panorama.m_stopping)
+        {
+            return 0; // Stops the decoder
+        }
+
+        const int kBytesPerPixel = pBand->bytes_per_pixel;
+        for (int row = 0; row < pBand->num_rows; row++)
+        {
+            const int kY = pBand->y + row;
+            const stbi_uc* pDecodedRow = pBand->pixels + row * pBand->stride;
+            for (size_t i = 0; i < pState->tiles.size(); i++)
+            {
+                int x = 0, y = 0, width = 0, height = 0;
+                panorama.GetTileRect(pState->tiles[i], x, y, width, height);
+                if (y <= kY && kY < y + height)
+                {
+                    memcpy(pState->pixels[i] + (size_t) (kY - y) * width * kBytesPerPixel, pDecodedRow + (size_t) x * kBytesPerPixel,
+                           (size_t) width * kBytesPerPixel);
+                }
+            }
+        }
+
+        pState->numRowsDecoded = pBand->y + pBand->num_rows;
+        return pState->numRowsDecoded < pState->numRowsNeeded; // Nothing below the lowest tile is needed
+    }
+
+    // Streams the image down to the lowest of the tiles, copying out each tile's pixels as its rows go by. Returns every tile's pixels,
+    //  or leaves them all NULL if it fails or is stopped
+    std::vector<stbi_uc*> DecodeTiles(const std::vector<stbi_uc>& fileData, const std::vector<int>& tiles)
+    {
+        auto wcts = std::chrono::high_resolution_clock::now();
+
+        DecodingState state;
+        state.pPanorama = this;
+        state.tiles = tiles;
+        state.pixels.assign(tiles.size(), NULL);
+        bool success = true;
+        for (size_t i = 0; i < tiles.size(); i++)
+        {
+            int x = 0, y = 0, width = 0, height = 0;
+            GetTileRect(tiles[i], x, y, width, height);
+            state.pixels[i] = (stbi_uc*) stbi__malloc((size_t) width * height * (m_panoramaTilesRGB565On ? kStrideRGB565 : kNumStbChannels));
+            success &= state.pixels[i] != NULL;
+            state.numRowsNeeded = std::max(state.numRowsNeeded, y + height);
+        }
+
+        stbi_jpeg_options jpegOptions = {};
+        jpegOptions.rgb565 = m_panoramaTilesRGB565On;
+        jpegOptions.parallel_for = ParallelForJpeg;
+        jpegOptions.parallel_context = &GetWorkerPool();
+        int width = 0, height = 0, comp = -1;
+        if (success)
+        {
+            // Reports failure when it's stopped below the lowest tile, so it's only failed if it didn't get that far
+            stbi_jpeg_stream_from_memory(fileData.data(), (int) fileData.size(), &width, &height, &comp, kNumStbChannels, &jpegOptions,
+                                         CopyBandIntoTiles, &state);
+            success = state.numRowsDecoded >= state.numRowsNeeded;
+        }
+        if (!success)
+        {
+            for (stbi_uc*& pPixels : state.pixels)
+            {
+                stbi_image_free(pPixels);
+                pPixels = NULL;
+            }
+        }
+
+        std::chrono::duration<double> wctduration = (std::chrono::high_resolution_clock::now() - wcts);
+        LOGI("TiledPanorama %d decoded %d tiles down to row %d, success = %d, walltime = %f", m_id, (int) tiles.size(), state.numRowsDecoded,
+             success, wctduration.count());
+        return state.pixels;
+    }
+
+    void DecoderLoop()
+    {
+        std::vector<stbi_uc> fileData;
+        {
+            std::ifstream file(m_filePath, std::ios::binary);
+            fileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        int width = 0, height = 0, comp = -1;
+        if (!IsJpegData(fileData.data(), (int) fileData.size()) || !stbi_info_from_memory(fileData.data(), (int) fileData.size(), &width, &height, &comp))
+        {
+            LOGI("TiledPanorama %d can't be tiled, as %s isn't a JPEG", m_id, m_filePath.c_str());
+            return;
+        }
+        if (width <= m_maxImageWidth)
+        {
+            LOGI("TiledPanorama %d is only %d wide, so its ordinary load is already at full resolution", m_id, width);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_width = width;
+        m_height = height;
+        m_numColumns = (width + m_panoramaTileSize - 1) / m_panoramaTileSize;
+        m_numRows = (height + m_panoramaTileSize - 1) / m_panoramaTileSize;
+        m_tiles.resize(m_numColumns * m_numRows);
+        LOGI("TiledPanorama %d of Width = %d, Height = %d has %d x %d tiles", m_id, width, height, m_numColumns, m_numRows);
+
+        while (true)
+        {
+            m_tilesWanted.wait(lock, [this]()
+            {
+                return m_stopping || std::any_of(m_tiles.begin(), m_tiles.end(), [this](const Tile& tile) { return IsTileToDecode(tile); });
+            });
+            if (m_stopping)
+            {
+                return;
+            }
+
+            // Every tile that's wanted is decoded in the same pass, as they'd each need the image decoding down to them anyway
+            std::vector<int> tilesToDecode;
+            for (int i = 0; i < (int) m_tiles.size(); i++)
+            {
+                if (IsTileToDecode(m_tiles[i]))
+                {
+                    m_tiles[i].isDecoding = true;
+                    tilesToDecode.push_back(i);
+                }
+            }
+            lock.unlock();
+
+            std::vector<stbi_uc*> pixels = DecodeTiles(fileData, tilesToDecode);
+
+            lock.lock();
+            for (size_t i = 0; i < tilesToDecode.size(); i++)
+            {
+                m_tiles[tilesToDecode[i]].isDecoding = false;
+                m_tiles[tilesToDecode[i]].pPixels = pixels[i];
+            }
+            if (!tilesToDecode.empty() && pixels[0] == NULL)
+            {
+                LOGI("TiledPanorama %d has stopped decoding tiles", m_id);
+                return; // Leaving the rest of it to its ordinary load
+            }
+        }
+    }
+
+    const int m_id;
+    const std::string m_filePath;
+    const int m_maxImageWidth;
+    std::atomic<float> m_viewYaw{0.0f};
+    std::atomic<float> m_viewPitch{0.0f};
+    std::thread m_decoder;
+    std::condition_variable m_tilesWanted;
+
+    std::mutex m_mutex; // Guards the rest, although the decoder reads the image's size without it as it's the only one that writes it
+    std::atomic<bool> m_stopping{false};
+    int m_width = 0;
+    int m_height = 0;
+    int m_numColumns = 0;
+    int m_numRows = 0;
+    std::vector<Tile> m_tiles;
+};
+
+// **************************
+// Private functions - accessed through OnRenderEvent()
+// **************************
+
+// These are functions that use OpenGL and hence must be run from the Render Thread, through C#'s GL.IssuePluginEvent()
+enum RenderFunctions
+{
+    kInit = 0,
+    kCreateEmptyTexture = 1,
+    kLoadScanlinesIntoTextureFromWorkingMemory = 2,
+    kRenewTextureHandle = 3,
+    kTerminate = 4,
+    kUploadLoadJobsIntoTextures = 5,
+    kUpdateTiledPanoramas = 6
+};
+
+void Init()
+{
+    if (m_numInits == 0)
+    {
+        LOGI("Calling Init()!");
+
+        LOGI("glGenTextures(%d, m_unpooledTextureIDs)", m_initMaxNumTextures);
+        m_unpooledTextureIDs = new GLuint[m_initMaxNumTextures];
+        glGenTextures(m_initMaxNumTextures, m_unpooledTextureIDs);
+        PrintAllGlError();
+
+        m_textureIDs = new GLuint[m_initMaxNumTextures];
+        for (int i = 0; i < m_initMaxNumTextures; i++)
+        {
+            m_textureIDs[i] = m_unpooledTextureIDs[i];
+            LOGI("Genned texture to Handle = %u \n", m_textureIDs[i]);
+        }
+
+        const char* pExtensions = (const char*) glGetString(GL_EXTENSIONS);
+        m_isAstcSupported = pExtensions != NULL && strstr(pExtensions, "GL_KHR_texture_compression_astc_ldr") != NULL;
+        LOGI("ASTC is %s", m_isAstcSupported ? "supported" : "not supported");
+
+        GLint maxCubemapFaceSize = 0;
+        glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxCubemapFaceSize);
+        if (maxCubemapFaceSize > 0)
+        {
+            m_maxCubemapFaceSize = maxCubemapFaceSize;
+        }
+        PrintAllGlError();
+
+        AllocatePooledTextures();
+        AllocatePanoramaTileTextures();
+
+        if (m_useUploadThread)
+        {
+            m_pUploadThread = new UploadThread();
+            if (!m_pUploadThread->IsRunning())
+            {
+                LOGI("Uploading on the render thread instead");
+                delete m_pUploadThread;
+                m_pUploadThread = NULL;
+            }
+        }
+
+        // The UploadThread has its own
+        if (m_usePixelUnpackBuffers && m_pUploadThread == NULL)
+        {
+            m_pPixelUnpackBuffers = new PixelUnpackBufferRing();
+        }
+
+        LOGI("Finished Init()!");
+    }
+
+    m_numInits++;
+}
+
+void Terminate()
+{
+    m_numInits--;
+
+    if (m_numInits == 0)
+    {
+        LOGI("Calling Terminate()!");
+
+        delete m_pUploadThread;
+        m_pUploadThread = NULL;
+
+        std::map<int, std::shared_ptr<TiledPanorama>> tiledPanoramas;
+        {
+            std::lock_guard<std::mutex> lock(m_tiledPanoramasMutex);
+            tiledPanoramas.swap(m_tiledPanoramas);
+        }
+        tiledPanoramas.clear(); // Stopping their decoders outside the lock
+        DeletePanoramaTileTextures();
+
+        DeletePooledTextures();
+
+        LOGI("glDeleteTextures(%d, m_unpooledTextureIDs)", m_initMaxNumTextures);
+        glDeleteTextures(m_initMaxNumTextures, m_unpooledTextureIDs);
+        PrintAllGlError();
+
+        delete[] m_textureIDs;
+        delete[] m_unpooledTextureIDs;
+
+        delete m_pPixelUnpackBuffers;
+        m_pPixelUnpackBuffers = NULL;
+
+        LOGI("Finished Terminate()!");
+    }
+}
+
+void CreateEmptyTexture()
+{
+    LOGI("Calling CreateEmptyTexture()");
+
+    AcquireTexture(m_currTextureIndex, m_currImageWidth, m_currImageHeight, m_rgb565On, m_pWorkingMemoryJob && m_pWorkingMemoryJob->useCpuMipmaps);
+
+    m_isLoadingIntoTexture = true;
+    m_textureLoadingYOffset = 0;
+    m_textureLoadingLevel = 0;
+
+    LOGI("Finished CreateEmptyTexture()!");
+}
+
+// This function is called repeatedly like a for-loop with the variable m_textureLoadingYOffset updating every iteration
+void LoadScanlinesIntoTextureFromWorkingMemory()
+{
+    LOGI("Calling LoadScanlinesIntoTextureFromWorkingMemory()");
+
+    // Once the base level's uploaded, loads with their own mip levels take the same number of pixels a time to upload those
+    if (m_textureLoadingLevel > 0)
+    {
+        int numPixelsLeft = m_maxPixelsUploadedPerFrame;
+        if (UploadMipLevels(*m_pWorkingMemoryJob, m_currTextureIndex, m_textureLoadingLevel, m_textureLoadingYOffset, numPixelsLeft))
+        {
+            m_isLoadingIntoTexture = false;
+            ClearWorkingMemory();
+        }
+
+        LOGI("Finished LoadScanlinesIntoTextureFromWorkingMemory()! Uploading mip level %d", m_textureLoadingLevel);
+        return;
+    }
+
+    // Each iteration we upload up to kMaxPixelsPerUpload worth of width-long scanlines,
+    //  up until the last one where we only upload the remaining scanlines.
+    //  When streaming, the decoder may not have got that far yet, in which case we only upload what it has finished
+    const GLint kIdealNumberOfScanlinesToUpload = m_maxPixelsUploadedPerFrame/m_currImageWidth;
+    const GLint kNumScanlinesAvailable = m_numScanlinesInWorkingMemory - m_textureLoadingYOffset;
+    GLsizei height = std::min(kIdealNumberOfScanlinesToUpload, kNumScanlinesAvailable);
+    if (height <= 0)
+    {
+        LOGI("Finished LoadScanlinesIntoTextureFromWorkingMemory()! No new scanlines in working memory yet");
+        return;
+    }
+
+    UploadScanlines(m_currTextureIndex, m_pCurrImage, m_currImageWidth, m_textureLoadingYOffset, height, m_rgb565On);
+
+    m_textureLoadingYOffset += height;
+    if (m_textureLoadingYOffset >= m_currImageHeight && m_pWorkingMemoryJob && m_pWorkingMemoryJob->useCpuMipmaps)
+    {
+        m_textureLoadingLevel = 1;
+        m_textureLoadingYOffset = 0;
+    }
+    else if (m_textureLoadingYOffset >= m_currImageHeight)
+    {
+        m_isLoadingIntoTexture = false;
+        ClearWorkingMemory();
+
+        LOGI("glGenerateMipmap(GL_TEXTURE_2D)");
+        glGenerateMipmap(GL_TEXTURE_2D);
+        PrintAllGlError();
+    }
+
+    LOGI("Finished LoadScanlinesIntoTextureFromWorkingMemory()! Loading in progress = %d", m_isLoadingIntoTexture);
+}
+
+// Called once a frame while any loads are uploading, unless the UploadThread is doing it instead
+void UploadLoadJobsIntoTextures()
+{
+    if (m_pUploadThread == NULL)
+    {
+        UploadLoadJobs();
+    }
+}
+
+// Called once a frame while any tiled panoramas are being shown. Tiles take turns at a frame's worth of uploading just like loads do
+void UpdateTiledPanoramas()
+{
+    std::vector<std::shared_ptr<TiledPanorama>> tiledPanoramas;
+    {
+        std::lock_guard<std::mutex> lock(m_tiledPanoramasMutex);
+        for (auto& tiledPanorama : m_tiledPanoramas)
+        {
+            tiledPanoramas.push_back(tiledPanorama.second);
+        }
+    }
+
+    m_panoramaFrame++;
+    int numPixelsLeft = m_maxPixelsUploadedPerFrame;
+    for (auto& pTiledPanorama : tiledPanoramas)
+    {
+        pTiledPanorama->Update(numPixelsLeft);
+    }
+}
+
+static void UNITY_INTERFACE_API OnRenderEvent(int eventID)
+{
+    if (eventID == kInit)
+    {
+        Init();
+    }
+    else if (eventID == kCreateEmptyTexture)
+    {
+        CreateEmptyTexture();
+    }
+    else if (eventID == kLoadScanlinesIntoTextureFromWorkingMemory)
+    {
+        LoadScanlinesIntoTextureFromWorkingMemory();
+    }
+    else if (eventID == kRenewTextureHandle)
+    {
+        RenewTextureHandle();
+    }
+    else if (eventID == kTerminate)
+    {
+        Terminate();
+    }
+    else if (eventID == kUploadLoadJobsIntoTextures)
+    {
+        UploadLoadJobsIntoTextures();
+    }
+    else if (eventID == kUpdateTiledPanoramas)
+    {
+        UpdateTiledPanoramas();
+    }
+}
+
+// **************************
+// Public functions
+// **************************
+
+extern "C"
+{
+
+UnityRenderingEvent GetRenderEventFunc()
+{
+    return OnRenderEvent;
+}
+
+void SetInitMaxNumTextures(int initMaxNumTextures)
+{
+    m_initMaxNumTextures = initMaxNumTextures;
+}
+
+// Must be called before Init(), once for every size class. Images that are exactly width x height in that format are uploaded into
+//  one of its numTextures pooled textures, while there's one free
+void AddTexturePoolSizeClass(int width, int height, bool rgb565On, int numTextures)
+{
+    TextureSizeClass sizeClass = { width, height, (GLenum) (rgb565On ? GL_RGB565 : GL_RGB8), numTextures };
+    m_textureSizeClasses.push_back(sizeClass);
+}
+
+// As AddTexturePoolSizeClass(), for the textures that loads compressed to ETC2 are uploaded into
+void AddEtc2TexturePoolSizeClass(int width, int height, int numTextures)
+{
+    TextureSizeClass sizeClass = { width, height, GL_COMPRESSED_RGB8_ETC2, numTextures };
+    m_textureSizeClasses.push_back(sizeClass);
+}
+
+void SetMaxPixelsUploadedPerFrame(int maxPixelsUploadedPerFrame)
+{
+    m_maxPixelsUploadedPerFrame = maxPixelsUploadedPerFrame;
+}
+
+// 0 keeps the number of pixels uploaded per frame at SetMaxPixelsUploadedPerFrame()'s, otherwise it's adapted to however many pixels
+//  can be uploaded in about this long, going by how long uploads have been taking
+void SetUploadBudgetMilliseconds(float uploadBudgetMilliseconds)
+{
+    m_uploadBudgetMilliseconds = uploadBudgetMilliseconds;
+}
+
+int GetMaxPixelsUploadedPerFrame()
+{
+    return m_maxPixelsUploadedPerFrame;
+}
+
+float GetUploadPixelsPerMillisecond()
+{
+    return m_uploadPixelsPerMillisecond;
+}
+
+void SetUseExif(bool useExif)
+{
+    m_useExif = useExif;
+}
+
+// Loads of files queued while this is on decode their EXIF thumbnail before the image itself, see UploadLoadJobIntoTextureWithPlaceholder()
+void SetUseExifPlaceholder(bool useExifPlaceholder)
+{
+    m_useExifPlaceholder = useExifPlaceholder;
+}
+
+void SetMaxImageWidth(int maxImageWidth)
+{
+    m_maxImageWidth = maxImageWidth;
+}
+
+// Takes effect from the next load created - see ResampleMode. The exact modes pick whatever width fits maxImageWidth and, unless
+//  maxImageMegabytes is 0, the memory each image's base level may take up, rather than only ever halving
+void SetResampleMode(int resampleMode, int maxImageMegabytes)
+{
+    m_resampleMode = resampleMode;
+    m_maxImageBytes = (size_t) std::max(maxImageMegabytes, 0) * 1024 * 1024;
+}
+
+void SetRGB565On(int rgb565On)
+{
+    m_rgb565On = rgb565On;
+}
+
+// Must be set before Init()
+void SetUsePixelUnpackBuffers(bool usePixelUnpackBuffers)
+{
+    m_usePixelUnpackBuffers = usePixelUnpackBuffers;
+}
+
+// Loads queued from now on build their own mip levels on the thread that decodes them, which are then uploaded a level at a time
+//  under the same per-frame budget as the rest of the image, rather than glGenerateMipmap() doing all of them in one go once it's uploaded
+void SetUseCpuMipmaps(bool useCpuMipmaps)
+{
+    m_useCpuMipmaps = useCpuMipmaps;
+}
+
+// Loads queued from now on that build their own mip levels upload them coarsest first, and can be shown as soon as
+//  GetLoadJobVisibleMipLevel() isn't -1, sharpening as it goes down to 0
+void SetUseProgressiveUpload(bool useProgressiveUpload)
+{
+    m_useProgressiveUpload = useProgressiveUpload;
+}
+
+// Takes effect from the next load created. Each load's base level is uploaded in tiles, closest to the view direction first
+void SetUseViewPriorityUpload(bool useViewPriorityUpload)
+{
+    m_useViewPriorityUpload = useViewPriorityUpload;
+}
+
+// Loads queued while this is on are compressed to ETC2 on the WorkerPool once they're decoded, mip levels included, and uploaded compressed -
+//  a quarter of the GPU memory and upload bandwidth of RGB565. Their textures come from pools added with AddEtc2TexturePoolSizeClass()
+void SetUseEtc2Compression(bool useEtc2Compression)
+{
+    m_useEtc2Compression = useEtc2Compression;
+}
+
+// Queued loads are kept in directory once they've finished, exactly as they're uploaded, until they add up to more than maxMegabytes - see
+//  DiskCache. There's no disk cache until this is called, or if directory is empty
+void SetDiskCache(char* pDirectory, int maxMegabytes)
+{
+    GetDiskCache().SetDirectory(pDirectory, (size_t) std::max(maxMegabytes, 0) * 1024 * 1024);
+}
+
+// Loads queued while this is on are also converted into cubemap faces, so they can be uploaded with UploadLoadJobIntoCubemap(). Nothing in
+//  C# turns this on yet - Unity 5.6 has no Cubemap.CreateExternalTexture() to wrap the cubemap with, so for now it's only usable natively
+void SetUseCubemaps(bool useCubemaps)
+{
+    m_useCubemaps = useCubemaps;
+}
+
+// In degrees - yaw 0 faces the middle of an equirectangular image, and pitch 90 is straight up
+void SetViewDirection(float yaw, float pitch)
+{
+    m_viewYaw = yaw;
+    m_viewPitch = pitch;
+}
+
+// Must be set before Init()
+void SetUseUploadThread(bool useUploadThread)
+{
+    m_useUploadThread = useUploadThread;
 }
 
 void SetCurrTextureIndex(int currTextureIndex)
@@ -567,53 +5767,477 @@ int GetCurrStoredImageHeight()
     return m_currImageHeight;
 }
 
+int GetNumScanlinesInWorkingMemory()
+{
+    return m_numScanlinesInWorkingMemory;
+}
+
 bool LoadIntoWorkingMemoryFromImagePath(char* pFileName)
 {
     LOGI("Calling LoadIntoWorkingMemoryFromImagePath()");
 
-    int comp = -1;
-    m_currImageWidth = m_currImageHeight = 0;
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(true);
+    pJob->filePath = pFileName;
+    bool success = RunLoadJobInWorkingMemory(pJob);
+
+    LOGI("Finished LoadIntoWorkingMemoryFromImagePath()!");
 
-    if (m_useExif)
+    return success;
+}
+
+bool LoadIntoWorkingMemoryFromImageData(void* pRawData, int dataLength)
+{
+    LOGI("Calling LoadIntoWorkingMemoryFromImageData()");
+
+    // No need to resample images coming off the cloud if we are not updating them to 565, because they are uploaded at the correct width
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(m_rgb565On);
+    pJob->pData = (stbi_uc*) pRawData;
+    pJob->dataLength = dataLength;
+    bool success = RunLoadJobInWorkingMemory(pJob);
+
+    LOGI("Finished LoadIntoWorkingMemoryFromImageData()!");
+
+    return success;
+}
+
+// Since loads into working memory publish their scanlines as they go, these are now the same as the above: the texture can be
+//  created as soon as GetNumScanlinesInWorkingMemory() is non-zero, and scanlines are then uploaded while the rest are still being decoded
+bool StreamIntoWorkingMemoryFromImagePath(char* pFileName)
+{
+    return LoadIntoWorkingMemoryFromImagePath(pFileName);
+}
+
+bool StreamIntoWorkingMemoryFromImageData(void* pRawData, int dataLength)
+{
+    return LoadIntoWorkingMemoryFromImageData(pRawData, dataLength);
+}
+
+// Queued loads are decoded on the LoadJobPool's threads, highest priority first, with the settings current at the time they were queued.
+//  Once one is running (or done) MoveLoadJobIntoWorkingMemory() makes it the image that gets uploaded. Every job has to be released,
+//  which also cancels it if it hasn't finished. Image data passed in has to stay valid until the job is no longer queued or running
+int QueueLoadFromImagePath(char* pFileName, int priority)
+{
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(true);
+    pJob->filePath = pFileName;
+    const std::string kFileIdentity = CalcFileIdentity(pFileName);
+    if (!kFileIdentity.empty())
     {
-        auto jpeg = FindExifJpeg(pFileName);
-        std::ofstream("tempExif.jpg", std::ios::binary).write(jpeg.data(), jpeg.size());
-        pFileName = (char*) "tempExif.jpg";
-        //m_pCurrImage = reinterpret_cast<stbi_uc*>(jpeg.data());
+        SetLoadJobCacheKey(*pJob, kFileIdentity);
     }
+    return GetLoadJobPool().Queue(pJob, priority);
+}
+
+int QueueLoadFromImageData(void* pRawData, int dataLength, int priority)
+{
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(m_rgb565On);
+    pJob->pData = (stbi_uc*) pRawData;
+    pJob->dataLength = dataLength;
+    return GetLoadJobPool().Queue(pJob, priority);
+}
+
+// As QueueLoadFromImageData(), with the load being written to the disk cache under cacheKey - which has to identify the data exactly, such as
+//  the ID of the post it belongs to - once it's finished
+int QueueLoadFromImageDataWithCacheKey(void* pRawData, int dataLength, int priority, char* pCacheKey)
+{
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(m_rgb565On);
+    pJob->pData = (stbi_uc*) pRawData;
+    pJob->dataLength = dataLength;
+    SetLoadJobCacheKey(*pJob, pCacheKey);
+    return GetLoadJobPool().Queue(pJob, priority);
+}
 
-    m_pCurrImage = stbi_load(pFileName, &m_currImageWidth, &m_currImageHeight, &comp, kNumStbChannels);
-    if (!m_useExif)
+// Queues a load of whatever QueueLoadFromImageDataWithCacheKey() wrote to the disk cache under cacheKey with the current settings, without
+//  needing its data at all. Returns 0, without queuing anything, if there's no such entry
+int QueueLoadFromDiskCache(char* pCacheKey, int priority)
+{
+    std::shared_ptr<LoadJob> pJob = CreateLoadJob(m_rgb565On);
+    SetLoadJobCacheKey(*pJob, pCacheKey);
+    if (pJob->cachePath.empty() || !GetDiskCache().Contains(pJob->cachePath))
     {
-        ReampleImageToMaxWidthAndNewType();
+        return 0;
     }
+    return GetLoadJobPool().Queue(pJob, priority);
+}
 
-    LOGI("Image Loaded has Width = %d, Height = %d, Comp = %d\n", m_currImageWidth, m_currImageHeight, comp);
+// As the above, for KTX files of block-compressed mip levels, which are mapped into memory and uploaded as they are rather than decoded - so they
+//  ignore the max image width and every other setting. KTX data is copied, so only has to stay valid until the job is no longer queued or running
+int QueueLoadFromKtxPath(char* pFileName, int priority)
+{
+    std::shared_ptr<LoadJob> pJob = CreateKtxLoadJob();
+    pJob->filePath = pFileName;
+    return GetLoadJobPool().Queue(pJob, priority);
+}
 
-    LOGI("Finished LoadIntoWorkingMemoryFromImagePath()!");
+int QueueLoadFromKtxData(void* pRawData, int dataLength, int priority)
+{
+    std::shared_ptr<LoadJob> pJob = CreateKtxLoadJob();
+    pJob->pData = (stbi_uc*) pRawData;
+    pJob->dataLength = dataLength;
+    return GetLoadJobPool().Queue(pJob, priority);
+}
 
-    return (m_currImageWidth * m_currImageHeight) > 0;
+// Queues a load of the image's thumbnail from the gallery index, which never touches the image itself. Returns 0, without queuing anything,
+//  if the index hasn't got one for it
+int QueueLoadFromGalleryThumbnail(char* pFileName, int priority)
+{
+    std::shared_ptr<LoadJob> pJob = CreateGalleryThumbnailLoadJob();
+    pJob->filePath = pFileName;
+    if (!GetGalleryIndex().HasThumbnail(pJob->filePath))
+    {
+        return 0;
+    }
+    return GetLoadJobPool().Queue(pJob, priority);
 }
 
-bool LoadIntoWorkingMemoryFromImageData(void* pRawData, int dataLength)
+void SetLoadJobPriority(int loadJobId, int priority)
 {
-    LOGI("Calling LoadIntoWorkingMemoryFromImageData()");
+    GetLoadJobPool().SetPriority(loadJobId, priority);
+}
 
-    int comp = -1;
-    m_currImageWidth = m_currImageHeight = 0;
+// Released jobs are reported as cancelled, including ones that are still running until they reach their next band - use
+//  IsLoadJobRunning() to know when those have stopped
+int GetLoadJobState(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    return (pJob && !pJob->isCancelled) ? pJob->state.load() : kLoadJobCancelled;
+}
 
-    m_pCurrImage = stbi_load_from_memory((stbi_uc*) pRawData, dataLength, &m_currImageWidth, &m_currImageHeight, &comp, kNumStbChannels);
+// Whether the job's still being decoded, cancelled or not - image data it was queued with has to be kept alive until it isn't
+bool IsLoadJobRunning(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    return pJob && pJob->state == kLoadJobRunning;
+}
 
-    if (m_rgb565On) // No need to resample images coming off the cloud if we are not updating them to 565, because they are uploaded at the correct width
+bool MoveLoadJobIntoWorkingMemory(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob)
     {
-        ReampleImageToMaxWidthAndNewType();
+        return false;
     }
 
-    LOGI("Image Loaded has Width = %d, Height = %d, Comp = %d\n", m_currImageWidth, m_currImageHeight, comp);
+    MoveIntoWorkingMemory(pJob);
+    return true;
+}
 
-    LOGI("Finished LoadIntoWorkingMemoryFromImageData()!");
+void ReleaseLoadJob(int loadJobId)
+{
+    GetLoadJobPool().Release(loadJobId);
+}
+
+void ReleaseAllLoadJobs()
+{
+    GetLoadJobPool().ReleaseAll();
+}
+
+// C# passes -1 when it has no texture free, which mustn't get as far as m_textureIDs
+bool IsValidTextureIndex(int textureIndex)
+{
+    if (textureIndex < 0 || textureIndex >= m_initMaxNumTextures)
+    {
+        LOGI("Texture index %d is out of range, there are %d textures", textureIndex, m_initMaxNumTextures);
+        return false;
+    }
+    return true;
+}
+
+// Each load has its own pixels, size, format and upload progress, so any number of them can be uploading at once - their scanlines are
+//  uploaded into their own texture as they're decoded, taking turns every time kUploadLoadJobsIntoTextures is issued. Releasing a job stops its upload
+bool UploadLoadJobIntoTexture(int loadJobId, int textureIndex)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob || pJob->isUploading || !IsValidTextureIndex(textureIndex))
+    {
+        return false;
+    }
+
+    StartUploadingLoadJob(pJob, textureIndex, false, -1);
+    return true;
+}
+
+// As UploadLoadJobIntoTexture(), with the load's EXIF thumbnail also uploaded into placeholderTextureIndex as soon as it's been decoded - so it
+//  must have been queued while SetUseExifPlaceholder() was on. GetLoadJobPhase() says which of the two can be shown. Loads without an EXIF
+//  thumbnail, or that were loaded from the disk cache, go straight from showing nothing to showing the image
+bool UploadLoadJobIntoTextureWithPlaceholder(int loadJobId, int textureIndex, int placeholderTextureIndex)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob || pJob->isUploading || !IsValidTextureIndex(textureIndex) || (placeholderTextureIndex != -1 && !IsValidTextureIndex(placeholderTextureIndex)))
+    {
+        return false;
+    }
+
+    StartUploadingLoadJob(pJob, textureIndex, false, placeholderTextureIndex);
+    return true;
+}
+
+// As UploadLoadJobIntoTexture(), but the load's texture becomes a GL_TEXTURE_CUBE_MAP of its cubemap faces - so it must have been queued
+//  while SetUseCubemaps() was on. Nothing's uploaded until it has finished decoding and converting
+bool UploadLoadJobIntoCubemap(int loadJobId, int textureIndex)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob || pJob->isUploading || !pJob->useCubemap || !IsValidTextureIndex(textureIndex))
+    {
+        return false;
+    }
+
+    StartUploadingLoadJob(pJob, textureIndex, true, -1);
+    return true;
+}
+
+// The width and height of each of the load's cubemap faces, or 0 until they've been built
+int GetLoadJobCubemapFaceSize(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(pJob->mutex);
+    return pJob->cubemapFaceSize;
+}
+
+bool IsLoadJobUploading(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    return pJob && pJob->isUploading;
+}
+
+int GetLoadJobVisibleMipLevel(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    return pJob ? pJob->visibleMipLevel.load() : -1;
+}
+
+// One of LoadJobPhase - a placeholder only stops being visible once the image is, and only loads uploaded with one ever have one
+int GetLoadJobPhase(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob)
+    {
+        return kLoadJobNothingVisible;
+    }
+    return pJob->visibleMipLevel >= 0 ? kLoadJobImageVisible : (pJob->isPlaceholderVisible ? kLoadJobPlaceholderVisible : kLoadJobNothingVisible);
+}
+
+// The placeholder's RGB565 texture, and its size - only valid once GetLoadJobPhase() has reported it as visible
+void* GetLoadJobPlaceholderTexturePtr(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    return (pJob && pJob->isPlaceholderVisible) ? (void*)(intptr_t)(m_textureIDs[pJob->placeholderTextureIndex]) : NULL;
+}
+
+int GetLoadJobPlaceholderWidth(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(pJob->mutex);
+    return pJob->placeholderWidth;
+}
+
+int GetLoadJobPlaceholderHeight(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(pJob->mutex);
+    return pJob->placeholderHeight;
+}
+
+// In milliseconds from the load being created until its texture could first be shown, or -1 if it can't be yet
+float GetLoadJobTimeToFirstVisiblePixel(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    return pJob ? pJob->timeToFirstVisiblePixel.load() : -1.0f;
+}
+
+int GetLoadJobImageWidth(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(pJob->mutex);
+    return pJob->width;
+}
+
+int GetLoadJobImageHeight(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(pJob->mutex);
+    return pJob->height;
+}
+
+// The compressed format the load's texture is in, or 0 if it isn't compressed
+int GetLoadJobCompressedFormat(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    if (!pJob || !(pJob->useEtc2 || pJob->isKtx))
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(pJob->mutex);
+    return (int) pJob->compressedFormat.internalFormat;
+}
+
+void* GetLoadJobTexturePtr(int loadJobId)
+{
+    std::shared_ptr<LoadJob> pJob = GetLoadJobPool().Find(loadJobId);
+    return pJob ? (void*)(intptr_t)(m_textureIDs[pJob->textureIndex]) : NULL;
+}
+
+// Must be called before Init(). Every tiled panorama shares numTextures tileSize x tileSize textures for their tiles in view
+void SetPanoramaTileTextures(int tileSize, int numTextures, bool rgb565On)
+{
+    m_panoramaTileSize = tileSize;
+    m_numPanoramaTileTextures = numTextures;
+    m_panoramaTilesRGB565On = rgb565On;
+}
+
+// Tiled panoramas show JPEGs wider than the current max image width at full resolution, wherever they're looked at - see TiledPanorama.
+//  They're only ever as big as their tiles in view, so the ordinary load of the same image needs showing behind them. Every one has to be released.
+//  Only the file's header is read here, and anything its ordinary load already shows at full resolution gets no panorama or decoder thread at
+//  all - 0 is returned instead
+int CreateTiledPanoramaFromImagePath(char* pFileName)
+{
+    int width = 0, height = 0, comp = -1;
+    if (!IsJpegFile(pFileName) || !stbi_info(pFileName, &width, &height, &comp) || width <= m_maxImageWidth)
+    {
+        LOGI("No TiledPanorama for %s, which is %d wide - only JPEGs wider than %d are tiled", pFileName, width, m_maxImageWidth);
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_tiledPanoramasMutex);
+    const int kId = m_nextTiledPanoramaId++;
+    m_tiledPanoramas[kId] = std::make_shared<TiledPanorama>(kId, pFileName, m_maxImageWidth);
+    return kId;
+}
+
+void ReleaseTiledPanorama(int tiledPanoramaId)
+{
+    std::shared_ptr<TiledPanorama> pTiledPanorama;
+    {
+        std::lock_guard<std::mutex> lock(m_tiledPanoramasMutex);
+        auto it = m_tiledPanoramas.find(tiledPanoramaId);
+        if (it != m_tiledPanoramas.end())
+        {
+            pTiledPanorama = it->second;
+            m_tiledPanoramas.erase(it);
+        }
+    }
+    // Its decoder is stopped outside the lock
+}
+
+// In degrees, relative to the panorama as for SetViewDirection() - which tiles get decoded and uploaded follows this on each kUpdateTiledPanoramas
+void SetTiledPanoramaViewDirection(int tiledPanoramaId, float yaw, float pitch)
+{
+    std::shared_ptr<TiledPanorama> pTiledPanorama = FindTiledPanorama(tiledPanoramaId);
+    if (pTiledPanorama)
+    {
+        pTiledPanorama->SetViewDirection(yaw, pitch);
+    }
+}
+
+int GetTiledPanoramaWidth(int tiledPanoramaId)
+{
+    std::shared_ptr<TiledPanorama> pTiledPanorama = FindTiledPanorama(tiledPanoramaId);
+    return pTiledPanorama ? pTiledPanorama->GetWidth() : 0;
+}
+
+int GetTiledPanoramaHeight(int tiledPanoramaId)
+{
+    std::shared_ptr<TiledPanorama> pTiledPanorama = FindTiledPanorama(tiledPanoramaId);
+    return pTiledPanorama ? pTiledPanorama->GetHeight() : 0;
+}
+
+// 0 until the image's header has been read, and for good if it can't be tiled
+int GetTiledPanoramaNumColumns(int tiledPanoramaId)
+{
+    std::shared_ptr<TiledPanorama> pTiledPanorama = FindTiledPanorama(tiledPanoramaId);
+    return pTiledPanorama ? pTiledPanorama->GetNumColumns() : 0;
+}
+
+int GetTiledPanoramaNumRows(int tiledPanoramaId)
+{
+    std::shared_ptr<TiledPanorama> pTiledPanorama = FindTiledPanorama(tiledPanoramaId);
+    return pTiledPanorama ? pTiledPanorama->GetNumRows() : 0;
+}
+
+// NULL unless the tile is resident. Its top left is at the texture's origin, and tiles along the right and bottom edges don't fill it
+void* GetTiledPanoramaTileTexturePtr(int tiledPanoramaId, int column, int row)
+{
+    std::shared_ptr<TiledPanorama> pTiledPanorama = FindTiledPanorama(tiledPanoramaId);
+    return pTiledPanorama ? (void*)(intptr_t)(pTiledPanorama->GetTileTexture(column, row)) : NULL;
+}
+
+// Indexes every image under directory into the gallery index at indexPath, making thumbnails at most thumbnailWidth wide of those that are 2:1.
+//  Only images that are new or have changed since the index was last written are read, across every core. Blocks until it's done, so call it
+//  off the main thread. Returns how many images there are, newest first, or -1 if the directory can't be read
+int IndexGalleryImages(char* pDirectory, char* pIndexPath, int thumbnailWidth)
+{
+    return GetGalleryIndex().Scan(pDirectory, pIndexPath, thumbnailWidth);
+}
+
+int GetNumGalleryImages()
+{
+    return GetGalleryIndex().GetNumImages();
+}
+
+// Copies the image's path into pPath, returning its length - or 0 if it doesn't fit in capacity bytes, including the terminator
+int GetGalleryImagePath(int index, char* pPath, int capacity)
+{
+    GalleryIndexEntry entry = {};
+    std::string path;
+    if (!GetGalleryIndex().GetImage(index, entry, path) || (int) path.size() >= capacity)
+    {
+        return 0;
+    }
+    memcpy(pPath, path.c_str(), path.size() + 1);
+    return (int) path.size();
+}
+
+// Returns -1 if the image isn't in the gallery index
+int FindGalleryImage(char* pFileName)
+{
+    return GetGalleryIndex().Find(pFileName);
+}
+
+// These are all 0 for images whose header couldn't be read
+int GetGalleryImageWidth(int index)
+{
+    GalleryIndexEntry entry = {};
+    std::string path;
+    return GetGalleryIndex().GetImage(index, entry, path) ? entry.width : 0;
+}
 
-    return (m_currImageWidth * m_currImageHeight) > 0;
+int GetGalleryImageHeight(int index)
+{
+    GalleryIndexEntry entry = {};
+    std::string path;
+    return GetGalleryIndex().GetImage(index, entry, path) ? entry.height : 0;
+}
+
+float GetGalleryImageAspectRatio(int index)
+{
+    GalleryIndexEntry entry = {};
+    std::string path;
+    return GetGalleryIndex().GetImage(index, entry, path) ? entry.aspectRatio : 0.0f;
 }
 
 jstring Java_com_soul_cppplugin_MainActivity_stringFromJNI(JNIEnv *env, jobject /* this */)
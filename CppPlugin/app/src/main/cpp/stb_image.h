@@ -510,6 +510,57 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// JPEG decode options (VReel extension), used by the _with_options loaders.
+//
+//    scale_shift    decode at 1/(1<<scale_shift) of the stored size (0..3) by
+//                   running a reduced IDCT on every 8x8 block (DC-only for
+//                   1/8), so the full size image is never allocated. Output
+//                   dimensions round up, e.g. a 33 pixel wide image decodes
+//                   to 5 pixels at scale_shift 3. Ignored for other formats
+//    rgb565         return packed 16-bit RGB565 pixels (2 bytes each, native
+//                   endian) and ignore desired_channels. JPEGs are upsampled,
+//                   colour converted and packed in a single pass; other
+//                   formats are converted after decoding
+//    parallel_for   optional; must call task(arg, i) for every 0 <= i < count,
+//                   on any threads, and only return once they have all
+//                   finished. Baseline JPEGs with restart markers that are
+//                   decoded from memory then have their restart intervals
+//                   entropy decoded in parallel. Otherwise entropy decoding
+//                   stays serial, but each MCU row's IDCT overlaps with the
+//                   decoding of the next, and progressive JPEGs' final IDCT,
+//                   upsampling and colour conversion are split into tasks
+typedef struct
+{
+   int scale_shift;
+   int rgb565;
+   void (*parallel_for)(void *context, int count, void (*task)(void *arg, int i), void *arg);
+   void *parallel_context;
+} stbi_jpeg_options;
+
+STBIDEF stbi_uc *stbi_load_with_options            (char    const *filename,          int *x, int *y, int *channels_in_file, int desired_channels, stbi_jpeg_options const *options);
+STBIDEF stbi_uc *stbi_load_from_memory_with_options(stbi_uc const *buffer, int len,   int *x, int *y, int *channels_in_file, int desired_channels, stbi_jpeg_options const *options);
+
+// Streaming JPEG decode (VReel extension). Rather than returning the whole
+// image, hands it to 'callback' in bands of rows, top to bottom, as soon as
+// each band is finished. Baseline JPEGs coded in a single scan are colour
+// converted while they decode, keeping only a few MCU rows of the component
+// planes in memory; progressive and multi-scan JPEGs are decoded in full
+// first. Bands are one MCU row high (8 or 16 rows before scale_shift) and
+// the pixels are only valid during the callback. Vertical flipping is not
+// applied. Returns 0 on failure, or if the callback returned 0 to cancel.
+typedef struct
+{
+   int width, height;      // size of the whole image being streamed
+   int y, num_rows;        // rows covered by this band
+   int stride;             // bytes from one row to the next in 'pixels'
+   int bytes_per_pixel;    // desired_channels, or 2 for rgb565
+   stbi_uc const *pixels;
+} stbi_jpeg_band;
+
+typedef int (*stbi_jpeg_band_callback)(void *user, stbi_jpeg_band const *band);
+
+STBIDEF int stbi_jpeg_stream_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, stbi_jpeg_options const *options, stbi_jpeg_band_callback callback, void *user);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -768,6 +819,8 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   stbi_jpeg_options const *jpeg_options; // NULL unless loaded through a _with_options function
 } stbi__context;
 
 
@@ -780,6 +833,7 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
    s->read_from_callbacks = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
+   s->jpeg_options = NULL;
 }
 
 // initialize a callback-based context
@@ -789,6 +843,7 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->io_user_data = user;
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
+   s->jpeg_options = NULL;
    s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
@@ -847,11 +902,13 @@ typedef struct
    int bits_per_channel;
    int num_channels;
    int channel_order;
+   int rgb565; // the loader already packed its output to RGB565
 } stbi__result_info;
 
 #ifndef STBI_NO_JPEG
 static int      stbi__jpeg_test(stbi__context *s);
 static void    *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri);
+static int      stbi__jpeg_stream_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi_jpeg_band_callback callback, void *user);
 static int      stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
@@ -903,8 +960,18 @@ static void    *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pnm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
-// this is not threadsafe
-static const char *stbi__g_failure_reason;
+// each thread has its own, so restart intervals that fail while being decoded
+// in parallel don't race to set it
+#if defined(__cplusplus) && __cplusplus >= 201103L
+#define STBI__THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define STBI__THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define STBI__THREAD_LOCAL __thread
+#else
+#define STBI__THREAD_LOCAL
+#endif
+static STBI__THREAD_LOCAL const char *stbi__g_failure_reason;
 
 STBIDEF const char *stbi_failure_reason(void)
 {
@@ -1105,10 +1172,30 @@ static stbi__uint16 *stbi__convert_8_to_16(stbi_uc *orig, int w, int h, int chan
    return enlarged;
 }
 
+static stbi_uc *stbi__convert_rgb_to_rgb565(stbi_uc *orig, int w, int h)
+{
+   int i;
+   int img_len = w * h;
+   stbi__uint16 *packed;
+
+   packed = (stbi__uint16 *) stbi__malloc_mad2(img_len, 2, 0);
+   if (packed == NULL) { STBI_FREE(orig); return stbi__errpuc("outofmem", "Out of memory"); }
+
+   for (i = 0; i < img_len; ++i)
+      packed[i] = (stbi__uint16) (((orig[i*3+0] >> 3) << 11) | ((orig[i*3+1] >> 2) << 5) | (orig[i*3+2] >> 3));
+
+   STBI_FREE(orig);
+   return (stbi_uc *) packed;
+}
+
 static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
-   void *result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+   void *result;
+   int rgb565 = s->jpeg_options && s->jpeg_options->rgb565;
+
+   if (rgb565) req_comp = 3; // anything the JPEG decoder doesn't pack itself is packed from RGB below
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
 
    if (result == NULL)
       return NULL;
@@ -1121,9 +1208,15 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
 
    // @TODO: move stbi__convert_format to here
 
+   if (rgb565 && !ri.rgb565) {
+      result = stbi__convert_rgb_to_rgb565((stbi_uc *) result, *x, *y);
+      if (result == NULL)
+         return NULL;
+   }
+
    if (stbi__vertically_flip_on_load) {
       int w = *x, h = *y;
-      int channels = req_comp ? req_comp : *comp;
+      int channels = rgb565 ? 2 : (req_comp ? req_comp : *comp);
       int row,col,z;
       stbi_uc *image = (stbi_uc *) result;
 
@@ -1281,6 +1374,40 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF stbi_uc *stbi_load_from_memory_with_options(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, stbi_jpeg_options const *options)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   s.jpeg_options = options;
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_jpeg_stream_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, stbi_jpeg_options const *options, stbi_jpeg_band_callback callback, void *user)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   s.jpeg_options = options;
+   #ifndef STBI_NO_JPEG
+   if (stbi__jpeg_test(&s)) return stbi__jpeg_stream_load(&s,x,y,comp,req_comp,callback,user);
+   #endif
+   return stbi__err("not JPEG", "Image not of any known type, or corrupt");
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_with_options(char const *filename, int *x, int *y, int *comp, int req_comp, stbi_jpeg_options const *options)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   s.jpeg_options = options;
+   result = stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+#endif
+
 #ifndef STBI_NO_LINEAR
 static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
@@ -1750,7 +1877,6 @@ typedef struct
       int x,y,w2,h2;
       stbi_uc *data;
       void *raw_data, *raw_coeff;
-      stbi_uc *linebuf;
       short   *coeff;   // progressive only
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
    } img_comp[4];
@@ -1771,9 +1897,16 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+   int scale_shift; // each 8x8 block is reconstructed as (8>>scale_shift)^2 pixels
+   int rgb565;      // output packed RGB565 instead of req_comp channels
+   int ring_mcu_rows; // if non-zero, the planes only hold this many MCU rows (streaming)
+   void (*parallel_for)(void *context, int count, void (*task)(void *arg, int i), void *arg);
+   void *parallel_context;
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
+   void (*YCbCr_to_RGB565_kernel)(stbi__uint16 *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
 
@@ -2284,6 +2417,79 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced-size IDCTs for DCT-domain downscaling. each output pixel is the
+// average of the 8/N x 8/N pixels the full IDCT would have produced, which
+// folds down to an N-point IDCT whose basis functions are the box-filtered
+// 8-point ones:
+//
+//    stbi__idct_NxN_k[x][u] = 0.5 * C(u) * mean_{n in box x} cos((2n+1)*u*pi/16)
+//
+// so this matches (up to rounding) decoding at full size and then box
+// filtering, without ever producing the full size pixels.
+static const int stbi__idct_4x4_k[4][8] =
+{
+   { stbi__f2f(0.353553391f), stbi__f2f( 0.453063723f), stbi__f2f( 0.326640741f), stbi__f2f( 0.159094823f), 0, stbi__f2f(-0.106303762f), stbi__f2f(-0.135299025f), stbi__f2f(-0.090119978f) },
+   { stbi__f2f(0.353553391f), stbi__f2f( 0.187665139f), stbi__f2f(-0.326640741f), stbi__f2f(-0.384088878f), 0, stbi__f2f( 0.256639984f), stbi__f2f( 0.135299025f), stbi__f2f(-0.037328917f) },
+   { stbi__f2f(0.353553391f), stbi__f2f(-0.187665139f), stbi__f2f(-0.326640741f), stbi__f2f( 0.384088878f), 0, stbi__f2f(-0.256639984f), stbi__f2f( 0.135299025f), stbi__f2f( 0.037328917f) },
+   { stbi__f2f(0.353553391f), stbi__f2f(-0.453063723f), stbi__f2f( 0.326640741f), stbi__f2f(-0.159094823f), 0, stbi__f2f( 0.106303762f), stbi__f2f(-0.135299025f), stbi__f2f( 0.090119978f) },
+};
+
+static const int stbi__idct_2x2_k[2][8] =
+{
+   { stbi__f2f(0.353553391f), stbi__f2f( 0.320364431f), 0, stbi__f2f(-0.112497028f), 0, stbi__f2f( 0.075168111f), 0, stbi__f2f(-0.063724447f) },
+   { stbi__f2f(0.353553391f), stbi__f2f(-0.320364431f), 0, stbi__f2f( 0.112497028f), 0, stbi__f2f(-0.075168111f), 0, stbi__f2f( 0.063724447f) },
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], int n, const int k[][8])
+{
+   int i,j,u,val[4*8];
+   short *d = data;
+
+   // columns: same scaling as stbi__idct_block, keep 2 extra bits of precision
+   for (u=0; u < 8; ++u, ++d) {
+      // all-zero columns are the common case for the high frequencies
+      if (d[ 0]==0 && d[ 8]==0 && d[16]==0 && d[24]==0
+           && d[32]==0 && d[40]==0 && d[48]==0 && d[56]==0) {
+         for (i=0; i < n; ++i)
+            val[i*8+u] = 0;
+         continue;
+      }
+      for (i=0; i < n; ++i) {
+         int sum = 0;
+         for (j=0; j < 8; ++j)
+            sum += d[j*8] * k[i][j];
+         val[i*8+u] = (sum + 512) >> 10;
+      }
+   }
+
+   // rows: remove the remaining 1<<14, round and bias to 0..255
+   for (i=0; i < n; ++i, out += out_stride) {
+      for (j=0; j < n; ++j) {
+         int sum = (1 << 13) + (128 << 14);
+         for (u=0; u < 8; ++u)
+            sum += val[i*8+u] * k[j][u];
+         out[j] = stbi__clamp(sum >> 14);
+      }
+   }
+}
+
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, 4, stbi__idct_4x4_k);
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, 2, stbi__idct_2x2_k);
+}
+
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   // DC only; the full IDCT gives every pixel dc/8 (rounded) + 128
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2707,67 +2913,330 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// row r of a component plane; when streaming, the plane is a ring buffer of
+// whole MCU rows so the row has to be wrapped around
+static stbi_uc *stbi__jpeg_plane_row(stbi__jpeg *z, int n, int r)
+{
+   if (z->ring_mcu_rows) {
+      int mcu_rows = (z->img_comp[n].v * 8) >> z->scale_shift; // plane rows per MCU row
+      r = (r / mcu_rows) % z->ring_mcu_rows * mcu_rows + r % mcu_rows;
+   }
+   return z->img_comp[n].data + z->img_comp[n].w2 * r;
+}
+
+// number of 8x8 blocks in each MCU of a baseline scan; for single-component
+// scans every block is an MCU
+static int stbi__jpeg_mcu_blocks(stbi__jpeg *z)
+{
+   int k, n = 0;
+   if (z->scan_n == 1) return 1;
+   for (k=0; k < z->scan_n; ++k)
+      n += z->img_comp[z->order[k]].h * z->img_comp[z->order[k]].v;
+   return n;
+}
+
+// most blocks an MCU can have: 3 components of up to 4x4 blocks each
+#define STBI__JPEG_MAX_MCU_BLOCKS  48
+
+// entropy decode the next MCU of a baseline scan into 'blocks', 64
+// dequantized coefficients per block in the order they were coded
+static int stbi__jpeg_decode_mcu_blocks(stbi__jpeg *z, short *blocks)
+{
+   int k,b;
+   // scan an interleaved mcu... process scan_n components in order
+   for (k=0; k < z->scan_n; ++k) {
+      int n = z->order[k];
+      int ha = z->img_comp[n].ha;
+      // scan out an mcu's worth of this component; that's just determined
+      // by the basic H and V specified for the component
+      int count = z->scan_n == 1 ? 1 : z->img_comp[n].h * z->img_comp[n].v;
+      for (b=0; b < count; ++b, blocks += 64)
+         if (!stbi__jpeg_decode_block(z, blocks, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+   }
+   return 1;
+}
+
+// inverse transform the blocks of the MCU at column i of row j into the
+// component planes. only reads the decoder state, so separate MCUs can be
+// done on separate threads
+static void stbi__jpeg_idct_mcu(stbi__jpeg *z, int i, int j, short *blocks)
+{
+   int bs = 8 >> z->scale_shift;
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      z->idct_block_kernel(stbi__jpeg_plane_row(z, n, j*bs)+i*bs, z->img_comp[n].w2, blocks);
+   } else { // interleaved
+      int k,x,y;
+      for (k=0; k < z->scan_n; ++k) {
+         int n = z->order[k];
+         stbi_uc *row = stbi__jpeg_plane_row(z, n, j*z->img_comp[n].v*bs);
+         for (y=0; y < z->img_comp[n].v; ++y) {
+            for (x=0; x < z->img_comp[n].h; ++x, blocks += 64) {
+               int x2 = (i*z->img_comp[n].h + x)*bs;
+               int y2 = y*bs;
+               z->idct_block_kernel(row+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, blocks);
+            }
+         }
+      }
+   }
+}
+
+// decode the MCU at column i of row j of a baseline scan
+static int stbi__jpeg_decode_mcu(stbi__jpeg *z, int i, int j)
+{
+   STBI_SIMD_ALIGN(short, data[STBI__JPEG_MAX_MCU_BLOCKS*64]);
+   if (!stbi__jpeg_decode_mcu_blocks(z, data)) return 0;
+   stbi__jpeg_idct_mcu(z, i, j, data);
+   return 1;
+}
+
+// number of MCUs in each row of a baseline scan, and number of rows. a
+// single-component scan's blocks just depend on how many actual "pixels"
+// the component has, independent of interleaved MCU blocking and such
+static void stbi__jpeg_scan_mcus(stbi__jpeg *z, int *w, int *h)
+{
+   if (z->scan_n == 1) {
+      *w = (z->img_comp[z->order[0]].x+7) >> 3;
+      *h = (z->img_comp[z->order[0]].y+7) >> 3;
+   } else {
+      *w = z->img_mcu_x;
+      *h = z->img_mcu_y;
+   }
+}
+
+// decode row j of a baseline scan. with 'coeff' the row is only entropy
+// decoded, leaving each MCU's blocks there for stbi__jpeg_idct_mcu(). returns
+// 0 on error, or -1 if the scan ended early because a restart marker was missing
+static int stbi__jpeg_decode_mcu_row(stbi__jpeg *z, int j, short *coeff)
+{
+   int i,w,h, n = stbi__jpeg_mcu_blocks(z);
+   stbi__jpeg_scan_mcus(z, &w, &h);
+   for (i=0; i < w; ++i) {
+      if (coeff) {
+         if (!stbi__jpeg_decode_mcu_blocks(z, coeff + i*n*64)) return 0;
+      } else {
+         if (!stbi__jpeg_decode_mcu(z, i, j)) return 0;
+      }
+      // after every MCU, count down the restart interval
+      if (--z->todo <= 0) {
+         if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+         // if it's NOT a restart, then just bail, so we get corrupt data
+         // rather than no data
+         if (!STBI__RESTART(z->marker)) return -1;
+         stbi__jpeg_reset(z);
+      }
+   }
+   return 1;
+}
+
+#define STBI__JPEG_RESTART_TASKS  64
+
+// restart markers reset the entropy decoder, so the intervals between them
+// can be decoded independently, each with its own copy of the decoder state.
+// each task only ever writes its own failed flag, so the tasks don't race on
+// them; they're combined once parallel_for has returned
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc **interval;   // where each restart interval's entropy-coded data starts
+   int num_intervals;
+   int num_tasks;
+   int failed[STBI__JPEG_RESTART_TASKS];
+} stbi__jpeg_restarts;
+
+static void stbi__jpeg_decode_restarts_task(void *arg, int task)
+{
+   stbi__jpeg_restarts *r = (stbi__jpeg_restarts *) arg;
+   int first = r->num_intervals * task / r->num_tasks;
+   int last = r->num_intervals * (task+1) / r->num_tasks;
+   int k, m, w, h;
+   stbi__context s = *r->z->s;
+   stbi__jpeg *z = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!z) { r->failed[task] = 1; return; }
+   *z = *r->z;
+   z->s = &s;
+   stbi__jpeg_scan_mcus(z, &w, &h);
+   for (k=first; k < last && !r->failed[task]; ++k) {
+      int end = (k+1) * z->restart_interval;
+      if (end > w*h) end = w*h;
+      s.img_buffer = r->interval[k];
+      stbi__jpeg_reset(z);
+      for (m = k * z->restart_interval; m < end; ++m) {
+         if (!stbi__jpeg_decode_mcu(z, m % w, m / w)) { r->failed[task] = 1; break; }
+      }
+   }
+   STBI_FREE(z);
+}
+
+// decode a baseline scan with restart markers using parallel_for. returns -1
+// if the markers aren't all where they should be, in which case nothing has
+// been decoded or consumed and it's up to the serial decoder
+static int stbi__jpeg_decode_restarts_parallel(stbi__jpeg *z)
+{
+   stbi__jpeg_restarts r;
+   stbi_uc *p = z->s->img_buffer, *end = z->s->img_buffer_end;
+   int w, h, expected, k, failed = 0;
+
+   stbi__jpeg_scan_mcus(z, &w, &h);
+   expected = (w*h + z->restart_interval-1) / z->restart_interval;
+   r.interval = (stbi_uc **) stbi__malloc_mad2(expected, sizeof(stbi_uc *), 0);
+   if (!r.interval) return -1;
+
+   // find the start of every interval: RST0..RST7 in sequence, skipping the
+   // stuffed 0 after any 0xff in the data, up to the marker that ends the scan
+   r.interval[0] = p;
+   r.num_intervals = 1;
+   while ((p = (stbi_uc *) memchr(p, 0xff, end - p)) != NULL && p+1 < end) {
+      if (p[1] == 0) {
+         p += 2;
+      } else if (STBI__RESTART(p[1]) && p[1] == 0xd0 + ((r.num_intervals-1) & 7) && r.num_intervals < expected) {
+         p += 2;
+         r.interval[r.num_intervals++] = p;
+      } else
+         break;
+   }
+   if (p == NULL || p+1 >= end || r.num_intervals != expected) {
+      STBI_FREE(r.interval);
+      return -1;
+   }
+   // a restart marker straight after the last interval is swallowed by the
+   // serial decoder too
+   if (STBI__RESTART(p[1]))
+      p += 2;
+
+   r.z = z;
+   r.num_tasks = r.num_intervals < STBI__JPEG_RESTART_TASKS ? r.num_intervals : STBI__JPEG_RESTART_TASKS;
+   memset(r.failed, 0, sizeof(r.failed));
+   z->parallel_for(z->parallel_context, r.num_tasks, stbi__jpeg_decode_restarts_task, &r);
+   STBI_FREE(r.interval);
+   for (k=0; k < r.num_tasks; ++k)
+      failed |= r.failed[k];
+   if (failed) return stbi__err("bad huffman code", "Corrupt JPEG");
+
+   // carry on from the marker that ends the scan
+   z->s->img_buffer = p;
+   stbi__jpeg_reset(z);
+   return 1;
+}
+
+// how finely work is split up for parallel_for: a row of MCUs or a band of
+// output rows only a few ways, a whole image finely enough to balance across
+// however many threads there turn out to be
+#define STBI__JPEG_ROW_TASKS    4
+#define STBI__JPEG_IMAGE_TASKS  32
+
+// run task(arg, i) for every 0 <= i < count, in parallel if we can
+static void stbi__jpeg_run_tasks(stbi__jpeg *z, int count, void (*task)(void *arg, int i), void *arg)
+{
+   int i;
+   if (z->parallel_for)
+      z->parallel_for(z->parallel_context, count, task, arg);
+   else
+      for (i=0; i < count; ++i)
+         task(arg, i);
+}
+
+// without restart markers the entropy decoding has to stay serial, but the
+// inverse transforms don't. each step of the pipeline entropy decodes one MCU
+// row into coefficient blocks while other tasks inverse transform the row
+// decoded in the step before, along with any extra tasks the caller adds
+// (the streaming decoder colour converts an earlier band at the same time)
+typedef struct
+{
+   stbi__jpeg *z;
+   void *raw_coeff;
+   short *coeff[2];       // entropy decoded MCU rows, alternating between steps
+   int mcu_w, mcu_blocks;
+   int entropy_row;       // row being entropy decoded this step, or -1
+   int entropy_result;
+   int idct_row;          // row being inverse transformed this step, or -1
+   int num_extra_tasks;
+   void (*extra_task)(void *arg, int i);
+   void *extra_arg;
+} stbi__jpeg_pipeline;
+
+static void stbi__jpeg_pipeline_task(void *arg, int i)
+{
+   stbi__jpeg_pipeline *p = (stbi__jpeg_pipeline *) arg;
+   if (i == 0) {
+      if (p->entropy_row >= 0)
+         p->entropy_result = stbi__jpeg_decode_mcu_row(p->z, p->entropy_row, p->coeff[p->entropy_row & 1]);
+   } else if (i <= STBI__JPEG_ROW_TASKS) {
+      if (p->idct_row >= 0) {
+         int m = p->mcu_w * (i-1) / STBI__JPEG_ROW_TASKS;
+         int last = p->mcu_w * i / STBI__JPEG_ROW_TASKS;
+         short *blocks = p->coeff[p->idct_row & 1];
+         for (; m < last; ++m)
+            stbi__jpeg_idct_mcu(p->z, m, p->idct_row, blocks + m*p->mcu_blocks*64);
+      }
+   } else
+      p->extra_task(p->extra_arg, i-1-STBI__JPEG_ROW_TASKS);
+}
+
+static int stbi__jpeg_pipeline_init(stbi__jpeg_pipeline *p, stbi__jpeg *z)
+{
+   int h;
+   p->z = z;
+   p->mcu_blocks = stbi__jpeg_mcu_blocks(z);
+   stbi__jpeg_scan_mcus(z, &p->mcu_w, &h);
+   p->raw_coeff = stbi__malloc_mad3(p->mcu_w * 2, p->mcu_blocks, 64 * sizeof(short), 15);
+   if (!p->raw_coeff) return stbi__err("outofmem", "Out of memory");
+   // align blocks for idct using mmx/sse
+   p->coeff[0] = (short*) (((size_t) p->raw_coeff + 15) & ~15);
+   p->coeff[1] = p->coeff[0] + p->mcu_w * p->mcu_blocks * 64;
+   p->entropy_result = 1;
+   p->num_extra_tasks = 0;
+   return 1;
+}
+
+// entropy decode row 'entropy_row' while inverse transforming 'idct_row';
+// either can be -1 to skip it. returns what stbi__jpeg_decode_mcu_row() did
+static int stbi__jpeg_pipeline_step(stbi__jpeg_pipeline *p, int entropy_row, int idct_row)
+{
+   p->entropy_row = entropy_row;
+   p->idct_row = idct_row;
+   p->entropy_result = 1;
+   p->z->parallel_for(p->z->parallel_context, 1 + STBI__JPEG_ROW_TASKS + p->num_extra_tasks, stbi__jpeg_pipeline_task, p);
+   return p->entropy_result;
+}
+
+// decode a baseline scan into the full component planes with the pipeline
+static int stbi__jpeg_decode_scan_pipelined(stbi__jpeg *z)
+{
+   stbi__jpeg_pipeline p;
+   int j, r = 1, w, h;
+   if (!stbi__jpeg_pipeline_init(&p, z)) return 0;
+   stbi__jpeg_scan_mcus(z, &w, &h);
+   for (j=0; j < h; ++j) {
+      r = stbi__jpeg_pipeline_step(&p, j, j-1);
+      if (r <= 0) break;
+   }
+   // the last row entropy decoded still needs its inverse transform, even if
+   // a missing restart marker cut it short
+   if (r != 0)
+      stbi__jpeg_pipeline_step(&p, -1, j < h ? j : h-1);
+   STBI_FREE(p.raw_coeff);
+   return r != 0;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
    if (!z->progressive) {
-      if (z->scan_n == 1) {
-         int i,j;
-         STBI_SIMD_ALIGN(short, data[64]);
-         int n = z->order[0];
-         // non-interleaved data, we just need to process one block at a time,
-         // in trivial scanline order
-         // number of blocks to do just depends on how many actual "pixels" this
-         // component has, independent of interleaved MCU blocking and such
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               int ha = z->img_comp[n].ha;
-               if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-               // every data block is an MCU, so countdown the restart interval
-               if (--z->todo <= 0) {
-                  if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                  // if it's NOT a restart, then just bail, so we get corrupt data
-                  // rather than no data
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
-               }
-            }
-         }
-         return 1;
-      } else { // interleaved
-         int i,j,k,x,y;
-         STBI_SIMD_ALIGN(short, data[64]);
-         for (j=0; j < z->img_mcu_y; ++j) {
-            for (i=0; i < z->img_mcu_x; ++i) {
-               // scan an interleaved mcu... process scan_n components in order
-               for (k=0; k < z->scan_n; ++k) {
-                  int n = z->order[k];
-                  // scan out an mcu's worth of this component; that's just determined
-                  // by the basic H and V specified for the component
-                  for (y=0; y < z->img_comp[n].v; ++y) {
-                     for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
-                        int ha = z->img_comp[n].ha;
-                        if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
-                     }
-                  }
-               }
-               // after all interleaved components, that's an interleaved MCU,
-               // so now count down the restart interval
-               if (--z->todo <= 0) {
-                  if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
-               }
-            }
-         }
-         return 1;
+      int j, r, w, h;
+      stbi__jpeg_scan_mcus(z, &w, &h);
+      if (z->parallel_for && z->restart_interval && !z->ring_mcu_rows && !z->s->read_from_callbacks) {
+         r = stbi__jpeg_decode_restarts_parallel(z);
+         if (r >= 0) return r;
+      }
+      if (z->parallel_for && !z->ring_mcu_rows)
+         return stbi__jpeg_decode_scan_pipelined(z);
+      for (j=0; j < h; ++j) {
+         r = stbi__jpeg_decode_mcu_row(z, j, NULL);
+         if (r == 0) return 0;
+         if (r < 0) return 1; // missing restart marker, keep what we have
       }
+      return 1;
    } else {
       if (z->scan_n == 1) {
          int i,j;
@@ -2838,22 +3307,31 @@ static void stbi__jpeg_dequantize(short *data, stbi_uc *dequant)
       data[i] *= dequant[i];
 }
 
+// dequantize and idct one share of the rows of blocks of one component
+static void stbi__jpeg_finish_task(void *arg, int task)
+{
+   stbi__jpeg *z = (stbi__jpeg *) arg;
+   int i,j;
+   int bs = 8 >> z->scale_shift;
+   int n = task / STBI__JPEG_IMAGE_TASKS;
+   int part = task % STBI__JPEG_IMAGE_TASKS;
+   int w = (z->img_comp[n].x+7) >> 3;
+   int h = (z->img_comp[n].y+7) >> 3;
+   for (j=h*part/STBI__JPEG_IMAGE_TASKS; j < h*(part+1)/STBI__JPEG_IMAGE_TASKS; ++j) {
+      for (i=0; i < w; ++i) {
+         short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+         stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*bs+i*bs, z->img_comp[n].w2, data);
+      }
+   }
+}
+
 static void stbi__jpeg_finish(stbi__jpeg *z)
 {
    if (z->progressive) {
-      // dequantize and idct the data
-      int i,j,n;
-      for (n=0; n < z->s->img_n; ++n) {
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-               stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-            }
-         }
-      }
+      // dequantize and idct the data; every block is independent once the
+      // last scan is in, so the work is shared out between tasks
+      stbi__jpeg_run_tasks(z, z->s->img_n * STBI__JPEG_IMAGE_TASKS, stbi__jpeg_finish_task, z);
    }
 }
 
@@ -2974,10 +3452,6 @@ static int stbi__free_jpeg_components(stbi__jpeg *z, int ncomp, int why)
          z->img_comp[i].raw_coeff = 0;
          z->img_comp[i].coeff = 0;
       }
-      if (z->img_comp[i].linebuf) {
-         STBI_FREE(z->img_comp[i].linebuf);
-         z->img_comp[i].linebuf = NULL;
-      }
    }
    return why;
 }
@@ -2993,10 +3467,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    c = stbi__get8(s);
    if (c != 3 && c != 1) return stbi__err("bad component count","Corrupt JPEG");    // JFIF requires
    s->img_n = c;
-   for (i=0; i < c; ++i) {
+   for (i=0; i < c; ++i)
       z->img_comp[i].data = NULL;
-      z->img_comp[i].linebuf = NULL;
-   }
 
    if (Lf != 8+3*s->img_n) return stbi__err("bad SOF len","Corrupt JPEG");
 
@@ -3035,6 +3507,11 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    z->img_mcu_x = (s->img_x + z->img_mcu_w-1) / z->img_mcu_w;
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
 
+   // streaming only works for baseline images, and a ring buffer no smaller
+   // than the image is just the whole plane
+   if (z->progressive || z->ring_mcu_rows >= z->img_mcu_y)
+      z->ring_mcu_rows = 0;
+
    for (i=0; i < s->img_n; ++i) {
       // number of effective pixels (e.g. for non-interleaved MCU)
       z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max-1) / h_max;
@@ -3046,21 +3523,22 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      //
+      // when downscaling in the DCT-domain every 8x8 block only produces
+      // (8>>scale_shift)^2 pixels, so the planes shrink accordingly
+      z->img_comp[i].w2 = (z->img_mcu_x * z->img_comp[i].h * 8) >> z->scale_shift;
+      z->img_comp[i].h2 = ((z->ring_mcu_rows ? z->ring_mcu_rows : z->img_mcu_y) * z->img_comp[i].v * 8) >> z->scale_shift;
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
-      z->img_comp[i].linebuf = NULL;
       z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3347,6 +3825,10 @@ static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_
    return out;
 }
 
+// fused colour conversion and RGB565 packing, so the RGB888 pixels only ever
+// exist in registers. packing truncates, same as converting the RGB output.
+#define stbi__pack565(r,g,b)  ((stbi__uint16) ((((r) >> 3) << 11) | (((g) >> 2) << 5) | ((b) >> 3)))
+
 #ifdef STBI_JPEG_OLD
 // this is the same YCbCr-to-RGB calculation that stb_image has used
 // historically before the algorithm changes in 1.49
@@ -3375,6 +3857,27 @@ static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc
       out += step;
    }
 }
+
+static void stbi__YCbCr_to_RGB565_row(stbi__uint16 *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count)
+{
+   int i;
+   for (i=0; i < count; ++i) {
+      int y_fixed = (y[i] << 16) + 32768; // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr*float2fixed(1.40200f);
+      g = y_fixed - cr*float2fixed(0.71414f) - cb*float2fixed(0.34414f);
+      b = y_fixed                            + cb*float2fixed(1.77200f);
+      r >>= 16;
+      g >>= 16;
+      b >>= 16;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[i] = stbi__pack565(r, g, b);
+   }
+}
 #else
 // this is a reduced-precision calculation of YCbCr-to-RGB introduced
 // to make sure the code produces the same results in both SIMD and scalar
@@ -3403,6 +3906,27 @@ static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc
       out += step;
    }
 }
+
+static void stbi__YCbCr_to_RGB565_row(stbi__uint16 *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count)
+{
+   int i;
+   for (i=0; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed +  cr* float2fixed(1.40200f);
+      g = y_fixed + (cr*-float2fixed(0.71414f)) + ((cb*-float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                               +   cb* float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[i] = stbi__pack565(r, g, b);
+   }
+}
 #endif
 
 #if defined(STBI_SSE2) || defined(STBI_NEON)
@@ -3540,11 +4064,151 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+static void stbi__YCbCr_to_RGB565_simd(stbi__uint16 *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count)
+{
+   int i = 0;
+
+#ifdef STBI_SSE2
+   {
+      // same colour transform as stbi__YCbCr_to_RGB_simd, then pack instead of interleave
+      __m128i signflip  = _mm_set1_epi8(-0x80);
+      __m128i cr_const0 = _mm_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m128i cr_const1 = _mm_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m128i cb_const0 = _mm_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m128i cb_const1 = _mm_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m128i y_bias = _mm_set1_epi8((char) (unsigned char) 128);
+      __m128i zero = _mm_setzero_si128();
+
+      for (; i+7 < count; i += 8) {
+         // load
+         __m128i y_bytes = _mm_loadl_epi64((__m128i *) (y+i));
+         __m128i cr_bytes = _mm_loadl_epi64((__m128i *) (pcr+i));
+         __m128i cb_bytes = _mm_loadl_epi64((__m128i *) (pcb+i));
+         __m128i cr_biased = _mm_xor_si128(cr_bytes, signflip); // -128
+         __m128i cb_biased = _mm_xor_si128(cb_bytes, signflip); // -128
+
+         // unpack to short (and left-shift cr, cb by 8)
+         __m128i yw  = _mm_unpacklo_epi8(y_bias, y_bytes);
+         __m128i crw = _mm_unpacklo_epi8(zero, cr_biased);
+         __m128i cbw = _mm_unpacklo_epi8(zero, cb_biased);
+
+         // color transform
+         __m128i yws = _mm_srli_epi16(yw, 4);
+         __m128i cr0 = _mm_mulhi_epi16(cr_const0, crw);
+         __m128i cb0 = _mm_mulhi_epi16(cb_const0, cbw);
+         __m128i cb1 = _mm_mulhi_epi16(cbw, cb_const1);
+         __m128i cr1 = _mm_mulhi_epi16(crw, cr_const1);
+         __m128i rws = _mm_add_epi16(cr0, yws);
+         __m128i gwt = _mm_add_epi16(cb0, yws);
+         __m128i bws = _mm_add_epi16(yws, cb1);
+         __m128i gws = _mm_add_epi16(gwt, cr1);
+
+         // descale
+         __m128i rw = _mm_srai_epi16(rws, 4);
+         __m128i bw = _mm_srai_epi16(bws, 4);
+         __m128i gw = _mm_srai_epi16(gws, 4);
+
+         // clamp to 0..255 by packing to bytes, then widen back to short
+         __m128i rgb = _mm_packus_epi16(rw, gw);
+         __m128i bb  = _mm_packus_epi16(bw, bw);
+         __m128i r16 = _mm_unpacklo_epi8(rgb, zero);
+         __m128i g16 = _mm_unpackhi_epi8(rgb, zero);
+         __m128i b16 = _mm_unpacklo_epi8(bb, zero);
+
+         // pack to 5:6:5 and store
+         __m128i r5 = _mm_slli_epi16(_mm_srli_epi16(r16, 3), 11);
+         __m128i g6 = _mm_slli_epi16(_mm_srli_epi16(g16, 2), 5);
+         __m128i b5 = _mm_srli_epi16(b16, 3);
+         _mm_storeu_si128((__m128i *) (out + i), _mm_or_si128(_mm_or_si128(r5, g6), b5));
+      }
+   }
+#endif
+
+#ifdef STBI_NEON
+   {
+      // same colour transform as stbi__YCbCr_to_RGB_simd, then pack instead of interleave
+      uint8x8_t signflip = vdup_n_u8(0x80);
+      int16x8_t cr_const0 = vdupq_n_s16(   (short) ( 1.40200f*4096.0f+0.5f));
+      int16x8_t cr_const1 = vdupq_n_s16( - (short) ( 0.71414f*4096.0f+0.5f));
+      int16x8_t cb_const0 = vdupq_n_s16( - (short) ( 0.34414f*4096.0f+0.5f));
+      int16x8_t cb_const1 = vdupq_n_s16(   (short) ( 1.77200f*4096.0f+0.5f));
+
+      for (; i+7 < count; i += 8) {
+         // load
+         uint8x8_t y_bytes  = vld1_u8(y + i);
+         uint8x8_t cr_bytes = vld1_u8(pcr + i);
+         uint8x8_t cb_bytes = vld1_u8(pcb + i);
+         int8x8_t cr_biased = vreinterpret_s8_u8(vsub_u8(cr_bytes, signflip));
+         int8x8_t cb_biased = vreinterpret_s8_u8(vsub_u8(cb_bytes, signflip));
+
+         // expand to s16
+         int16x8_t yws = vreinterpretq_s16_u16(vshll_n_u8(y_bytes, 4));
+         int16x8_t crw = vshll_n_s8(cr_biased, 7);
+         int16x8_t cbw = vshll_n_s8(cb_biased, 7);
+
+         // color transform
+         int16x8_t cr0 = vqdmulhq_s16(crw, cr_const0);
+         int16x8_t cb0 = vqdmulhq_s16(cbw, cb_const0);
+         int16x8_t cr1 = vqdmulhq_s16(crw, cr_const1);
+         int16x8_t cb1 = vqdmulhq_s16(cbw, cb_const1);
+         int16x8_t rws = vaddq_s16(yws, cr0);
+         int16x8_t gws = vaddq_s16(vaddq_s16(yws, cb0), cr1);
+         int16x8_t bws = vaddq_s16(yws, cb1);
+
+         // undo scaling, round, convert to byte
+         uint8x8_t rb = vqrshrun_n_s16(rws, 4);
+         uint8x8_t gb = vqrshrun_n_s16(gws, 4);
+         uint8x8_t bb = vqrshrun_n_s16(bws, 4);
+
+         // pack to 5:6:5 by shifting g and b in underneath r, and store
+         uint16x8_t o = vshll_n_u8(rb, 8);
+         o = vsriq_n_u16(o, vshll_n_u8(gb, 8), 5);
+         o = vsriq_n_u16(o, vshll_n_u8(bb, 8), 11);
+         vst1q_u16(out + i, o);
+      }
+   }
+#endif
+
+   for (; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr* float2fixed(1.40200f);
+      g = y_fixed + cr*-float2fixed(0.71414f) + ((cb*-float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                             +   cb* float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[i] = stbi__pack565(r, g, b);
+   }
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
+   j->scale_shift = 0;
+   j->rgb565 = 0;
+   j->ring_mcu_rows = 0;
+   j->parallel_for = NULL;
+   j->parallel_context = NULL;
+   if (j->s->jpeg_options) {
+      j->scale_shift = j->s->jpeg_options->scale_shift;
+      if (j->scale_shift < 0) j->scale_shift = 0;
+      if (j->scale_shift > 3) j->scale_shift = 3;
+      j->rgb565 = j->s->jpeg_options->rgb565 != 0;
+      j->parallel_for = j->s->jpeg_options->parallel_for;
+      j->parallel_context = j->s->jpeg_options->parallel_context;
+   }
+
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
+   j->YCbCr_to_RGB565_kernel = stbi__YCbCr_to_RGB565_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
 #ifdef STBI_SSE2
@@ -3552,6 +4216,7 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
       j->idct_block_kernel = stbi__idct_simd;
       #ifndef STBI_JPEG_OLD
       j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
+      j->YCbCr_to_RGB565_kernel = stbi__YCbCr_to_RGB565_simd;
       #endif
       j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
    }
@@ -3561,9 +4226,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    j->idct_block_kernel = stbi__idct_simd;
    #ifndef STBI_JPEG_OLD
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
+   j->YCbCr_to_RGB565_kernel = stbi__YCbCr_to_RGB565_simd;
    #endif
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
 #endif
+
+   if      (j->scale_shift == 1) j->idct_block_kernel = stbi__idct_block_4x4;
+   else if (j->scale_shift == 2) j->idct_block_kernel = stbi__idct_block_2x2;
+   else if (j->scale_shift == 3) j->idct_block_kernel = stbi__idct_block_1x1;
 }
 
 // clean up the temporary component buffers
@@ -3575,16 +4245,187 @@ static void stbi__cleanup_jpeg(stbi__jpeg *j)
 typedef struct
 {
    resample_row_func resample;
-   stbi_uc *line0,*line1;
    int hs,vs;   // expansion factor in each axis
    int w_lores; // horizontal pixels pre-expansion
-   int ystep;   // how far through vertical expansion we are
-   int ypos;    // which pre-expansion row we're on
+   int h_lores; // vertical pixels pre-expansion
 } stbi__resample;
 
+// how the component planes turn into output rows
+typedef struct
+{
+   stbi__resample res_comp[4];
+   int n;           // components to generate
+   int decode_n;    // components to resample
+   int out_n;       // bytes per output pixel
+   int img_x,img_y; // output size, after any DCT-domain downscaling
+} stbi__jpeg_output;
+
+static void stbi__jpeg_setup_output(stbi__jpeg *z, stbi__jpeg_output *o, int req_comp)
+{
+   int k;
+
+   // determine actual number of components to generate; RGB565 is decoded
+   // like RGB but only takes 2 bytes per pixel in the output
+   o->n = z->rgb565 ? 3 : (req_comp ? req_comp : z->s->img_n);
+   o->out_n = z->rgb565 ? 2 : o->n;
+
+   o->img_x = (z->s->img_x + (1 << z->scale_shift) - 1) >> z->scale_shift;
+   o->img_y = (z->s->img_y + (1 << z->scale_shift) - 1) >> z->scale_shift;
+
+   if (z->s->img_n == 3 && o->n < 3)
+      o->decode_n = 1;
+   else
+      o->decode_n = z->s->img_n;
+
+   for (k=0; k < o->decode_n; ++k) {
+      stbi__resample *r = &o->res_comp[k];
+
+      r->hs      = z->img_h_max / z->img_comp[k].h;
+      r->vs      = z->img_v_max / z->img_comp[k].v;
+      r->w_lores = (o->img_x + r->hs-1) / r->hs;
+      r->h_lores = (z->img_comp[k].y + (1 << z->scale_shift) - 1) >> z->scale_shift;
+
+      if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+      else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
+      else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+      else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
+      else                               r->resample = stbi__resample_row_generic;
+   }
+}
+
+// resample and color-convert output rows y0..y1-1 into 'output', 'stride'
+// bytes apart. rows are independent of each other, so any range can be
+// converted as long as the plane rows it reads have been decoded
+static void stbi__jpeg_convert_rows(stbi__jpeg *z, stbi__jpeg_output *o, stbi_uc **linebuf, stbi_uc *output, int stride, int y0, int y1)
+{
+   int i,j,k;
+   int n = o->n, img_x = o->img_x;
+   stbi_uc *coutput[4];
+
+   for (j=y0; j < y1; ++j) {
+      stbi_uc *out = output + stride * (j - y0);
+      for (k=0; k < o->decode_n; ++k) {
+         stbi__resample *r = &o->res_comp[k];
+         // vertical 2x upsampling blends in the pre-expansion row on whichever
+         // side of the nearest one this output row falls
+         int near = j / r->vs, far;
+         if (near >= r->h_lores) near = r->h_lores-1;
+         far = near;
+         if (r->vs == 2) {
+            far = (j & 1) ? near+1 : near-1;
+            if (far < 0) far = 0;
+            if (far >= r->h_lores) far = r->h_lores-1;
+         }
+         coutput[k] = r->resample(linebuf[k],
+                                  stbi__jpeg_plane_row(z, k, near),
+                                  stbi__jpeg_plane_row(z, k, far),
+                                  r->w_lores, r->hs);
+      }
+      if (z->rgb565) {
+         stbi__uint16 *out16 = (stbi__uint16 *) out;
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (z->rgb == 3) {
+               for (i=0; i < img_x; ++i)
+                  out16[i] = stbi__pack565(y[i], coutput[1][i], coutput[2][i]);
+            } else {
+               z->YCbCr_to_RGB565_kernel(out16, y, coutput[1], coutput[2], img_x);
+            }
+         } else
+            for (i=0; i < img_x; ++i)
+               out16[i] = stbi__pack565(y[i], y[i], y[i]);
+      } else if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (z->rgb == 3) {
+               for (i=0; i < img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], img_x, n);
+            }
+         } else
+            for (i=0; i < img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               out[3] = 255; // not used if n==3
+               out += n;
+            }
+      } else {
+         stbi_uc *y = coutput[0];
+         if (n == 1)
+            for (i=0; i < img_x; ++i) out[i] = y[i];
+         else
+            for (i=0; i < img_x; ++i) *out++ = y[i], *out++ = 255;
+      }
+   }
+}
+
+// converting output rows in parallel: every task gets a share of the rows
+// and its own line buffers to resample them through
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi__jpeg_output *o;
+   stbi_uc *linebuf;     // each task's line buffers and spare row, one task after the other
+   int task_bytes;
+   stbi_uc *output;      // where row y0 goes, with the rest following 'stride' bytes apart
+   int stride, y0, y1;
+   int num_tasks;
+} stbi__jpeg_convert;
+
+static int stbi__jpeg_convert_init(stbi__jpeg_convert *c, stbi__jpeg *z, stbi__jpeg_output *o, int num_tasks)
+{
+   c->z = z;
+   c->o = o;
+   c->num_tasks = z->parallel_for ? num_tasks : 1;
+   // line buffers big enough for upsampling off the edges with upsample
+   // factor of 4, and a spare output row (see stbi__jpeg_convert_task)
+   c->task_bytes = o->decode_n * (o->img_x + 3) + o->out_n * o->img_x + 1;
+   c->linebuf = (stbi_uc *) stbi__malloc_mad2(c->num_tasks, c->task_bytes, 0);
+   if (!c->linebuf) return stbi__err("outofmem", "Out of memory");
+   return 1;
+}
+
+static void stbi__jpeg_convert_task(void *arg, int task)
+{
+   stbi__jpeg_convert *c = (stbi__jpeg_convert *) arg;
+   stbi_uc *linebuf[4], *spare;
+   int k;
+   int y0 = c->y0 + (c->y1 - c->y0) * task / c->num_tasks;
+   int y1 = c->y0 + (c->y1 - c->y0) * (task+1) / c->num_tasks;
+   for (k=0; k < c->o->decode_n; ++k)
+      linebuf[k] = c->linebuf + task * c->task_bytes + k * (c->o->img_x + 3);
+   spare = linebuf[c->o->decode_n-1] + c->o->img_x + 3;
+   if (c->o->out_n == 3 && y1 < c->y1 && y0 < y1) {
+      // 3 byte pixels are written 4 bytes at a time, so the end of a row
+      // spills onto the start of the next. that next row is another task's,
+      // so our last row goes through the spare one and gets copied over
+      stbi__jpeg_convert_rows(c->z, c->o, linebuf, c->output + c->stride * (y0 - c->y0), c->stride, y0, y1-1);
+      stbi__jpeg_convert_rows(c->z, c->o, linebuf, spare, c->stride, y1-1, y1);
+      memcpy(c->output + c->stride * (y1-1 - c->y0), spare, c->o->out_n * c->o->img_x);
+   } else
+      stbi__jpeg_convert_rows(c->z, c->o, linebuf, c->output + c->stride * (y0 - c->y0), c->stride, y0, y1);
+}
+
+// point the tasks at output rows y0..y1-1, to be run by stbi__jpeg_run_tasks()
+// or alongside a pipeline step
+static void stbi__jpeg_convert_setup(stbi__jpeg_convert *c, stbi_uc *output, int stride, int y0, int y1)
+{
+   c->output = output;
+   c->stride = stride;
+   c->y0 = y0;
+   c->y1 = y1;
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
-   int n, decode_n;
+   stbi__jpeg_output o;
+   stbi__jpeg_convert c;
+   stbi_uc *output;
    z->s->img_n = 0; // make stbi__cleanup_jpeg safe
 
    // validate req_comp
@@ -3593,109 +4434,170 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
-   // determine actual number of components to generate
-   n = req_comp ? req_comp : z->s->img_n;
+   stbi__jpeg_setup_output(z, &o, req_comp);
+   if (!stbi__jpeg_convert_init(&c, z, &o, STBI__JPEG_IMAGE_TASKS)) { stbi__cleanup_jpeg(z); return NULL; }
 
-   if (z->s->img_n == 3 && n < 3)
-      decode_n = 1;
-   else
-      decode_n = z->s->img_n;
+   // can't error after this so, this is safe
+   output = (stbi_uc *) stbi__malloc_mad3(o.out_n, o.img_x, o.img_y, 1);
+   if (!output) { STBI_FREE(c.linebuf); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-   // resample and color-convert
-   {
-      int k;
-      unsigned int i,j;
-      stbi_uc *output;
-      stbi_uc *coutput[4];
-
-      stbi__resample res_comp[4];
-
-      for (k=0; k < decode_n; ++k) {
-         stbi__resample *r = &res_comp[k];
-
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
-         if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
-         r->ystep   = r->vs >> 1;
-         r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
-         r->ypos    = 0;
-         r->line0   = r->line1 = z->img_comp[k].data;
-
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
-         else                               r->resample = stbi__resample_row_generic;
+   // now go ahead and resample
+   stbi__jpeg_convert_setup(&c, output, o.out_n * o.img_x, 0, o.img_y);
+   stbi__jpeg_run_tasks(z, c.num_tasks, stbi__jpeg_convert_task, &c);
+
+   STBI_FREE(c.linebuf);
+   stbi__cleanup_jpeg(z);
+   *out_x = o.img_x;
+   *out_y = o.img_y;
+   if (comp) *comp  = z->s->img_n; // report original components, not output
+   return output;
+}
+
+static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
+{
+   unsigned char* result;
+   stbi__jpeg* j = (stbi__jpeg*) stbi__malloc(sizeof(stbi__jpeg));
+   j->s = s;
+   stbi__setup_jpeg(j);
+   result = load_jpeg_image(j, x,y,comp,req_comp);
+   ri->rgb565 = j->rgb565;
+   STBI_FREE(j);
+   return result;
+}
+
+// number of MCU rows kept when streaming: converting a band reads one chroma
+// row past it in each direction, so the rows either side have to stay around.
+// the pipeline converts a band while inverse transforming the row two below
+// it, so it needs one more
+#define STBI__JPEG_RING_MCU_ROWS           3
+#define STBI__JPEG_PIPELINE_RING_MCU_ROWS  4
+
+static int stbi__stream_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp, stbi_jpeg_band_callback callback, void *user)
+{
+   stbi__jpeg_output o;
+   stbi__jpeg_convert c;
+   stbi__jpeg_pipeline p;
+   stbi_jpeg_band band;
+   stbi_uc *band_data;
+   int j, m, r, band_h, rows, decoded = 0, step = 0, streaming = 0, pipelined, result = 1;
+   z->s->img_n = 0; // make stbi__cleanup_jpeg safe
+
+   // validate req_comp
+   if (req_comp < 0 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+
+   for (m = 0; m < 4; m++) {
+      z->img_comp[m].raw_data = NULL;
+      z->img_comp[m].raw_coeff = NULL;
+   }
+   z->restart_interval = 0;
+   z->ring_mcu_rows = z->parallel_for ? STBI__JPEG_PIPELINE_RING_MCU_ROWS : STBI__JPEG_RING_MCU_ROWS;
+   if (!stbi__decode_jpeg_header(z, STBI__SCAN_load)) { stbi__cleanup_jpeg(z); return 0; }
+
+   // baseline images whose first scan holds every component can be converted
+   // as each MCU row arrives (a single-component scan walks rows of blocks,
+   // which only line up with MCU rows when the component isn't subsampled).
+   // ones with restart markers get through the whole scan quicker by
+   // decoding their intervals in parallel, if we're allowed to
+   if (!z->progressive) {
+      m = stbi__get_marker(z);
+      while (!stbi__SOS(m)) {
+         if (stbi__EOI(m) || !stbi__process_marker(z, m)) { stbi__cleanup_jpeg(z); return stbi__err("no SOS", "Corrupt JPEG"); }
+         m = stbi__get_marker(z);
       }
+      if (!stbi__process_scan_header(z)) { stbi__cleanup_jpeg(z); return 0; }
+      streaming = z->scan_n == z->s->img_n && (z->scan_n > 1 || z->img_v_max == 1);
+      if (z->parallel_for && z->restart_interval)
+         streaming = 0;
+   }
 
-      // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
+   // anything else is decoded in full the usual way, then handed over a band
+   // at a time
+   if (!streaming) {
+      stbi__cleanup_jpeg(z);
+      stbi__rewind(z->s);
+      z->ring_mcu_rows = 0;
+      if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return 0; }
+   }
+
+   stbi__jpeg_setup_output(z, &o, req_comp);
+   if (!stbi__jpeg_convert_init(&c, z, &o, STBI__JPEG_ROW_TASKS)) { stbi__cleanup_jpeg(z); return 0; }
+
+   band_h = z->img_mcu_h >> z->scale_shift;
+   band_data = (stbi_uc *) stbi__malloc_mad3(o.out_n, o.img_x, band_h, 1);
+   if (!band_data) { STBI_FREE(c.linebuf); stbi__cleanup_jpeg(z); return stbi__err("outofmem", "Out of memory"); }
+
+   // with parallel_for, decoding and converting overlap in a pipeline
+   pipelined = streaming && z->parallel_for;
+   if (pipelined) {
+      if (!stbi__jpeg_pipeline_init(&p, z)) { STBI_FREE(band_data); STBI_FREE(c.linebuf); stbi__cleanup_jpeg(z); return 0; }
+      p.extra_task = stbi__jpeg_convert_task;
+      p.extra_arg = &c;
+   }
+
+   band.width = o.img_x;
+   band.height = o.img_y;
+   band.stride = o.out_n * o.img_x;
+   band.bytes_per_pixel = o.out_n;
+   band.pixels = band_data;
+
+   if (streaming)
+      stbi__jpeg_reset(z);
+
+   rows = z->img_mcu_y; // MCU rows to entropy decode
+   for (j=0; j < z->img_mcu_y && result; ++j) {
+      band.y = j * band_h;
+      band.num_rows = o.img_y - band.y < band_h ? o.img_y - band.y : band_h;
+      stbi__jpeg_convert_setup(&c, band_data, band.stride, band.y, band.y + band.num_rows);
+      if (pipelined) {
+         // each step entropy decodes a row and inverse transforms the one
+         // before it; band j is converted alongside the step that decodes
+         // row j+3, once the rows it reads have all been transformed
+         while (step <= j+3 && result) {
+            int entropy_row = step < rows ? step : -1;
+            int idct_row = step > 0 && step-1 < decoded ? step-1 : -1;
+            if (entropy_row >= 0) decoded = step+1;
+            p.num_extra_tasks = step == j+3 ? c.num_tasks : 0;
+            r = stbi__jpeg_pipeline_step(&p, entropy_row, idct_row);
+            if (r == 0) result = 0;
+            if (r < 0) rows = decoded; // missing restart marker, keep what we have
+            ++step;
          }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (z->rgb == 3) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            stbi_uc *y = coutput[0];
-            if (n == 1)
-               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-            else
-               for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+      } else {
+         if (streaming) {
+            // stay one MCU row ahead of the band being converted
+            while (decoded < j+2 && decoded < rows && result) {
+               r = stbi__jpeg_decode_mcu_row(z, decoded++, NULL);
+               if (r == 0) result = 0;
+               if (r < 0) rows = decoded; // missing restart marker, keep what we have
+            }
          }
+         if (result)
+            stbi__jpeg_run_tasks(z, c.num_tasks, stbi__jpeg_convert_task, &c);
       }
-      stbi__cleanup_jpeg(z);
-      *out_x = z->s->img_x;
-      *out_y = z->s->img_y;
-      if (comp) *comp  = z->s->img_n; // report original components, not output
-      return output;
-   }
+      if (result && !callback(user, &band))
+         result = stbi__err("cancelled", "Decode cancelled");
+   }
+
+   if (pipelined)
+      STBI_FREE(p.raw_coeff);
+   STBI_FREE(band_data);
+   STBI_FREE(c.linebuf);
+   stbi__cleanup_jpeg(z);
+   if (!result) return 0;
+   if (out_x) *out_x = o.img_x;
+   if (out_y) *out_y = o.img_y;
+   if (comp) *comp  = z->s->img_n; // report original components, not output
+   return 1;
 }
 
-static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
+static int stbi__jpeg_stream_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi_jpeg_band_callback callback, void *user)
 {
-   unsigned char* result;
+   int result;
    stbi__jpeg* j = (stbi__jpeg*) stbi__malloc(sizeof(stbi__jpeg));
+   if (!j) return stbi__err("outofmem", "Out of memory");
    j->s = s;
    stbi__setup_jpeg(j);
-   result = load_jpeg_image(j, x,y,comp,req_comp);
+   result = stbi__stream_jpeg_image(j, x,y,comp,req_comp,callback,user);
    STBI_FREE(j);
    return result;
 }
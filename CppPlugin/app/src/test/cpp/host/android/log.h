@@ -0,0 +1,5 @@
+// Just enough of the NDK's android/log.h for cppplugin.cpp to build on the host, for its tests. Its logging is dropped
+#pragma once
+
+#define ANDROID_LOG_INFO 4
+#define __android_log_print(prio, tag, ...) (0)
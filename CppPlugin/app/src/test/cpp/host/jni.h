@@ -0,0 +1,13 @@
+// Just enough of the NDK's jni.h for cppplugin.cpp to build on the host, for its tests
+#pragma once
+
+typedef void* jobject;
+typedef void* jstring;
+
+struct JNIEnv
+{
+    jstring NewStringUTF(const char*)
+    {
+        return 0;
+    }
+};
@@ -0,0 +1,76 @@
+// Checks that every box ResampleBoxRow() has a SIMD kernel for gives exactly what the scalar ResampleIntegerBand() does, into RGB888
+//  and RGB565, including the pixels past the last whole group of 8. Built on the host by CMakeLists.txt, and run with ctest
+#include "cppplugin.cpp"
+
+#if !defined(STBI_SSE2) && !defined(STBI_NEON)
+#error "Build with STBI_SSE2 or STBI_NEON, or the kernels are only compared with themselves"
+#endif
+
+// Resamples an image that's ratio times newWidth x newHeight both ways and returns how many of its pixels differ from the scalar loop's.
+//  The buffers are exactly the size of the image, so that a kernel reading past its end shows up under a sanitiser
+template<bool kRGB565>
+int CountMismatchedPixels(int ratio, int newWidth, int newHeight, bool isSaturated)
+{
+    const int kWidth = newWidth * ratio;
+    const int kHeight = newHeight * ratio;
+    const int kStride = kWidth * kNumStbChannels;
+    std::vector<stbi_uc> image((size_t) kStride * kHeight);
+    for (stbi_uc& channel : image)
+    {
+        channel = isSaturated ? 255 : (stbi_uc) rand();
+    }
+
+    const int kPixelSize = kRGB565 ? kStrideRGB565 : kNumStbChannels;
+    const int kNewStride = newWidth * kPixelSize;
+    std::vector<stbi_uc> result((size_t) kNewStride * newHeight);
+    std::vector<stbi_uc> expected((size_t) kNewStride * newHeight);
+    if (kRGB565)
+    {
+        ResampleIntegerRGB565(result.data(), image.data(), kWidth, kHeight, kStride, newWidth, newHeight, kNewStride);
+    }
+    else
+    {
+        ResampleIntegerRGB(result.data(), image.data(), kWidth, kHeight, kStride, newWidth, newHeight, kNewStride);
+    }
+    IntegerResample resample = { expected.data(), image.data(), kStride, newWidth, kNewStride, ratio, ratio };
+    ResampleIntegerBand<kRGB565>(&resample, 0, newHeight);
+
+    int numMismatched = 0;
+    for (size_t i = 0; i < result.size(); i += kPixelSize)
+    {
+        numMismatched += memcmp(&result[i], &expected[i], kPixelSize) != 0;
+    }
+    return numMismatched;
+}
+
+int main()
+{
+    const int kRatios[] = { 1, 2, 4, 8 };
+    const int kNewWidths[] = { 1, 7, 9, 13, 30, 203 }; // Below, between and beyond whole groups of 8
+    const int kNewHeight = 5;
+
+    srand(1);
+    int numResamples = 0;
+    int numFailures = 0;
+    for (int ratio : kRatios)
+    {
+        for (int newWidth : kNewWidths)
+        {
+            for (int isSaturated = 0; isSaturated < 2; isSaturated++)
+            {
+                numResamples++;
+                const int kNumRGB888 = CountMismatchedPixels<false>(ratio, newWidth, kNewHeight, isSaturated != 0);
+                const int kNumRGB565 = CountMismatchedPixels<true>(ratio, newWidth, kNewHeight, isSaturated != 0);
+                if (kNumRGB888 != 0 || kNumRGB565 != 0)
+                {
+                    printf("FAILED %d:1 to %d x %d%s: %d RGB888 and %d RGB565 pixels differ\n", ratio, newWidth, kNewHeight,
+                           isSaturated ? " from white" : "", kNumRGB888, kNumRGB565);
+                    numFailures++;
+                }
+            }
+        }
+    }
+
+    printf("%d of %d resamples differ from the scalar loop\n", numFailures, numResamples);
+    return numFailures == 0 ? 0 : 1;
+}